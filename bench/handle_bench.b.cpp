@@ -0,0 +1,201 @@
+#include <benchmark/benchmark.h>
+#include <melon/core/concurrent_handle.h>
+#include <melon/core/handle.h>
+#include <tinycthread.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Random-access validity checks on large handle pools. A quarter of the
+// handles are stale so both outcomes of the check are exercised.
+////////////////////////////////////////////////////////////////////////////////
+
+static void BM_pool_validate_random(benchmark::State& state)
+{
+    size_t            count = (size_t) state.range(0);
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, count, melon_default_cb_allocator(), false);
+
+    std::vector<melon_handle> handles(count);
+    for (size_t i = 0; i < count; i++)
+        handles[i] = melon_pool_create_handle(&pool);
+    for (size_t i = 0; i < count; i += 4)
+        melon_pool_delete_handle(&pool, handles[i]);
+    std::shuffle(handles.begin(), handles.end(), std::mt19937(42));
+
+    for (auto _ : state)
+    {
+        size_t valid = 0;
+        for (melon_handle handle : handles)
+            valid += melon_handle_is_valid(&pool, handle);
+        benchmark::DoNotOptimize(valid);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    melon_delete_handle_pool(&pool);
+}
+BENCHMARK(BM_pool_validate_random)->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 22);
+
+// Same as above through the batch API
+static void BM_pool_validate_random_batch(benchmark::State& state)
+{
+    size_t            count = (size_t) state.range(0);
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, count, melon_default_cb_allocator(), false);
+
+    std::vector<melon_handle> handles(count);
+    melon_pool_create_handles(&pool, handles.data(), count);
+    for (size_t i = 0; i < count; i += 4)
+        melon_pool_delete_handle(&pool, handles[i]);
+    std::shuffle(handles.begin(), handles.end(), std::mt19937(42));
+
+    bool* valid = new bool[count];
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(melon_handles_are_valid(&pool, handles.data(), valid, count));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    delete[] valid;
+    melon_delete_handle_pool(&pool);
+}
+BENCHMARK(BM_pool_validate_random_batch)->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 22);
+
+// Creating and deleting a batch of handles one at a time and through the batch API
+static void BM_pool_create_delete_single(benchmark::State& state)
+{
+    size_t            count = (size_t) state.range(0);
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 0, melon_default_cb_allocator(), true);
+
+    std::vector<melon_handle> handles(count);
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < count; i++)
+            handles[i] = melon_pool_create_handle(&pool);
+        for (size_t i = 0; i < count; i++)
+            melon_pool_delete_handle(&pool, handles[i]);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    melon_delete_handle_pool(&pool);
+}
+BENCHMARK(BM_pool_create_delete_single)->Arg(1 << 10)->Arg(1 << 16);
+
+static void BM_pool_create_delete_batch(benchmark::State& state)
+{
+    size_t            count = (size_t) state.range(0);
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 0, melon_default_cb_allocator(), true);
+
+    std::vector<melon_handle> handles(count);
+    for (auto _ : state)
+    {
+        melon_pool_create_handles(&pool, handles.data(), count);
+        melon_pool_delete_handles(&pool, handles.data(), count);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    melon_delete_handle_pool(&pool);
+}
+BENCHMARK(BM_pool_create_delete_batch)->Arg(1 << 10)->Arg(1 << 16);
+
+// Create and delete handles through the free list at steady state
+static void BM_pool_churn(benchmark::State& state)
+{
+    size_t            count = (size_t) state.range(0);
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, count, melon_default_cb_allocator(), false);
+
+    std::vector<melon_handle> handles(count);
+    for (size_t i = 0; i < count; i++)
+        handles[i] = melon_pool_create_handle(&pool);
+
+    std::mt19937 rng(42);
+    for (auto _ : state)
+    {
+        size_t slot = rng() % count;
+        melon_pool_delete_handle(&pool, handles[slot]);
+        handles[slot] = melon_pool_create_handle(&pool);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    melon_delete_handle_pool(&pool);
+}
+BENCHMARK(BM_pool_churn)->Arg(1 << 20);
+
+////////////////////////////////////////////////////////////////////////////////
+// Create/delete throughput from several threads: the lock-free concurrent pool
+// against a melon_handle_pool guarded by a mutex.
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+const size_t shared_pool_capacity = 1 << 16;
+
+struct shared_concurrent_pool
+{
+    melon_concurrent_handle_pool pool;
+
+    shared_concurrent_pool()
+    {
+        melon_create_concurrent_handle_pool(&pool, shared_pool_capacity, melon_default_cb_allocator());
+    }
+    ~shared_concurrent_pool() { melon_delete_concurrent_handle_pool(&pool); }
+};
+
+struct shared_mutex_pool
+{
+    melon_handle_pool pool;
+    mtx_t             lock;
+
+    shared_mutex_pool()
+    {
+        melon_create_handle_pool(&pool, shared_pool_capacity, melon_default_cb_allocator(), false);
+        mtx_init(&lock, mtx_plain);
+    }
+    ~shared_mutex_pool()
+    {
+        mtx_destroy(&lock);
+        melon_delete_handle_pool(&pool);
+    }
+};
+} // namespace
+
+static void BM_concurrent_pool_churn(benchmark::State& state)
+{
+    static shared_concurrent_pool shared;
+
+    for (auto _ : state)
+    {
+        melon_handle handle = melon_concurrent_pool_create_handle(&shared.pool);
+        benchmark::DoNotOptimize(melon_concurrent_handle_is_valid(&shared.pool, handle));
+        melon_concurrent_pool_delete_handle(&shared.pool, handle);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_concurrent_pool_churn)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_mutex_pool_churn(benchmark::State& state)
+{
+    static shared_mutex_pool shared;
+
+    for (auto _ : state)
+    {
+        mtx_lock(&shared.lock);
+        melon_handle handle = melon_pool_create_handle(&shared.pool);
+        mtx_unlock(&shared.lock);
+
+        mtx_lock(&shared.lock);
+        benchmark::DoNotOptimize(melon_handle_is_valid(&shared.pool, handle));
+        mtx_unlock(&shared.lock);
+
+        mtx_lock(&shared.lock);
+        melon_pool_delete_handle(&shared.pool, handle);
+        mtx_unlock(&shared.lock);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mutex_pool_churn)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+#include <melon/core/handle.h>
+#include <melon/core/huge_pages.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Random lookups into a large melon_map, with the map storage on ordinary
+// pages and on huge pages. The map is sized well past what the TLB covers with
+// 4KB pages, so the difference is mostly page walks.
+////////////////////////////////////////////////////////////////////////////////
+
+struct map_element
+{
+    float    transform[12];
+    uint64_t payload[2];
+};
+
+MELON_HANDLE_MAP_TYPEDEF(map_element)
+
+static void walk_map(benchmark::State& state, const melon_allocator_api* allocator,
+                     const melon_huge_page_allocator* huge = nullptr)
+{
+    size_t                count = (size_t) state.range(0);
+    melon_map_map_element map;
+    melon_create_map(&map, count, allocator, false);
+
+    map_element               element = {};
+    std::vector<melon_handle> handles(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        element.payload[0] = i;
+        handles[i]         = melon_map_push(&map, &element);
+    }
+    std::shuffle(handles.begin(), handles.end(), std::mt19937(42));
+
+    for (auto _ : state)
+    {
+        uint64_t sum = 0;
+        for (melon_handle handle : handles)
+            sum += melon_map_get(&map, handle)->payload[0];
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    if (huge)
+    {
+        state.counters["huge_mappings"]        = (double) huge->live_mappings[MELON_VM_HUGE_PAGES];
+        state.counters["transparent_mappings"] = (double) huge->live_mappings[MELON_VM_TRANSPARENT_HUGE_PAGES];
+    }
+
+    melon_delete_map(&map);
+}
+
+static void BM_map_walk_default_pages(benchmark::State& state) { walk_map(state, melon_default_cb_allocator()); }
+
+static void BM_map_walk_huge_pages(benchmark::State& state)
+{
+    melon_huge_page_allocator huge;
+    melon_create_huge_page_allocator(&huge, MELON_HUGE_PAGE_SIZE / 2, melon_default_cb_allocator());
+    melon_allocator_api allocator = melon_huge_page_allocator_api(&huge);
+
+    walk_map(state, &allocator, &huge);
+}
+
+BENCHMARK(BM_map_walk_default_pages)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_map_walk_huge_pages)->Arg(1 << 16)->Arg(1 << 20);
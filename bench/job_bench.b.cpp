@@ -0,0 +1,67 @@
+#include <benchmark/benchmark.h>
+#include <melon/core/job.h>
+
+#include <cmath>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Synthetic per-entity update spread over the job system, run with 1 to 8
+// workers to show how it scales with cores.
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+struct entity
+{
+    float position[3];
+    float velocity[3];
+};
+
+void update_entities(void* data, size_t begin, size_t end)
+{
+    entity*     entities = (entity*) data;
+    const float dt       = 1.0f / 60.0f;
+    for (size_t i = begin; i < end; i++)
+    {
+        entity& e = entities[i];
+        // Enough math per entity that the update isn't bound by memory bandwidth alone
+        for (int step = 0; step < 8; step++)
+        {
+            float speed = std::sqrt(e.velocity[0] * e.velocity[0] + e.velocity[1] * e.velocity[1]
+                                    + e.velocity[2] * e.velocity[2]);
+            float drag  = 1.0f / (1.0f + 0.01f * speed);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                e.velocity[axis] *= drag;
+                e.position[axis] += e.velocity[axis] * dt;
+            }
+        }
+    }
+}
+} // namespace
+
+static void BM_parallel_for_entities(benchmark::State& state)
+{
+    size_t           workers = (size_t) state.range(0);
+    size_t           count   = (size_t) state.range(1);
+    melon_job_system system;
+    melon_create_job_system(&system, workers, melon_default_cb_allocator());
+
+    std::vector<entity> entities(count);
+    for (size_t i = 0; i < count; i++)
+        entities[i] = {{0.0f, 0.0f, 0.0f}, {(float) (i % 7), (float) (i % 11), (float) (i % 13)}};
+
+    for (auto _ : state)
+    {
+        melon_parallel_for(&system, count, 1024, update_entities, entities.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    melon_destroy_job_system(&system);
+}
+BENCHMARK(BM_parallel_for_entities)
+    ->ArgNames({"workers", "entities"})
+    ->ArgsProduct({{1, 2, 4, 8}, {1 << 16, 1 << 20}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+#include <melon/core/memory.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Core memory primitives: arena pushes at varied sizes and alignments, block
+// overflow, reset, and the default aligned malloc/realloc/free callbacks.
+////////////////////////////////////////////////////////////////////////////////
+
+static const size_t pushes_per_iteration = 1024;
+
+// range(0) is the push size, range(1) the alignment. The arena is sized so that no push overflows
+static void BM_arena_push(benchmark::State& state)
+{
+    size_t size  = (size_t) state.range(0);
+    size_t align = (size_t) state.range(1);
+
+    melon_memory_arena arena
+        = melon_create_arena((size + align) * pushes_per_iteration, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < pushes_per_iteration; i++)
+            benchmark::DoNotOptimize(melon_arena_push_size(&arena, size, align));
+
+        state.PauseTiming();
+        melon_arena_reset(&arena);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * pushes_per_iteration);
+    state.SetBytesProcessed(state.iterations() * pushes_per_iteration * size);
+
+    melon_destroy_arena(&arena);
+}
+BENCHMARK(BM_arena_push)->ArgsProduct({ { 8, 64, 256, 4096 }, { 1, 16, 64 } });
+
+// Starts from a block that holds a few pushes, so every iteration chains new blocks. range(0) enables the block
+// cache, which recycles the blocks released by the previous reset
+static void BM_arena_overflow(benchmark::State& state)
+{
+    melon_memory_arena arena   = melon_create_arena(256, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+    arena.block_cache.capacity = state.range(0) ? MELON_BLOCK_CACHE_DEFAULT_CAPACITY * 4 : 0;
+
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < pushes_per_iteration; i++)
+            benchmark::DoNotOptimize(melon_arena_push_size(&arena, 64, MELON_DEFAULT_ALIGN));
+        melon_arena_reset(&arena);
+    }
+    state.SetItemsProcessed(state.iterations() * pushes_per_iteration);
+    state.counters["cache_hits"]   = (double) arena.block_cache.hits;
+    state.counters["cache_misses"] = (double) arena.block_cache.misses;
+
+    melon_destroy_arena(&arena);
+}
+BENCHMARK(BM_arena_overflow)->Arg(0)->Arg(1);
+
+// range(0) is the number of blocks chained onto the arena before it is reset
+static void BM_arena_reset(benchmark::State& state)
+{
+    size_t             blocks = (size_t) state.range(0);
+    melon_memory_arena arena  = melon_create_arena(1024, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (size_t i = 0; i < blocks; i++)
+            melon_arena_push_size(&arena, 1024, MELON_DEFAULT_ALIGN);
+        state.ResumeTiming();
+
+        melon_arena_reset(&arena);
+    }
+
+    melon_destroy_arena(&arena);
+}
+BENCHMARK(BM_arena_reset)->Arg(1)->Arg(8)->Arg(64);
+
+// range(0) is the allocation size, range(1) the alignment
+static void BM_default_alloc_free(benchmark::State& state)
+{
+    const melon_allocator_api* allocator = melon_default_cb_allocator();
+    size_t                     size      = (size_t) state.range(0);
+    size_t                     align     = (size_t) state.range(1);
+
+    for (auto _ : state)
+    {
+        void* ptr = MELON_ALLOC((*allocator), size, align);
+        benchmark::DoNotOptimize(ptr);
+        MELON_FREE((*allocator), ptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_default_alloc_free)->ArgsProduct({ { 16, 256, 4096, 1 << 20 }, { 16, 64, 256 } });
+
+// Grows an allocation from range(0) bytes to 16 times that size, doubling each step
+static void BM_default_realloc(benchmark::State& state)
+{
+    const melon_allocator_api* allocator = melon_default_cb_allocator();
+    size_t                     size      = (size_t) state.range(0);
+
+    for (auto _ : state)
+    {
+        void* ptr = MELON_ALLOC((*allocator), size, MELON_DEFAULT_ALIGN);
+        for (size_t new_size = size * 2; new_size <= size * 16; new_size *= 2)
+            ptr = MELON_REALLOC((*allocator), ptr, new_size, MELON_DEFAULT_ALIGN);
+        benchmark::DoNotOptimize(ptr);
+        MELON_FREE((*allocator), ptr);
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_default_realloc)->Arg(64)->Arg(4096)->Arg(1 << 16);
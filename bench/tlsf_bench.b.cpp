@@ -0,0 +1,121 @@
+#include <benchmark/benchmark.h>
+#include <melon/core/tlsf.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Per-operation latency of a mixed alloc/realloc/free workload. Reports the
+// p50/p99/p99.9/max of individual calls alongside the total time.
+////////////////////////////////////////////////////////////////////////////////
+
+enum op_type
+{
+    OP_ALLOC,
+    OP_REALLOC,
+    OP_FREE
+};
+
+struct op
+{
+    op_type type;
+    size_t  slot;
+    size_t  size;
+};
+
+static const size_t num_slots = 1024;
+static const size_t num_ops   = 100000;
+
+static std::vector<op> generate_ops()
+{
+    std::mt19937                          rng(42);
+    std::uniform_int_distribution<size_t> size_dist(16, 8192);
+    std::uniform_int_distribution<size_t> slot_dist(0, num_slots - 1);
+
+    std::vector<bool> live(num_slots, false);
+    std::vector<op>   ops;
+    ops.reserve(num_ops);
+
+    while (ops.size() < num_ops)
+    {
+        size_t slot = slot_dist(rng);
+        if (!live[slot])
+        {
+            ops.push_back({ OP_ALLOC, slot, size_dist(rng) });
+            live[slot] = true;
+        }
+        else if (rng() % 4 == 0)
+        {
+            ops.push_back({ OP_REALLOC, slot, size_dist(rng) });
+        }
+        else
+        {
+            ops.push_back({ OP_FREE, slot, 0 });
+            live[slot] = false;
+        }
+    }
+
+    for (size_t slot = 0; slot < num_slots; slot++)
+        if (live[slot])
+            ops.push_back({ OP_FREE, slot, 0 });
+
+    return ops;
+}
+
+static void run_latency_workload(benchmark::State& state, melon_allocator_api allocator)
+{
+    static const std::vector<op> ops = generate_ops();
+
+    std::vector<void*>    slots(num_slots, nullptr);
+    std::vector<uint64_t> latencies;
+    latencies.reserve(ops.size());
+
+    for (auto _ : state)
+    {
+        latencies.clear();
+        for (const op& o : ops)
+        {
+            auto start = std::chrono::steady_clock::now();
+            switch (o.type)
+            {
+                case OP_ALLOC: slots[o.slot] = MELON_ALLOC(allocator, o.size, MELON_DEFAULT_ALIGN); break;
+                case OP_REALLOC:
+                    slots[o.slot] = MELON_REALLOC(allocator, slots[o.slot], o.size, MELON_DEFAULT_ALIGN);
+                    break;
+                case OP_FREE: MELON_FREE(allocator, slots[o.slot]); break;
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            benchmark::DoNotOptimize(slots[o.slot]);
+            latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["p50_ns"]  = (double) latencies[latencies.size() / 2];
+    state.counters["p99_ns"]  = (double) latencies[latencies.size() * 99 / 100];
+    state.counters["p999_ns"] = (double) latencies[latencies.size() * 999 / 1000];
+    state.counters["max_ns"]  = (double) latencies.back();
+    state.SetItemsProcessed(state.iterations() * ops.size());
+}
+
+static void BM_tlsf_latency(benchmark::State& state)
+{
+    const size_t         region_size = MELON_MEGABYTE(64);
+    void*                memory      = malloc(region_size);
+    melon_tlsf_allocator tlsf;
+    melon_create_tlsf_allocator(&tlsf, memory, region_size);
+
+    run_latency_workload(state, melon_tlsf_allocator_api(&tlsf));
+
+    free(memory);
+}
+BENCHMARK(BM_tlsf_latency)->Unit(benchmark::kMillisecond);
+
+static void BM_default_allocator_latency(benchmark::State& state)
+{
+    run_latency_workload(state, *melon_default_cb_allocator());
+}
+BENCHMARK(BM_default_allocator_latency)->Unit(benchmark::kMillisecond);
@@ -1,6 +1,3 @@
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,33 +5,20 @@
 #include <melon/core/error.h>
 #include <melon/gfx.h>
 
-static GLenum glCheckError()
-{
-    GLenum errorCode;
-    while ((errorCode = glGetError()) != GL_NO_ERROR)
-    {
-        const char* error;
-        switch (errorCode)
-        {
-            case GL_INVALID_ENUM: error = "INVALID_ENUM"; break;
-            case GL_INVALID_VALUE: error = "INVALID_VALUE"; break;
-            case GL_INVALID_OPERATION: error = "INVALID_OPERATION"; break;
-            case GL_STACK_OVERFLOW: error = "STACK_OVERFLOW"; break;
-            case GL_STACK_UNDERFLOW: error = "STACK_UNDERFLOW"; break;
-            case GL_OUT_OF_MEMORY: error = "OUT_OF_MEMORY"; break;
-            case GL_INVALID_FRAMEBUFFER_OPERATION: error = "INVALID_FRAMEBUFFER_OPERATION"; break;
-        }
-        printf("%s\n", error);
-    }
-    return errorCode;
-}
-
 #define WIDTH 800
 #define HEIGHT 600
 
 int main(int argc, char** argv)
 {
-    if (!melon_gfx_init(NULL))
+    // GL runs on the render thread, this thread only records and submits
+    melon_device_params device_params = *melon_default_device_params();
+    device_params.render_thread       = true;
+
+    melon_gfx_config gfx_config = {0};
+    gfx_config.device_params    = &device_params;
+    gfx_config.input_params     = melon_default_input_params();
+
+    if (!melon_gfx_init(&gfx_config))
     {
         exit(EXIT_FAILURE);
     }
@@ -111,31 +95,31 @@ int main(int argc, char** argv)
         draw_calls.num_vertices = 3;
     }
 
-    melon_draw_group melon_draw_group = {0};
-    {
-        melon_draw_group.pipeline  = pipeline;
-        {
-            melon_draw_group.resources.buffers[0] = vertex_buffer;
-        }
-        melon_draw_group.draw_calls     = &draw_calls;
-        melon_draw_group.num_draw_calls = 1;
-    }
-    
-    glClearColor(0, 0, 0, 0);
+    const float clear_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    melon_command_buffer_handle command_buffer = melon_create_command_buffer();
     while (!melon_window_should_close(window))
     {
         melon_poll_input_events();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        melon_execute_draw_groups(&melon_draw_group, 1);
-        glCheckError();
+        melon_begin_recording(command_buffer);
+        melon_cmd_clear(command_buffer, clear_color);
+        melon_cmd_bind_pipeline(command_buffer, pipeline);
+        melon_cmd_bind_vertex_buffer(command_buffer, vertex_buffer, 0, 0);
+        melon_cmd_draw(command_buffer, &draw_calls);
+        melon_end_recording(command_buffer);
 
+        // The swap is queued behind the submission on the render thread
+        melon_submit_command_buffers(&command_buffer, 1);
         melon_swap_buffers(window);
     }
 
+    melon_delete_command_buffer(command_buffer);
+    melon_delete_buffer(vertex_buffer);
     melon_delete_shader(shader_program);
     melon_delete_pipeline(pipeline);
 
+    melon_destroy_window(window);
     melon_gfx_destroy();
 
     return 0;
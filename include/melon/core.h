@@ -15,7 +15,20 @@ extern "C"
 
 #include <melon/core/error.h>
 #include <melon/core/memory.h>
+#include <melon/core/atomic.h>
+#include <melon/core/concurrent_arena.h>
+#include <melon/core/frame_arena.h>
+#include <melon/core/job.h>
+#include <melon/core/task_graph.h>
+#include <melon/core/timer.h>
 #include <melon/core/handle.h>
+#include <melon/core/concurrent_handle.h>
+#include <melon/core/virtual_memory.h>
+#include <melon/core/huge_pages.h>
+#include <melon/core/slab.h>
+#include <melon/core/tlsf.h>
+#include <melon/core/buddy.h>
+#include <melon/core/memory_tracking.h>
 
 #ifdef __cplusplus
 }
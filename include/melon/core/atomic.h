@@ -0,0 +1,109 @@
+#ifndef MELON_ATOMIC_H
+#define MELON_ATOMIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// atomics - the handful of atomic operations the core needs, mapped onto the
+// GCC/Clang __atomic builtins or the MSVC Interlocked intrinsics.
+//
+// Loads acquire, stores release and read-modify-write operations are
+// sequentially consistent. melon_atomic_thread_fence is a full fence.
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(_MSC_VER)
+
+static inline uint32_t melon_atomic_load_u32(volatile uint32_t* ptr) { return (uint32_t) _InterlockedOr((volatile long*) ptr, 0); }
+static inline uint64_t melon_atomic_load_u64(volatile uint64_t* ptr) { return (uint64_t) _InterlockedOr64((volatile __int64*) ptr, 0); }
+static inline void*    melon_atomic_load_ptr(void* volatile* ptr) { return _InterlockedCompareExchangePointer(ptr, NULL, NULL); }
+
+static inline void melon_atomic_store_u32(volatile uint32_t* ptr, uint32_t value) { _InterlockedExchange((volatile long*) ptr, (long) value); }
+static inline void melon_atomic_store_u64(volatile uint64_t* ptr, uint64_t value) { _InterlockedExchange64((volatile __int64*) ptr, (__int64) value); }
+static inline void melon_atomic_store_ptr(void* volatile* ptr, void* value) { _InterlockedExchangePointer(ptr, value); }
+
+static inline uint32_t melon_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    return (uint32_t) _InterlockedExchangeAdd((volatile long*) ptr, (long) value);
+}
+static inline uint64_t melon_atomic_fetch_add_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    return (uint64_t) _InterlockedExchangeAdd64((volatile __int64*) ptr, (__int64) value);
+}
+
+static inline bool melon_atomic_cas_u32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired)
+{
+    return (uint32_t) _InterlockedCompareExchange((volatile long*) ptr, (long) desired, (long) expected) == expected;
+}
+static inline bool melon_atomic_cas_u64(volatile uint64_t* ptr, uint64_t expected, uint64_t desired)
+{
+    return (uint64_t) _InterlockedCompareExchange64((volatile __int64*) ptr, (__int64) desired, (__int64) expected) == expected;
+}
+static inline bool melon_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired)
+{
+    return _InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+}
+
+static inline void melon_atomic_thread_fence() { _mm_mfence(); }
+
+static inline void melon_cpu_relax() { _mm_pause(); }
+
+#else
+
+static inline uint32_t melon_atomic_load_u32(volatile uint32_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+static inline uint64_t melon_atomic_load_u64(volatile uint64_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+static inline void*    melon_atomic_load_ptr(void* volatile* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+
+static inline void melon_atomic_store_u32(volatile uint32_t* ptr, uint32_t value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+static inline void melon_atomic_store_u64(volatile uint64_t* ptr, uint64_t value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+static inline void melon_atomic_store_ptr(void* volatile* ptr, void* value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+
+static inline uint32_t melon_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+static inline uint64_t melon_atomic_fetch_add_u64(volatile uint64_t* ptr, uint64_t value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool melon_atomic_cas_u32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline bool melon_atomic_cas_u64(volatile uint64_t* ptr, uint64_t expected, uint64_t desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline bool melon_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline void melon_atomic_thread_fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline void melon_cpu_relax() { __builtin_ia32_pause(); }
+#elif defined(__aarch64__)
+static inline void melon_cpu_relax() { __asm__ __volatile__("yield"); }
+#else
+static inline void melon_cpu_relax() {}
+#endif
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
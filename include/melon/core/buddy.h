@@ -0,0 +1,52 @@
+#ifndef MELON_BUDDY_H
+#define MELON_BUDDY_H
+
+#include <melon/core/memory.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// buddy - power of two offset allocator for memory the CPU can't touch.
+//
+// Hands out offsets into a range of size bytes, typically a GPU buffer. All
+// bookkeeping lives in a host side tree with one byte per node recording the
+// largest free block below it, so allocating and freeing are O(log n). Every
+// block is a power of two of at least min_block_size bytes and its offset is
+// aligned to its size.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MELON_BUDDY_INVALID_OFFSET (~(size_t) 0)
+
+typedef struct
+{
+    // Per node, one plus the level of the largest free block in its subtree. 0 if it has no free block
+    uint8_t* longest;
+
+    size_t   size;
+    size_t   min_block_size;
+    uint32_t levels;
+    size_t   used_size;
+
+    melon_allocator_api allocator;
+} melon_buddy_allocator;
+
+// size and min_block_size must be powers of two. Returns false if they aren't or the tree can't be allocated
+bool melon_create_buddy_allocator(melon_buddy_allocator* buddy, size_t size, size_t min_block_size,
+                                  const melon_allocator_api* allocator);
+void melon_destroy_buddy_allocator(melon_buddy_allocator* buddy);
+
+// Returns the offset of a block of at least size bytes, or MELON_BUDDY_INVALID_OFFSET if there is no room
+size_t melon_buddy_alloc(melon_buddy_allocator* buddy, size_t size);
+void   melon_buddy_free(melon_buddy_allocator* buddy, size_t offset);
+// Size of the block allocated at offset
+size_t melon_buddy_block_size(const melon_buddy_allocator* buddy, size_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
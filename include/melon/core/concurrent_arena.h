@@ -0,0 +1,54 @@
+#ifndef MELON_CONCURRENT_ARENA_H
+#define MELON_CONCURRENT_ARENA_H
+
+#include <melon/core/memory.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// concurrent arena - linear allocator that many threads can push to at once.
+//
+// A push is a single atomic fetch-add on the current block's offset. The
+// thread whose push runs off the end of a block allocates a new one and
+// installs it with a CAS; threads that lose the race free theirs and retry on
+// the winner's block. Reset and destroy must not overlap with any push.
+//
+// New blocks are allocated by whichever thread overflows the current one, so
+// several threads can call into the inner allocator at once. It has to be
+// thread safe; the default allocator is, tracking and huge page allocators are
+// not unless they are wrapped in a lock.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct melon_concurrent_block
+{
+    uint8_t* start;
+    size_t   size;
+    // Bumped past size by pushes that overflowed the block
+    volatile uint64_t offset;
+
+    struct melon_concurrent_block* prev;
+} melon_concurrent_block;
+
+typedef struct
+{
+    melon_concurrent_block* volatile current_block;
+
+    size_t              block_size;
+    melon_allocator_api allocator;
+} melon_concurrent_arena;
+
+// New blocks are at least block_size bytes, or large enough for the push that overflowed
+void  melon_create_concurrent_arena(melon_concurrent_arena* arena, size_t block_size, const melon_allocator_api* alloc);
+void  melon_destroy_concurrent_arena(melon_concurrent_arena* arena);
+void* melon_concurrent_arena_push_size(melon_concurrent_arena* arena, size_t size, size_t align);
+// Frees every block but the current one and rewinds it. Not thread safe
+void melon_concurrent_arena_reset(melon_concurrent_arena* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
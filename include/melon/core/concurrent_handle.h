@@ -0,0 +1,52 @@
+#ifndef MELON_CONCURRENT_HANDLE_H
+#define MELON_CONCURRENT_HANDLE_H
+
+#include <melon/core/handle.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// concurrent pool - a handle pool that many threads can create, delete and
+// validate handles in at once.
+//
+// Handles use the default 32/32 layout of melon_handle_pool. The free list is
+// a lock-free stack whose head is the handle of the top slot: since a slot's
+// generation is bumped every time it is freed, the generation bits double as
+// the ABA tag of the head. Validating a handle is a single atomic load and is
+// wait-free.
+//
+// The capacity is fixed on creation.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    volatile uint32_t* generations;
+    volatile uint32_t* next_free;
+    size_t             capacity;
+    // High-water mark: slots at or past it have never been handed out
+    volatile uint32_t num_initialized;
+    // Handle of the top of the free list, or MELON_INVALID_HANDLE if it is empty
+    volatile uint64_t freelist_head;
+
+    melon_allocator_api allocator;
+} melon_concurrent_handle_pool;
+
+void melon_create_concurrent_handle_pool(melon_concurrent_handle_pool* pool, size_t capacity,
+                                         const melon_allocator_api* allocator);
+// Not thread safe
+void melon_delete_concurrent_handle_pool(melon_concurrent_handle_pool* pool);
+
+// Returns MELON_INVALID_HANDLE once every slot is in use
+melon_handle melon_concurrent_pool_create_handle(melon_concurrent_handle_pool* pool);
+// When several threads delete the same handle, exactly one of them succeeds
+bool melon_concurrent_pool_delete_handle(melon_concurrent_handle_pool* pool, melon_handle handle);
+bool melon_concurrent_handle_is_valid(melon_concurrent_handle_pool* pool, melon_handle handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MELON_FRAME_ARENA_H
+#define MELON_FRAME_ARENA_H
+
+#include <melon/core/memory.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// frame arena - ring of arenas for data that lives as long as a frame in flight
+//
+// Each frame in flight owns one partition. Beginning frame i resets only
+// partition i, so everything pushed during the previous use of that slot is
+// freed at once while the other frames stay intact. Every begin hands out a
+// new frame id that can later be checked to catch pointers kept past the
+// frame that allocated them. Debug builds also poison recycled memory.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MELON_MAX_FRAMES_IN_FLIGHT 4
+#define MELON_FRAME_ARENA_POISON 0xdd
+
+typedef struct
+{
+    melon_memory_arena partitions[MELON_MAX_FRAMES_IN_FLIGHT];
+    // Id of the frame currently occupying each partition, 0 if it was never begun
+    uint64_t partition_frame_ids[MELON_MAX_FRAMES_IN_FLIGHT];
+
+    uint32_t frame_count;
+    uint32_t current_partition;
+    uint64_t last_frame_id;
+} melon_frame_arena;
+
+void melon_create_frame_arena(melon_frame_arena* frames, uint32_t frame_count, size_t partition_size,
+                              const melon_allocator_api* alloc);
+void melon_destroy_frame_arena(melon_frame_arena* frames);
+
+// Recycles partition frame_index and makes it the target of pushes. Returns the id of the new frame
+uint64_t melon_frame_arena_begin_frame(melon_frame_arena* frames, uint32_t frame_index);
+void*    melon_frame_arena_push_size(melon_frame_arena* frames, size_t size, size_t align);
+
+// Returns true if ptr was pushed during frame_id and that frame's partition hasn't been recycled since
+bool melon_frame_arena_is_live(const melon_frame_arena* frames, const void* ptr, uint64_t frame_id);
+
+#define MELON_FRAME_PUSH_STRUCT(frames, T) ((T*) melon_frame_arena_push_size(&frames, sizeof(T), sizeof(T)))
+#define MELON_FRAME_PUSH_ARRAY(frames, T, length, align) \
+    ((T*) melon_frame_arena_push_size(&frames, sizeof(T) * (length), align))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
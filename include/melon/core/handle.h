@@ -7,6 +7,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 // pool - an index pool with a stack-like behavior. Indices are allocated in
 // a FIFO order.
+//
+// Recycled indices go through the free list. Indices that were never handed
+// out are taken by bumping a high-water mark, so creating, growing and
+// resetting a pool don't touch its entries.
 ////////////////////////////////////////////////////////////////////////////////
 
 /* TODO:
@@ -16,7 +20,7 @@
  *      - Less indirection when doing a lookup of above, because user won't
  *        have to create their own array to map indices to pointers/offsets
  * - CONs:
- *      - handle_entries array slightly less packed, possible cache issues
+ *      - one more per-slot array to keep in sync and to grow
  */
 
 #ifdef __cplusplus
@@ -39,17 +43,28 @@ typedef uint64_t melon_handle;
 
 static inline uint64_t melon_handle_index(melon_handle handle) { return handle & MELON_HANDLE_INDEX_MASK; }
 
+/* melon_handle_pool - slot state is kept in separate arrays
+ *
+ * generations holds the current generation of each slot, or generation_max once the slot is retired, so validating a
+ * handle reads 4 bytes. next_free links the free list and is only touched when slots are freed and reused. Slots that
+ * are handed out link to themselves.
+ *
+ * The split between index and generation bits is chosen per pool on creation. Pools created with
+ * melon_create_handle_pool use the 32/32 layout described by the MELON_HANDLE_* defines above.
+ */
 typedef struct
 {
-    melon_handle handle;
-    // size_t data_offset;
-    size_t next_handle_index;
-} melon_handle_entry;
+    uint32_t     index_bits;
+    uint32_t     generation_max;
+    melon_handle index_mask;
+    // All index and generation bits set
+    melon_handle invalid_handle;
 
-typedef struct
-{
-    melon_handle_entry* handle_entries;
-    size_t            capacity;
+    uint32_t* generations;
+    uint32_t* next_free;
+    size_t    capacity;
+    // High-water mark: slots at or past it have never been handed out and are uninitialized
+    size_t num_initialized;
 
     size_t freelist_head_index;
     size_t freelist_tail_index;
@@ -60,15 +75,68 @@ typedef struct
 } melon_handle_pool;
 
 void melon_create_handle_pool(melon_handle_pool* pool, size_t capacity, const melon_allocator_api* allocator, bool grow_by_default);
+// index_bits and generation_bits are both at most 32. Handles stored in a narrower type must keep their sum within the
+// width of that type, see MELON_HANDLE_TYPEDEF
+void melon_create_handle_pool_with_layout(melon_handle_pool* pool, size_t capacity,
+                                          const melon_allocator_api* allocator, bool grow_by_default,
+                                          uint32_t index_bits, uint32_t generation_bits);
 void melon_delete_handle_pool(melon_handle_pool* pool);
 void melon_pool_reset(melon_handle_pool* pool);
 
 // Create a new handle. The grow parameter overrides the "grow_by_default" flag set on creation
 melon_handle melon_pool_create_handle(melon_handle_pool* pool);
 bool         melon_handle_is_valid(melon_handle_pool* pool, melon_handle handle);
-melon_handle melon_pool_invalid_handle();
+// The invalid handle of the pool's layout, which is what creating a handle returns when the pool is full
+melon_handle melon_pool_invalid_handle(const melon_handle_pool* pool);
 bool         melon_pool_delete_handle(melon_handle_pool* pool, melon_handle index);
 
+// Batch versions of the functions above. Growth is checked once per call instead of once per handle.
+// Creates up to count handles, fills the rest with invalid handles and returns how many were created
+size_t melon_pool_create_handles(melon_handle_pool* pool, melon_handle* handles, size_t count);
+// Returns how many handles were valid and deleted
+size_t melon_pool_delete_handles(melon_handle_pool* pool, const melon_handle* handles, size_t count);
+// Writes whether each handle is valid to valid and returns the number of valid handles
+size_t melon_handles_are_valid(melon_handle_pool* pool, const melon_handle* handles, bool* valid, size_t count);
+
+static inline uint64_t melon_pool_handle_index(const melon_handle_pool* pool, melon_handle handle)
+{
+    return handle & pool->index_mask;
+}
+
+/* MELON_HANDLE_TYPEDEF - a handle type with a fixed bit layout
+ *
+ * Declares the handle type name with index_bits of index and the remaining bits of T as generation, along with
+ * functions that create pools of that layout and convert to and from melon_handle:
+ *
+ *     MELON_HANDLE_TYPEDEF(mesh_handle, uint32_t, 20)
+ *
+ *     melon_handle_pool pool;
+ *     mesh_handle_create_pool(&pool, 64, &allocator, true);
+ *     mesh_handle mesh = mesh_handle_create(&pool);
+ */
+#define MELON_HANDLE_TYPEDEF(name, T, index_bits)                                                                \
+    typedef T name;                                                                                              \
+    static inline void name##_create_pool(melon_handle_pool* pool, size_t capacity,                              \
+                                          const melon_allocator_api* allocator, bool grow_by_default)            \
+    {                                                                                                            \
+        melon_create_handle_pool_with_layout(pool, capacity, allocator, grow_by_default, index_bits,             \
+                                             (uint32_t) (sizeof(T) * 8 - (index_bits)));                         \
+    }                                                                                                            \
+    static inline name name##_create(melon_handle_pool* pool) { return (name) melon_pool_create_handle(pool); }  \
+    static inline bool name##_is_valid(melon_handle_pool* pool, name handle)                                     \
+    {                                                                                                            \
+        return melon_handle_is_valid(pool, (melon_handle) handle);                                               \
+    }                                                                                                            \
+    static inline bool name##_delete(melon_handle_pool* pool, name handle)                                       \
+    {                                                                                                            \
+        return melon_pool_delete_handle(pool, (melon_handle) handle);                                            \
+    }                                                                                                            \
+    static inline uint64_t name##_index(name handle)                                                             \
+    {                                                                                                            \
+        return (uint64_t) handle & (((uint64_t) 1 << (index_bits)) - 1);                                         \
+    }                                                                                                            \
+    static inline name     name##_invalid() { return (name) ~(T) 0; }
+
 ////////////////////////////////////////////////////////////////////////////////
 // melon_map - a vector that uses an id pool for access
 ////////////////////////////////////////////////////////////////////////////////
@@ -82,13 +150,27 @@ bool         melon_pool_delete_handle(melon_handle_pool* pool, melon_handle inde
 
 #define melon_create_map(vec, capacity, allocator, grow_by_default) \
     _melon_create_map((void**) &((vec)->data), &((vec)->map), capacity, sizeof(*((vec)->data)), allocator, grow_by_default)
+// Creates a map whose handles use the given layout, see melon_create_handle_pool_with_layout
+#define melon_create_map_with_layout(vec, capacity, allocator, grow_by_default, index_bits, generation_bits) \
+    _melon_create_map_with_layout((void**) &((vec)->data), &((vec)->map), capacity, sizeof(*((vec)->data)),  \
+                                  allocator, grow_by_default, index_bits, generation_bits)
 #define melon_delete_map(vec) _melon_delete_map(&((vec)->map))
 #define melon_map_push(vec, val) _melon_map_push(&((vec)->map), (void*) (val))
-#define melon_map_get(vec, handle) \
-    (melon_handle_is_valid(&((vec)->map.pool), handle) ? (vec)->data + melon_handle_index(handle) : NULL)
+#define melon_map_get(vec, handle)                                           \
+    (melon_handle_is_valid(&((vec)->map.pool), handle)                       \
+         ? (vec)->data + melon_pool_handle_index(&((vec)->map.pool), handle) \
+         : NULL)
 #define melon_map_set(vec, handle, val) _melon_map_set(&((vec)->map), handle, (const* void) (val))
 #define melon_map_delete(vec, handle) _melon_map_delete(&((vec)->map), handle)
 #define melon_map_handle_is_valid(vec, handle) melon_handle_is_valid(&(((vec)->map).pool), handle)
+#define melon_map_push_array(vec, vals, handles, count) \
+    _melon_map_push_array(&((vec)->map), (const void*) (vals), handles, count)
+#define melon_map_delete_array(vec, handles, count) _melon_map_delete_array(&((vec)->map), handles, count)
+#define melon_map_handles_are_valid(vec, handles, valid, count) \
+    melon_handles_are_valid(&(((vec)->map).pool), handles, valid, count)
+#define melon_map_compact(vec, max_bytes, remap, user_data) \
+    _melon_map_compact(&((vec)->map), max_bytes, remap, user_data)
+#define melon_map_shrink(vec) _melon_map_shrink(&((vec)->map))
 
 typedef struct
 {
@@ -105,11 +187,147 @@ typedef struct
 // Growable indicates grow_by_default by default
 void _melon_create_map(void** data_ptr, _melon_map* pv, size_t capacity, size_t element_size,
                        const melon_allocator_api* allocator, bool grow_by_default);
+void _melon_create_map_with_layout(void** data_ptr, _melon_map* pv, size_t capacity, size_t element_size,
+                                   const melon_allocator_api* allocator, bool grow_by_default, uint32_t index_bits,
+                                   uint32_t generation_bits);
 void _melon_delete_map(_melon_map* pv);
 // Push a new object with a new handle. The grow parameter overrides the "grow_by_default" flag set on creation
 melon_handle _melon_map_push(_melon_map* pv, const void* val);
 bool         _melon_map_delete(_melon_map* pv, const melon_handle handle);
 bool         _melon_map_set(_melon_map* pv, melon_handle handle, const void* val);
+// Push count objects from the vals array, see melon_pool_create_handles
+size_t _melon_map_push_array(_melon_map* pv, const void* vals, melon_handle* handles, size_t count);
+size_t _melon_map_delete_array(_melon_map* pv, const melon_handle* handles, size_t count);
+
+// Called for every element moved by compaction. old_handle is invalid from then on
+typedef void (*melon_map_remap_fn)(melon_handle old_handle, melon_handle new_handle, void* user_data);
+
+/* _melon_map_compact - incrementally moves live elements toward the front of the map
+ *
+ * Moves the elements in the highest live slots into the lowest free slots, copying at most max_bytes of elements (and
+ * at least one element) per call, and reports each move through remap. Call it once per frame until it returns 0. The
+ * free list is relinked in index order on each call, which is linear in the number of slots.
+ */
+size_t _melon_map_compact(_melon_map* pv, size_t max_bytes, melon_map_remap_fn remap, void* user_data);
+// Shrinks the data array to end at the last live element. The slot arrays of the pool are kept
+void _melon_map_shrink(_melon_map* pv);
+
+////////////////////////////////////////////////////////////////////////////////
+// melon_paged_map - a melon_map with stable element addresses
+//
+// Elements live in fixed size pages of MELON_PAGED_MAP_PAGE_SIZE elements
+// that are allocated as handle indices reach them. Growing only extends the
+// page table, so pointers returned by melon_paged_map_get stay valid until the
+// element is deleted and no element is ever copied.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MELON_PAGED_MAP_PAGE_SHIFT 8
+#define MELON_PAGED_MAP_PAGE_SIZE ((size_t) 1 << MELON_PAGED_MAP_PAGE_SHIFT)
+#define MELON_PAGED_MAP_PAGE_MASK (MELON_PAGED_MAP_PAGE_SIZE - 1)
+
+#define MELON_PAGED_MAP_TYPEDEF(T) \
+    typedef struct                 \
+    {                              \
+        T**              pages;    \
+        _melon_paged_map map;      \
+    } melon_paged_map_##T;
+
+#define melon_create_paged_map(vec, capacity, allocator, grow_by_default)                                \
+    _melon_create_paged_map((void***) &((vec)->pages), &((vec)->map), capacity, sizeof(**((vec)->pages)), \
+                            allocator, grow_by_default)
+#define melon_delete_paged_map(vec) _melon_delete_paged_map(&((vec)->map))
+#define melon_paged_map_push(vec, val) _melon_paged_map_push(&((vec)->map), (const void*) (val))
+#define melon_paged_map_get(vec, handle)                                                                   \
+    (melon_handle_is_valid(&((vec)->map.pool), handle)                                                     \
+         ? (vec)->pages[melon_pool_handle_index(&((vec)->map.pool), handle) >> MELON_PAGED_MAP_PAGE_SHIFT] \
+               + (melon_pool_handle_index(&((vec)->map.pool), handle) & MELON_PAGED_MAP_PAGE_MASK)         \
+         : NULL)
+#define melon_paged_map_set(vec, handle, val) _melon_paged_map_set(&((vec)->map), handle, (const void*) (val))
+#define melon_paged_map_delete(vec, handle) _melon_paged_map_delete(&((vec)->map), handle)
+#define melon_paged_map_handle_is_valid(vec, handle) melon_handle_is_valid(&(((vec)->map).pool), handle)
+
+typedef struct
+{
+    melon_handle_pool pool;
+
+    // Points at the pages member of the typed wrapper
+    void*** pages;
+    size_t  page_count;
+    size_t  page_table_capacity;
+    size_t  element_size;
+
+    melon_allocator_api allocator;
+} _melon_paged_map;
+
+void _melon_create_paged_map(void*** pages_ptr, _melon_paged_map* pm, size_t capacity, size_t element_size,
+                             const melon_allocator_api* allocator, bool grow_by_default);
+void _melon_delete_paged_map(_melon_paged_map* pm);
+// Push a new object with a new handle. Allocates a page when the handle's index is past the last page
+melon_handle _melon_paged_map_push(_melon_paged_map* pm, const void* val);
+bool         _melon_paged_map_delete(_melon_paged_map* pm, const melon_handle handle);
+bool         _melon_paged_map_set(_melon_paged_map* pm, melon_handle handle, const void* val);
+
+////////////////////////////////////////////////////////////////////////////////
+// melon_dense_map - a map that keeps its live elements packed
+//
+// Elements are stored contiguously in the order they were pushed, with a
+// sparse table mapping handle indices to their slot. Deleting moves the last
+// element into the hole, so iterating over data visits live elements only.
+// Pointers are invalidated by push and delete.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MELON_DENSE_MAP_TYPEDEF(T) \
+    typedef struct                 \
+    {                              \
+        T*               data;     \
+        _melon_dense_map map;      \
+    } melon_dense_map_##T;
+
+#define melon_create_dense_map(vec, capacity, allocator, grow_by_default)                                \
+    _melon_create_dense_map((void**) &((vec)->data), &((vec)->map), capacity, sizeof(*((vec)->data)), \
+                            allocator, grow_by_default)
+#define melon_delete_dense_map(vec) _melon_delete_dense_map(&((vec)->map))
+#define melon_dense_map_push(vec, val) _melon_dense_map_push(&((vec)->map), (const void*) (val))
+#define melon_dense_map_get(vec, handle)                                                   \
+    (melon_handle_is_valid(&((vec)->map.pool), handle)                                     \
+         ? (vec)->data + (vec)->map.slots[melon_pool_handle_index(&((vec)->map.pool), handle)] \
+         : NULL)
+#define melon_dense_map_set(vec, handle, val) _melon_dense_map_set(&((vec)->map), handle, (const void*) (val))
+#define melon_dense_map_delete(vec, handle) _melon_dense_map_delete(&((vec)->map), handle)
+#define melon_dense_map_handle_is_valid(vec, handle) melon_handle_is_valid(&(((vec)->map).pool), handle)
+#define melon_dense_map_count(vec) ((vec)->map.count)
+// Handle of the element in the given dense slot
+#define melon_dense_map_handle_at(vec, slot) ((vec)->map.handles[slot])
+// Iterates over live elements only: melon_dense_map_for_each(&sprites, sprite, s) { s->x += 1; }
+#define melon_dense_map_for_each(vec, T, it) for (T* it = (vec)->data; it != (vec)->data + (vec)->map.count; it++)
+
+typedef struct
+{
+    melon_handle_pool pool;
+
+    // Points at the data member of the typed wrapper
+    void** data;
+    size_t count;
+    size_t capacity;
+    size_t element_size;
+
+    // Dense slot of each handle index
+    size_t* slots;
+    size_t  slots_capacity;
+    // Handle of each dense slot, used to fix up slots when an element is moved
+    melon_handle* handles;
+
+    melon_allocator_api allocator;
+} _melon_dense_map;
+
+void _melon_create_dense_map(void** data_ptr, _melon_dense_map* dm, size_t capacity, size_t element_size,
+                             const melon_allocator_api* allocator, bool grow_by_default);
+void _melon_delete_dense_map(_melon_dense_map* dm);
+// Push a new object to the end of the dense array with a new handle
+melon_handle _melon_dense_map_push(_melon_dense_map* dm, const void* val);
+// Delete the object and move the last object into its slot
+bool _melon_dense_map_delete(_melon_dense_map* dm, const melon_handle handle);
+bool _melon_dense_map_set(_melon_dense_map* dm, melon_handle handle, const void* val);
 
 #ifdef __cplusplus
 }
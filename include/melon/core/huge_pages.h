@@ -0,0 +1,40 @@
+#ifndef MELON_HUGE_PAGES_H
+#define MELON_HUGE_PAGES_H
+
+#include <melon/core/memory.h>
+#include <melon/core/virtual_memory.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// huge page allocator - backs large allocations with 2MB pages
+//
+// Allocations of at least threshold bytes get their own mapping from
+// melon_vm_alloc_huge, which cuts the TLB misses of walking big arena blocks
+// and map storage. Smaller allocations are forwarded to the backing
+// allocator. Wrap only the allocators that own large, hot buffers.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    size_t              threshold;
+    melon_allocator_api backing;
+
+    // Number of live allocations mapped with each kind of page
+    size_t live_mappings[MELON_VM_TRANSPARENT_HUGE_PAGES + 1];
+} melon_huge_page_allocator;
+
+void melon_create_huge_page_allocator(melon_huge_page_allocator* huge, size_t threshold,
+                                      const melon_allocator_api* backing);
+
+// Returns callbacks that allocate from the huge page allocator, usable anywhere a melon_allocator_api is taken
+melon_allocator_api melon_huge_page_allocator_api(melon_huge_page_allocator* huge);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
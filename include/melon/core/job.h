@@ -0,0 +1,105 @@
+#ifndef MELON_JOB_H
+#define MELON_JOB_H
+
+#include <melon/core/memory.h>
+#include <stdbool.h>
+#include <tinycthread.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// job system - spreads work over a fixed set of worker threads.
+//
+// Every worker, including the thread that created the system, owns a
+// Chase-Lev deque. A worker pushes and pops jobs at the bottom of its own
+// deque and steals from the top of the others' when it runs out of work.
+// Workers with nothing to steal go to sleep until new jobs are queued.
+//
+// Jobs are grouped by a counter that is incremented when they are queued and
+// decremented as they finish. Waiting on a counter runs other jobs until it
+// reaches zero, so jobs can queue and wait on jobs of their own.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MELON_MAX_JOB_WORKERS 64
+// Must be a power of 2. Jobs queued into a full deque run right away
+#define MELON_JOB_DEQUE_CAPACITY 4096
+
+typedef void (*melon_job_fn)(void* data);
+
+typedef struct
+{
+    volatile uint32_t pending;
+} melon_job_counter;
+
+typedef struct
+{
+    melon_job_fn       fn;
+    void*              data;
+    melon_job_counter* counter;
+} melon_job;
+
+typedef struct
+{
+    // The owner works on the bottom and thieves take from the top, so they are kept on separate cache lines
+    volatile uint64_t top;
+    uint8_t           top_padding[64 - sizeof(uint64_t)];
+    volatile uint64_t bottom;
+    uint8_t           bottom_padding[64 - sizeof(uint64_t)];
+
+    melon_job* jobs;
+} melon_job_deque;
+
+struct melon_job_system;
+
+typedef struct
+{
+    struct melon_job_system* system;
+    size_t                   index;
+    uint32_t                 steal_seed;
+    thrd_t                   thread;
+} melon_job_worker;
+
+typedef struct melon_job_system
+{
+    size_t           worker_count;
+    melon_job_worker workers[MELON_MAX_JOB_WORKERS];
+    melon_job_deque  deques[MELON_MAX_JOB_WORKERS];
+    // Index of the calling worker plus one, unset on threads that aren't workers
+    tss_t worker_index;
+
+    volatile uint32_t running;
+    // Jobs that were queued and haven't been taken by a worker yet
+    volatile uint32_t queued;
+    volatile uint32_t sleeping;
+    mtx_t             sleep_lock;
+    cnd_t             wake;
+
+    melon_allocator_api allocator;
+} melon_job_system;
+
+// Starts worker_count - 1 threads; the calling thread is worker 0 and runs jobs while it waits
+bool melon_create_job_system(melon_job_system* system, size_t worker_count, const melon_allocator_api* allocator);
+// Waits for the worker threads to exit. Jobs that are still queued are not run
+void melon_destroy_job_system(melon_job_system* system);
+
+// Queues jobs and adds them to counter. Must be called from worker 0 or from a job
+void melon_job_system_run(melon_job_system* system, const melon_job* jobs, size_t count, melon_job_counter* counter);
+// Runs one queued job, if any can be found, on the calling worker
+bool melon_job_system_try_run(melon_job_system* system);
+// Runs jobs until every job added to counter has finished
+void melon_job_system_wait(melon_job_system* system, melon_job_counter* counter);
+
+typedef void (*melon_parallel_for_fn)(void* data, size_t begin, size_t end);
+
+// Calls fn over [0, count) in ranges of at most batch_size and waits for all of them to finish
+void melon_parallel_for(melon_job_system* system, size_t count, size_t batch_size, melon_parallel_for_fn fn,
+                        void* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
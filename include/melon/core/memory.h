@@ -1,6 +1,8 @@
 #ifndef MELON_MEMORY_H
 #define MELON_MEMORY_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -20,8 +22,11 @@ static inline void* melon_align_forward(void* ptr, size_t align)
 {
     if (align == 0)
         return ptr;
-    uintptr_t uint_ptr = (uintptr_t) ptr;
-    return (void*) (uint_ptr + (align - (uint_ptr % align)));
+    uintptr_t uint_ptr  = (uintptr_t) ptr;
+    uintptr_t remainder = uint_ptr % align;
+    if (remainder == 0)
+        return ptr;
+    return (void*) (uint_ptr + (align - remainder));
 }
 
 static inline size_t melon_aligned_size(void* ptr, size_t size, size_t align)
@@ -66,23 +71,62 @@ typedef struct melon_memory_block
 typedef enum
 {
     MELON_NO_ALLOC_FLAGS      = 0,
-    MELON_ALLOC_EXPAND_DOUBLE = 1 << 1
+    MELON_ALLOC_EXPAND_DOUBLE = 1 << 1,
+    MELON_ALLOC_VIRTUAL       = 1 << 2
 } melon_alloc_flag;
 
+/* melon_block_cache - Blocks released by an arena, kept for reuse on the next overflow
+ *
+ * Blocks are binned by size class, starting at MELON_BLOCK_CACHE_MIN_CLASS (1KB). The last class holds every block
+ * larger than the classes before it. At most capacity blocks are kept; anything released past that is freed. hits and
+ * misses count overflows that were served from the cache and overflows that had to allocate.
+ */
+#define MELON_BLOCK_CACHE_CLASSES 16
+#define MELON_BLOCK_CACHE_MIN_CLASS 10
+#define MELON_BLOCK_CACHE_DEFAULT_CAPACITY 4
+
+typedef struct
+{
+    melon_memory_block* blocks[MELON_BLOCK_CACHE_CLASSES];
+    uint32_t            count;
+    uint32_t            capacity;
+
+    size_t hits;
+    size_t misses;
+} melon_block_cache;
+
 typedef struct
 {
     melon_memory_block* current_block;
 
     uint32_t allocation_flags;
+    uint32_t temp_count;
+
+    // Size of the address range backing a MELON_ALLOC_VIRTUAL arena
+    size_t reserved_size;
+
+    melon_block_cache block_cache;
 } melon_memory_arena;
 
+/* melon_arena_temp - Marker used to rewind an arena to a previous state
+ *
+ * Temp scopes can be nested, but must be ended in the reverse order in which they were begun. Ending a scope releases
+ * every block that was chained onto the arena after the scope began.
+ */
+typedef struct
+{
+    melon_memory_arena* arena;
+    melon_memory_block* block;
+    size_t              offset;
+} melon_arena_temp;
+
 #define MELON_DEFAULT_ALIGN 16
 
 #define MELON_GET_MACRO(_1, _2, _3, _4, NAME, ...) NAME
 
 #define MELON_ARENA_PUSH(arena, size, align) melon_arena_push_size(&arena, size, align)
 #define MELON_ARENA_PUSH_STRUCT(arena, T) ((T*) MELON_ARENA_PUSH(arena, sizeof(T), sizeof(T)))
-#define MELON_ARENA_PUSH_ARRAY(arena, T, length, align) ((T*) MELON_ARENA_PUSH(arena, sizeof(T) * length), sizeof(T))
+#define MELON_ARENA_PUSH_ARRAY(arena, T, length, align) ((T*) MELON_ARENA_PUSH(arena, sizeof(T) * (length), align))
 
 melon_memory_arena melon_create_arena_appended(melon_memory_block* prev, uint32_t alloc_flags, size_t size, size_t align, const melon_allocator_api* alloc);
 static inline melon_memory_arena melon_create_arena_with_options(uint32_t alloc_flags, size_t size, size_t align, const melon_allocator_api* alloc)
@@ -93,9 +137,31 @@ static inline melon_memory_arena melon_create_arena(size_t size, size_t align, c
 {
     return melon_create_arena_appended(NULL, MELON_ALLOC_EXPAND_DOUBLE, size, align, alloc);
 }
+
+/* melon_create_virtual_arena - Creates an arena backed by a single reserved address range
+ *
+ * reserve_size bytes of address space are reserved up front and pages are committed as the arena grows, so the arena
+ * never chains blocks and stays contiguous. Pushing past the reservation returns NULL.
+ * If the address range can't be reserved or the first pages can't be committed, the arena is left without a block
+ * and every push returns NULL. Resets, pops and temp scopes on such an arena do nothing.
+ */
+melon_memory_arena melon_create_virtual_arena(size_t reserve_size, size_t commit_size);
+
 void  melon_destroy_arena(melon_memory_arena* arena);
 void* melon_arena_push_size(melon_memory_arena* arena, size_t size, size_t align);
+// Resizes ptr in place when it is the last allocation pushed on the current block, otherwise pushes a copy. The old
+// copy stays on the arena until it is reset
+void* melon_arena_realloc(melon_memory_arena* arena, void* ptr, size_t old_size, size_t new_size, size_t align);
+// Releases ptr if it is the last allocation pushed on the current block. Returns false and does nothing otherwise
+bool melon_arena_pop(melon_memory_arena* arena, void* ptr, size_t size);
 void  melon_arena_reset(melon_memory_arena* arena);
+// Resets the arena and, for virtual arenas, returns committed pages above watermark bytes to the OS
+void melon_arena_reset_to_watermark(melon_memory_arena* arena, size_t watermark);
+// Frees every block held in the arena's block cache
+void melon_arena_trim_block_cache(melon_memory_arena* arena);
+
+melon_arena_temp melon_arena_begin_temp(melon_memory_arena* arena);
+void             melon_arena_end_temp(melon_arena_temp temp);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,63 @@
+#ifndef MELON_MEMORY_TRACKING_H
+#define MELON_MEMORY_TRACKING_H
+
+#include <melon/core/memory.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// tracking allocator - wraps another allocator and records statistics under a
+// tag. Every tracking allocator is registered so melon_memory_report() can
+// list them all.
+//
+// Tracking is only compiled in when MELON_TRACK_MEMORY is defined. Otherwise
+// melon_tracking_allocator_api() hands back the inner allocator untouched, so
+// allocations through it cost exactly what the inner allocator costs.
+//
+// Nothing here is synchronized. The statistics are plain counters and the
+// registry is a plain list, so a tracking allocator must only be used from one
+// thread at a time, or from behind a lock, and creating, destroying and
+// reporting must not overlap with each other or with allocations.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Bucket 0 counts allocations under 16 bytes, bucket i counts sizes in [2^(i+3), 2^(i+4)), the last bucket counts
+// everything bigger
+#define MELON_ALLOCATION_HISTOGRAM_BUCKETS 16
+
+typedef struct
+{
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t live_allocations;
+    size_t total_allocations;
+    size_t total_reallocations;
+    size_t total_frees;
+    size_t size_histogram[MELON_ALLOCATION_HISTOGRAM_BUCKETS];
+} melon_allocation_stats;
+
+typedef struct melon_tracking_allocator
+{
+    const char*            tag;
+    melon_allocator_api    inner;
+    melon_allocation_stats stats;
+
+    struct melon_tracking_allocator* next;
+} melon_tracking_allocator;
+
+// tag is not copied and has to outlive the tracking allocator
+void melon_create_tracking_allocator(melon_tracking_allocator* tracker, const char* tag,
+                                     const melon_allocator_api* inner);
+void melon_destroy_tracking_allocator(melon_tracking_allocator* tracker);
+
+melon_allocator_api melon_tracking_allocator_api(melon_tracking_allocator* tracker);
+
+// Logs the statistics of every registered tracking allocator through melon_logger_callback
+void melon_memory_report();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
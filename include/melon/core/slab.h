@@ -0,0 +1,60 @@
+#ifndef MELON_SLAB_H
+#define MELON_SLAB_H
+
+#include <melon/core/memory.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// slab allocator - fixed size class allocator with O(1) alloc and free.
+//
+// Allocations of up to MELON_SLAB_MAX_SIZE bytes with an alignment of at most
+// MELON_SLAB_MAX_ALIGN are rounded up to a size class and carved out of
+// page sized slabs. Slabs are committed on demand from one reserved address
+// range, so finding the slab that owns a pointer is a range check and a mask.
+// Everything else is forwarded to the backing allocator.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MELON_SLAB_CLASSES 20
+#define MELON_SLAB_MAX_SIZE 1024
+#define MELON_SLAB_MAX_ALIGN 16
+
+typedef struct melon_slab melon_slab;
+
+typedef struct
+{
+    // Slabs with at least one free object, per size class
+    melon_slab* partial_slabs[MELON_SLAB_CLASSES];
+    // Empty slabs that can be handed to any size class
+    melon_slab* free_slabs;
+
+    uint8_t* base;
+    size_t   reserved_size;
+    size_t   committed_size;
+    size_t   used_size;
+    size_t   slab_size;
+
+    uint8_t size_class_lookup[MELON_SLAB_MAX_SIZE / MELON_SLAB_MAX_ALIGN + 1];
+
+    melon_allocator_api backing;
+} melon_slab_allocator;
+
+// Reserves reserve_size bytes of address space for slabs. Requests the slabs can't serve go to backing
+void melon_create_slab_allocator(melon_slab_allocator* slab, size_t reserve_size, const melon_allocator_api* backing);
+void melon_destroy_slab_allocator(melon_slab_allocator* slab);
+
+void* melon_slab_alloc(melon_slab_allocator* slab, size_t size, size_t align);
+void* melon_slab_realloc(melon_slab_allocator* slab, void* ptr, size_t size, size_t align);
+void  melon_slab_free(melon_slab_allocator* slab, void* ptr);
+
+// Returns callbacks that allocate from the slab allocator, usable anywhere a melon_allocator_api is taken
+melon_allocator_api melon_slab_allocator_api(melon_slab_allocator* slab);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,99 @@
+#ifndef MELON_TASK_GRAPH_H
+#define MELON_TASK_GRAPH_H
+
+#include <melon/core/job.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// task graph - a fixed set of tasks executed every frame on the job system.
+//
+// Tasks declare which named resources they read and write. Compiling the graph
+// orders conflicting accesses by the order the tasks were added: a reader runs
+// after the last writer added before it, and a writer runs after the previous
+// writer and every reader in between. Tasks with no conflicts run in parallel.
+//
+// Every execution measures each task and records the critical path, the chain
+// of dependent tasks with the longest total duration.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MELON_TASK_GRAPH_MAX_TASKS 64
+#define MELON_TASK_GRAPH_MAX_RESOURCES 64
+
+typedef struct
+{
+    // Names are not copied
+    const char*  name;
+    melon_job_fn fn;
+    void*        data;
+    // Runs on the thread that executes the graph, eg. for input polling or GL calls
+    bool main_thread;
+} melon_task_desc;
+
+struct melon_task_graph;
+
+typedef struct
+{
+    melon_task_desc          desc;
+    struct melon_task_graph* graph;
+
+    // Bit masks of resource indices
+    uint64_t reads;
+    uint64_t writes;
+
+    // Bit masks of task indices, filled in by compile
+    uint64_t dependencies;
+    uint64_t dependents;
+    uint32_t dependency_count;
+
+    // Dependencies left to finish in the current execution
+    volatile uint32_t remaining;
+    uint64_t          start_ns;
+    uint64_t          end_ns;
+} melon_task;
+
+typedef struct melon_task_graph
+{
+    melon_task  tasks[MELON_TASK_GRAPH_MAX_TASKS];
+    size_t      task_count;
+    const char* resources[MELON_TASK_GRAPH_MAX_RESOURCES];
+    size_t      resource_count;
+
+    // Topological order, tasks on longer chains first
+    size_t order[MELON_TASK_GRAPH_MAX_TASKS];
+    bool   compiled;
+
+    melon_job_system* system;
+    melon_job_counter counter;
+    // Bit mask of main thread tasks that are ready to run
+    volatile uint64_t main_thread_ready;
+
+    // Results of the last execution
+    uint64_t frame_ns;
+    uint64_t critical_path_ns;
+    size_t   critical_path[MELON_TASK_GRAPH_MAX_TASKS];
+    size_t   critical_path_length;
+} melon_task_graph;
+
+void melon_create_task_graph(melon_task_graph* graph);
+
+// Returns the index of the new task
+size_t melon_task_graph_add_task(melon_task_graph* graph, const melon_task_desc* desc);
+// Resource names are compared by value and are not copied
+void melon_task_graph_read(melon_task_graph* graph, size_t task, const char* resource);
+void melon_task_graph_write(melon_task_graph* graph, size_t task, const char* resource);
+
+// Builds the dependencies and the schedule. Tasks can't be added afterwards
+void melon_task_graph_compile(melon_task_graph* graph);
+// Runs every task once and returns when all of them have finished. Must be called from worker 0 of system
+void melon_task_graph_execute(melon_task_graph* graph, melon_job_system* system);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
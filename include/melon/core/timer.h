@@ -0,0 +1,18 @@
+#ifndef MELON_TIMER_H
+#define MELON_TIMER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Monotonic time in nanoseconds from an unspecified starting point
+uint64_t melon_time_ns();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MELON_TLSF_H
+#define MELON_TLSF_H
+
+#include <melon/core/memory.h>
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// tlsf - two level segregated fit allocator over a caller provided region.
+//
+// Free blocks are binned by a first level (power of two) and a second level
+// (linear subdivision of that power of two) index. Both levels have a bitmap,
+// so finding a fitting block and freeing one are O(1) with bounded latency.
+// Blocks carry a 16 byte header and are 16 byte aligned.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MELON_TLSF_ALIGN 16
+#define MELON_TLSF_SL_INDEX_COUNT_LOG2 5
+#define MELON_TLSF_SL_INDEX_COUNT (1 << MELON_TLSF_SL_INDEX_COUNT_LOG2)
+#define MELON_TLSF_FL_INDEX_MAX 32
+#define MELON_TLSF_FL_INDEX_SHIFT (MELON_TLSF_SL_INDEX_COUNT_LOG2 + 4)
+#define MELON_TLSF_FL_INDEX_COUNT (MELON_TLSF_FL_INDEX_MAX - MELON_TLSF_FL_INDEX_SHIFT + 1)
+
+typedef struct melon_tlsf_block melon_tlsf_block;
+
+typedef struct
+{
+    uint32_t          fl_bitmap;
+    uint32_t          sl_bitmap[MELON_TLSF_FL_INDEX_COUNT];
+    melon_tlsf_block* blocks[MELON_TLSF_FL_INDEX_COUNT][MELON_TLSF_SL_INDEX_COUNT];
+
+    uint8_t* memory;
+    size_t   size;
+} melon_tlsf_allocator;
+
+// Manages the size bytes at memory. The region has to outlive the allocator
+bool melon_create_tlsf_allocator(melon_tlsf_allocator* tlsf, void* memory, size_t size);
+
+void* melon_tlsf_alloc(melon_tlsf_allocator* tlsf, size_t size, size_t align);
+// Grows or shrinks in place when the block, or the block and its free neighbor, is big enough
+void* melon_tlsf_realloc(melon_tlsf_allocator* tlsf, void* ptr, size_t size, size_t align);
+void  melon_tlsf_free(melon_tlsf_allocator* tlsf, void* ptr);
+
+// Usable size of an allocation
+size_t melon_tlsf_block_size(const void* ptr);
+// Walks every block and checks the physical chain and the free lists agree. Intended for tests
+bool melon_tlsf_validate(const melon_tlsf_allocator* tlsf);
+
+melon_allocator_api melon_tlsf_allocator_api(melon_tlsf_allocator* tlsf);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,59 @@
+#ifndef MELON_VIRTUAL_MEMORY_H
+#define MELON_VIRTUAL_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// virtual memory - thin wrappers over the OS page allocator. Address ranges are
+// reserved up front and pages are committed/decommitted on demand.
+////////////////////////////////////////////////////////////////////////////////
+
+size_t melon_vm_page_size();
+
+// Round size up to a multiple of the page size
+static inline size_t melon_vm_page_align(size_t size)
+{
+    size_t page_size = melon_vm_page_size();
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+// Reserves an inaccessible address range. Returns NULL on failure
+void* melon_vm_reserve(size_t size);
+// Makes a page aligned range inside a reservation readable and writable
+bool melon_vm_commit(void* ptr, size_t size);
+// Returns the physical pages of a committed range to the OS and makes it inaccessible again
+void melon_vm_decommit(void* ptr, size_t size);
+// Releases a whole reservation
+void melon_vm_release(void* ptr, size_t size);
+
+#define MELON_HUGE_PAGE_SIZE ((size_t) 2 * 1024 * 1024)
+
+typedef enum
+{
+    MELON_VM_SMALL_PAGES,
+    // Explicitly reserved huge pages (MAP_HUGETLB, MEM_LARGE_PAGES)
+    MELON_VM_HUGE_PAGES,
+    // Ordinary pages that the kernel was asked to back with huge pages (MADV_HUGEPAGE)
+    MELON_VM_TRANSPARENT_HUGE_PAGES
+} melon_vm_page_kind;
+
+/* melon_vm_alloc_huge - Maps a committed range aligned to MELON_HUGE_PAGE_SIZE
+ *
+ * Explicit huge pages are tried first when rounding size up to whole huge pages wastes little, then transparent huge
+ * pages, then ordinary pages. *kind reports which one was obtained and *mapped_size the size to pass to
+ * melon_vm_free_huge. Returns NULL on failure.
+ */
+void* melon_vm_alloc_huge(size_t size, size_t* mapped_size, melon_vm_page_kind* kind);
+void  melon_vm_free_huge(void* ptr, size_t mapped_size, melon_vm_page_kind kind);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
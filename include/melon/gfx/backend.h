@@ -19,6 +19,11 @@
 #define MELON_GFX_MAX_BUFFER_ATTACHMENTS 4
 #define MELON_GFX_MAX_STAGE_UNIFORM_BLOCKS 4
 #define MELON_GFX_MAX_STAGE_TEXTURE_SAMPLERS 16
+#define MELON_GFX_MAX_RANGE_BUFFERS 16
+#define MELON_GFX_DEFAULT_RANGE_BUFFER_SIZE MELON_MEGABYTE(16)
+#define MELON_GFX_MIN_BUFFER_RANGE_SIZE 256
+#define MELON_GFX_MAX_RENDER_QUEUE_DEPTH 8
+#define MELON_GFX_DEFAULT_RENDER_QUEUE_DEPTH 2
 
 ////////////////////////////////////////////////////////////////////////////////
 // description types
@@ -38,6 +43,7 @@ extern melon_gfx_handle melon_gfx_invalid_handle;
  */
 
 MELON_GFX_HANDLE(melon_buffer_handle);
+MELON_GFX_HANDLE(melon_buffer_range_handle);
 MELON_GFX_HANDLE(melon_uniform_block_handle);
 MELON_GFX_HANDLE(melon_texture_handle);
 MELON_GFX_HANDLE(melon_shader_handle);
@@ -150,11 +156,29 @@ typedef enum
     MELON_UNIFORM_MATRIX4
 } melon_uniform_type;
 
+/* buffer_range - A sub-allocation inside one of the device's shared buffers
+ *
+ * Ranges created with the same usage are packed into a few large buffers, so meshes that live in ranges can be drawn
+ * one after another without rebinding. Use buffer and offset in melon_draw_resources to draw from a range.
+ */
+typedef struct
+{
+    melon_buffer_handle buffer;
+    size_t              offset;
+    size_t              size;
+} melon_buffer_range;
+
+/* draw_resources - Buffers bound for a draw
+ *
+ * buffer_offsets and index_buffer_offset are byte offsets into the bound buffers, 0 for buffers that aren't shared.
+ */
 typedef struct
 {
     melon_buffer_handle buffers[MELON_GFX_MAX_BUFFER_ATTACHMENTS];
+    size_t              buffer_offsets[MELON_GFX_MAX_BUFFER_ATTACHMENTS];
 
     melon_buffer_handle    index_buffer;
+    size_t                 index_buffer_offset;
     melon_vertex_data_type index_type;
 } melon_draw_resources;
 
@@ -182,14 +206,43 @@ typedef struct
     size_t max_buffers;
     size_t max_pipelines;
     size_t max_command_buffers;
+    size_t max_buffer_ranges;
 } melon_device_resource_count;
 
 typedef struct
 {
     melon_device_resource_count resource_count;
     melon_allocator_api         allocator;
+
+    // Size of each shared buffer that buffer ranges are allocated from, a power of two
+    size_t range_buffer_size;
+
+    // Run every GL call on a dedicated thread that owns the GL context. Submitting command buffers queues them and
+    // returns, so the next frame is recorded while the render thread translates the previous one. Other device
+    // functions still block until the render thread has run them
+    bool render_thread;
+    // Submissions that can be queued before melon_submit_command_buffers blocks, at most
+    // MELON_GFX_MAX_RENDER_QUEUE_DEPTH. 0 uses MELON_GFX_DEFAULT_RENDER_QUEUE_DEPTH
+    size_t render_queue_depth;
 } melon_device_params;
 
+/* render_thread_stats - Latency telemetry of the render thread, all zero when it isn't running
+ *
+ * queue_latency - time from a submission being queued to the render thread picking it up
+ * execute - time the render thread spent translating a submission
+ * submit_stall - time submitting threads spent blocked on a full queue, in total
+ */
+typedef struct
+{
+    uint64_t frames;
+    size_t   queued;
+    uint64_t last_queue_latency_ns;
+    uint64_t max_queue_latency_ns;
+    uint64_t last_execute_ns;
+    uint64_t max_execute_ns;
+    uint64_t submit_stall_ns;
+} melon_render_thread_stats;
+
 typedef struct
 {
     melon_pipeline_handle pipeline;
@@ -226,6 +279,16 @@ MELON_GFX_CREATE_BUFFER(melon_create_buffer);
 #define MELON_GFX_DELETE_BUFFER(name) void name(melon_buffer_handle buffer)
 MELON_GFX_DELETE_BUFFER(melon_delete_buffer);
 
+#define MELON_GFX_CREATE_BUFFER_RANGE(name) \
+    melon_buffer_range_handle name(const melon_buffer_params* buffer_create_info)
+MELON_GFX_CREATE_BUFFER_RANGE(melon_create_buffer_range);
+
+#define MELON_GFX_DELETE_BUFFER_RANGE(name) void name(melon_buffer_range_handle range)
+MELON_GFX_DELETE_BUFFER_RANGE(melon_delete_buffer_range);
+
+#define MELON_GFX_GET_BUFFER_RANGE(name) melon_buffer_range name(melon_buffer_range_handle range)
+MELON_GFX_GET_BUFFER_RANGE(melon_get_buffer_range);
+
 #define MELON_GFX_CREATE_PIPELINE(name) melon_pipeline_handle name(const melon_pipeline_params* pipeline_create_info)
 MELON_GFX_CREATE_PIPELINE(melon_create_pipeline);
 
@@ -247,11 +310,16 @@ MELON_GFX_CB_BEGIN_RECORDING(melon_begin_recording);
 #define MELON_GFX_CB_END_RECORDING(name) void name(melon_command_buffer_handle cb)
 MELON_GFX_CB_END_RECORDING(melon_end_recording);
 
+/* Bindings are byte offsets into the buffers like in melon_draw_resources, and hold until they are rebound or the
+ * command buffer ends. Each command buffer starts with nothing bound
+ */
 #define MELON_GFX_CB_BIND_VERTEX_BUFFER(name) \
-    void name(melon_command_buffer_handle cb, melon_buffer_handle buffer, size_t binding)
+    void name(melon_command_buffer_handle cb, melon_buffer_handle buffer, size_t binding, size_t offset)
 MELON_GFX_CB_BIND_VERTEX_BUFFER(melon_cmd_bind_vertex_buffer);
 
-#define MELON_GFX_CB_BIND_INDEX_BUFFER(name) void name(melon_command_buffer_handle cb, melon_buffer_handle buffer)
+#define MELON_GFX_CB_BIND_INDEX_BUFFER(name)                                                                 \
+    void name(melon_command_buffer_handle cb, melon_buffer_handle buffer, melon_vertex_data_type index_type, \
+              size_t offset)
 MELON_GFX_CB_BIND_INDEX_BUFFER(melon_cmd_bind_index_buffer);
 
 #define MELON_GFX_CB_BIND_PIPELINE(name) void name(melon_command_buffer_handle cb, melon_pipeline_handle pipeline)
@@ -260,10 +328,25 @@ MELON_GFX_CB_BIND_PIPELINE(melon_cmd_bind_pipeline);
 #define MELON_GFX_CB_DRAW(name) void name(melon_command_buffer_handle cb, const melon_draw_call_params* params)
 MELON_GFX_CB_DRAW(melon_cmd_draw);
 
+// Clears the color and depth of the render target, color is rgba
+#define MELON_GFX_CB_CLEAR(name) void name(melon_command_buffer_handle cb, const float color[4])
+MELON_GFX_CB_CLEAR(melon_cmd_clear);
+
 #define MELON_GFX_CB_RESET(name) void name(melon_command_buffer_handle cb)
 MELON_GFX_CB_RESET(melon_reset);
 
+/* submit - hands the command buffers over to be executed in order, at most max_command_buffers at a time. Submissions
+ * must come from one thread at a time
+ */
 #define MELON_GFX_CB_SUBMIT(name) void name(melon_command_buffer_handle* command_buffers, size_t num_cbs)
 MELON_GFX_CB_SUBMIT(melon_submit_command_buffers);
 
+/* wait_idle - blocks until every queued submission has been executed, returns right away without a render thread
+ */
+#define MELON_GFX_WAIT_IDLE(name) void name()
+MELON_GFX_WAIT_IDLE(melon_gfx_wait_idle);
+
+#define MELON_GFX_GET_RENDER_THREAD_STATS(name) melon_render_thread_stats name()
+MELON_GFX_GET_RENDER_THREAD_STATS(melon_get_render_thread_stats);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <melon/core/buddy.h>
+#include <melon/core/error.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Tree helpers
+// - nodes are stored breadth first, the children of node i are 2i+1 and 2i+2.
+//   A node at depth d covers size >> d bytes. Levels count up from the leaves,
+//   so a free node at depth d stores levels - d + 1.
+////////////////////////////////////////////////////////////////////////////////
+
+static inline bool is_power_of_two(size_t value) { return value && !(value & (value - 1)); }
+
+static inline uint8_t free_value(const melon_buddy_allocator* buddy, uint32_t depth)
+{
+    return (uint8_t) (buddy->levels - depth + 1);
+}
+
+// Recomputes the ancestors of node after it changed
+static void update_parents(melon_buddy_allocator* buddy, size_t node, uint32_t depth)
+{
+    while (node)
+    {
+        node = (node - 1) / 2;
+        depth--;
+
+        uint8_t left  = buddy->longest[2 * node + 1];
+        uint8_t right = buddy->longest[2 * node + 2];
+        uint8_t child = free_value(buddy, depth + 1);
+
+        // Two free buddies merge back into their parent
+        if (left == child && right == child)
+            buddy->longest[node] = free_value(buddy, depth);
+        else
+            buddy->longest[node] = left > right ? left : right;
+    }
+}
+
+bool melon_create_buddy_allocator(melon_buddy_allocator* buddy, size_t size, size_t min_block_size,
+                                  const melon_allocator_api* allocator)
+{
+    if (!is_power_of_two(size) || !is_power_of_two(min_block_size) || min_block_size > size)
+    {
+        MELON_LOG("Buddy allocator error: %zu and %zu must be powers of two\n", size, min_block_size);
+        return false;
+    }
+
+    buddy->size           = size;
+    buddy->min_block_size = min_block_size;
+    buddy->used_size      = 0;
+    buddy->allocator      = *allocator;
+    buddy->levels         = 0;
+    for (size_t leaves = size / min_block_size; leaves > 1; leaves >>= 1)
+        buddy->levels++;
+
+    size_t node_count = ((size_t) 2 << buddy->levels) - 1;
+    buddy->longest    = (uint8_t*) MELON_ALLOC(buddy->allocator, node_count, 1);
+    if (!buddy->longest)
+    {
+        return false;
+    }
+
+    size_t level_start = 0;
+    for (uint32_t depth = 0; depth <= buddy->levels; depth++)
+    {
+        size_t level_count = (size_t) 1 << depth;
+        for (size_t i = 0; i < level_count; i++)
+            buddy->longest[level_start + i] = free_value(buddy, depth);
+        level_start += level_count;
+    }
+
+    return true;
+}
+
+void melon_destroy_buddy_allocator(melon_buddy_allocator* buddy)
+{
+    MELON_FREE(buddy->allocator, buddy->longest);
+    buddy->longest = NULL;
+}
+
+size_t melon_buddy_alloc(melon_buddy_allocator* buddy, size_t size)
+{
+    uint32_t level = 0;
+    while ((buddy->min_block_size << level) < size)
+        level++;
+
+    if (level > buddy->levels || buddy->longest[0] < level + 1)
+    {
+        return MELON_BUDDY_INVALID_OFFSET;
+    }
+
+    // Walk down towards a free node of the right level, preferring the left child to keep blocks packed
+    size_t   node  = 0;
+    uint32_t depth = 0;
+    while (buddy->levels - depth != level)
+    {
+        size_t left = 2 * node + 1;
+        node        = buddy->longest[left] >= level + 1 ? left : left + 1;
+        depth++;
+    }
+
+    buddy->longest[node] = 0;
+    update_parents(buddy, node, depth);
+
+    size_t block_size = buddy->size >> depth;
+    buddy->used_size += block_size;
+    return (node - (((size_t) 1 << depth) - 1)) * block_size;
+}
+
+// Returns the node allocated at offset along with its depth
+static size_t find_allocated_node(const melon_buddy_allocator* buddy, size_t offset, uint32_t* depth)
+{
+    MELON_ASSERT(offset < buddy->size && (offset & (buddy->min_block_size - 1)) == 0, "Invalid buddy offset %zu\n",
+                 offset);
+
+    size_t node = offset / buddy->min_block_size + ((size_t) 1 << buddy->levels) - 1;
+    *depth      = buddy->levels;
+    while (buddy->longest[node] != 0)
+    {
+        MELON_ASSERT(node != 0, "Buddy offset %zu is not allocated\n", offset);
+        node = (node - 1) / 2;
+        (*depth)--;
+    }
+    return node;
+}
+
+void melon_buddy_free(melon_buddy_allocator* buddy, size_t offset)
+{
+    uint32_t depth;
+    size_t   node = find_allocated_node(buddy, offset, &depth);
+
+    buddy->longest[node] = free_value(buddy, depth);
+    buddy->used_size -= buddy->size >> depth;
+    update_parents(buddy, node, depth);
+}
+
+size_t melon_buddy_block_size(const melon_buddy_allocator* buddy, size_t offset)
+{
+    uint32_t depth;
+    find_allocated_node(buddy, offset, &depth);
+    return buddy->size >> depth;
+}
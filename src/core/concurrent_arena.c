@@ -0,0 +1,89 @@
+#include <melon/core/concurrent_arena.h>
+#include <melon/core/atomic.h>
+#include <melon/core/error.h>
+
+// Block storage is aligned to this and every push is rounded up to it, so pushes with a smaller alignment need no
+// padding
+#define BLOCK_ALIGN MELON_DEFAULT_ALIGN
+
+static melon_concurrent_block* create_block(melon_concurrent_arena* arena, size_t size)
+{
+    size_t                  header_size = melon_aligned_size(NULL, sizeof(melon_concurrent_block), BLOCK_ALIGN);
+    melon_concurrent_block* block       = MELON_ALLOC(arena->allocator, header_size + size, BLOCK_ALIGN);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    block->start  = (uint8_t*) block + header_size;
+    block->size   = size;
+    block->offset = 0;
+    block->prev   = NULL;
+    return block;
+}
+
+static void free_blocks(melon_concurrent_arena* arena, melon_concurrent_block* block)
+{
+    while (block)
+    {
+        melon_concurrent_block* prev = block->prev;
+        MELON_FREE(arena->allocator, block);
+        block = prev;
+    }
+}
+
+void melon_create_concurrent_arena(melon_concurrent_arena* arena, size_t block_size, const melon_allocator_api* alloc)
+{
+    arena->allocator     = *alloc;
+    arena->block_size    = melon_aligned_size(NULL, block_size, BLOCK_ALIGN);
+    arena->current_block = create_block(arena, arena->block_size);
+}
+
+void melon_destroy_concurrent_arena(melon_concurrent_arena* arena)
+{
+    free_blocks(arena, arena->current_block);
+    arena->current_block = NULL;
+}
+
+void* melon_concurrent_arena_push_size(melon_concurrent_arena* arena, size_t size, size_t align)
+{
+    size_t padding = align > BLOCK_ALIGN ? align - BLOCK_ALIGN : 0;
+    size_t reserve = melon_aligned_size(NULL, size, BLOCK_ALIGN) + padding;
+
+    for (;;)
+    {
+        melon_concurrent_block* block  = melon_atomic_load_ptr((void* volatile*) &arena->current_block);
+        uint64_t                offset = melon_atomic_fetch_add_u64(&block->offset, reserve);
+
+        if (offset + reserve <= block->size)
+        {
+            return melon_align_forward(block->start + offset, align);
+        }
+
+        // Slow path: the block is full. Build a replacement with this push already carved out of it
+        size_t                  new_size  = reserve > arena->block_size ? reserve : arena->block_size;
+        melon_concurrent_block* new_block = create_block(arena, new_size);
+        if (new_block == NULL)
+        {
+            return NULL;
+        }
+        new_block->offset = reserve;
+        new_block->prev   = block;
+
+        if (melon_atomic_cas_ptr((void* volatile*) &arena->current_block, block, new_block))
+        {
+            return melon_align_forward(new_block->start, align);
+        }
+
+        // Another thread installed its block first, retry on that one
+        MELON_FREE(arena->allocator, new_block);
+    }
+}
+
+void melon_concurrent_arena_reset(melon_concurrent_arena* arena)
+{
+    melon_concurrent_block* block = arena->current_block;
+    free_blocks(arena, block->prev);
+    block->prev   = NULL;
+    block->offset = 0;
+}
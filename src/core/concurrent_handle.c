@@ -0,0 +1,135 @@
+#include <melon/core/concurrent_handle.h>
+#include <melon/core/atomic.h>
+#include <melon/core/error.h>
+#include <string.h>
+
+static inline melon_handle make_handle(uint32_t index, uint32_t generation)
+{
+    return ((melon_handle) generation << MELON_HANDLE_INDEX_BITS) | index;
+}
+
+static inline uint32_t handle_generation(melon_handle handle) { return (uint32_t) (handle >> MELON_HANDLE_INDEX_BITS); }
+
+void melon_create_concurrent_handle_pool(melon_concurrent_handle_pool* pool, size_t capacity,
+                                         const melon_allocator_api* allocator)
+{
+    MELON_ASSERT(capacity < MELON_HANDLE_INDEX_CAPACITY, "Capacity %zu is too large\n", capacity);
+
+    pool->allocator   = *allocator;
+    pool->generations = (uint32_t*) MELON_ALLOC(pool->allocator, sizeof(uint32_t) * capacity, MELON_DEFAULT_ALIGN);
+    pool->next_free   = (uint32_t*) MELON_ALLOC(pool->allocator, sizeof(uint32_t) * capacity, MELON_DEFAULT_ALIGN);
+    pool->capacity    = capacity;
+
+    // Generations are cleared up front so a slot never has to be initialized while other threads can see it
+    memset((void*) pool->generations, 0, sizeof(uint32_t) * capacity);
+    pool->num_initialized = 0;
+    pool->freelist_head   = MELON_INVALID_HANDLE;
+}
+
+void melon_delete_concurrent_handle_pool(melon_concurrent_handle_pool* pool)
+{
+    MELON_FREE(pool->allocator, (void*) pool->generations);
+    MELON_FREE(pool->allocator, (void*) pool->next_free);
+}
+
+static melon_handle pop_free_handle(melon_concurrent_handle_pool* pool)
+{
+    for (;;)
+    {
+        melon_handle head = melon_atomic_load_u64(&pool->freelist_head);
+        if (head == MELON_INVALID_HANDLE)
+        {
+            return MELON_INVALID_HANDLE;
+        }
+
+        // If another thread pops this slot and frees it again in the meantime, its generation and therefore the head
+        // will have changed and the CAS fails
+        uint32_t     index    = (uint32_t) melon_handle_index(head);
+        uint32_t     next     = melon_atomic_load_u32(&pool->next_free[index]);
+        melon_handle new_head = MELON_INVALID_HANDLE;
+        if (next != (uint32_t) MELON_HANDLE_INDEX_INVALID)
+        {
+            new_head = make_handle(next, melon_atomic_load_u32(&pool->generations[next]));
+        }
+        if (melon_atomic_cas_u64(&pool->freelist_head, head, new_head))
+        {
+            return head;
+        }
+        melon_cpu_relax();
+    }
+}
+
+static void push_free_handle(melon_concurrent_handle_pool* pool, melon_handle handle)
+{
+    uint32_t index = (uint32_t) melon_handle_index(handle);
+    for (;;)
+    {
+        melon_handle head = melon_atomic_load_u64(&pool->freelist_head);
+        uint32_t     next = (uint32_t) MELON_HANDLE_INDEX_INVALID;
+        if (head != MELON_INVALID_HANDLE)
+        {
+            next = (uint32_t) melon_handle_index(head);
+        }
+        melon_atomic_store_u32(&pool->next_free[index], next);
+        if (melon_atomic_cas_u64(&pool->freelist_head, head, handle))
+        {
+            return;
+        }
+        melon_cpu_relax();
+    }
+}
+
+melon_handle melon_concurrent_pool_create_handle(melon_concurrent_handle_pool* pool)
+{
+    melon_handle handle = pop_free_handle(pool);
+    if (handle != MELON_INVALID_HANDLE)
+    {
+        return handle;
+    }
+
+    // Take a never used slot. A CAS rather than a fetch-add keeps the high-water mark from running past the capacity
+    for (;;)
+    {
+        uint32_t index = melon_atomic_load_u32(&pool->num_initialized);
+        if (index >= pool->capacity)
+        {
+            return MELON_INVALID_HANDLE;
+        }
+        if (melon_atomic_cas_u32(&pool->num_initialized, index, index + 1))
+        {
+            return make_handle(index, 0);
+        }
+    }
+}
+
+bool melon_concurrent_handle_is_valid(melon_concurrent_handle_pool* pool, melon_handle handle)
+{
+    uint64_t index      = melon_handle_index(handle);
+    uint32_t generation = handle_generation(handle);
+    return handle != MELON_INVALID_HANDLE && generation < MELON_HANDLE_GENERATION_MAX
+           && index < melon_atomic_load_u32(&pool->num_initialized)
+           && melon_atomic_load_u32(&pool->generations[index]) == generation;
+}
+
+bool melon_concurrent_pool_delete_handle(melon_concurrent_handle_pool* pool, melon_handle handle)
+{
+    if (!melon_concurrent_handle_is_valid(pool, handle))
+    {
+        return false;
+    }
+
+    // Bumping the generation invalidates the handle. Only one of several threads deleting it wins the CAS
+    uint32_t index      = (uint32_t) melon_handle_index(handle);
+    uint32_t generation = handle_generation(handle);
+    if (!melon_atomic_cas_u32(&pool->generations[index], generation, generation + 1))
+    {
+        return false;
+    }
+
+    // Slots that reach the last generation are retired and never reused
+    if (generation + 1 < MELON_HANDLE_GENERATION_MAX)
+    {
+        push_free_handle(pool, make_handle(index, generation + 1));
+    }
+    return true;
+}
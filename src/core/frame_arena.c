@@ -0,0 +1,73 @@
+#include <melon/core/frame_arena.h>
+#include <melon/core/error.h>
+
+#include <string.h>
+
+void melon_create_frame_arena(melon_frame_arena* frames, uint32_t frame_count, size_t partition_size,
+                              const melon_allocator_api* alloc)
+{
+    MELON_ASSERT(frame_count > 0 && frame_count <= MELON_MAX_FRAMES_IN_FLIGHT, "Invalid frame count %u\n",
+                 frame_count);
+
+    memset(frames, 0, sizeof(melon_frame_arena));
+    frames->frame_count = frame_count;
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        frames->partitions[i] = melon_create_arena(partition_size, MELON_DEFAULT_ALIGN, alloc);
+    }
+}
+
+void melon_destroy_frame_arena(melon_frame_arena* frames)
+{
+    for (uint32_t i = 0; i < frames->frame_count; i++)
+    {
+        melon_destroy_arena(&frames->partitions[i]);
+    }
+    frames->frame_count = 0;
+}
+
+uint64_t melon_frame_arena_begin_frame(melon_frame_arena* frames, uint32_t frame_index)
+{
+    MELON_ASSERT(frame_index < frames->frame_count, "Frame index %u out of range\n", frame_index);
+
+    melon_memory_arena* partition = &frames->partitions[frame_index];
+
+#ifdef MELON_DEBUG
+    // Poison the recycled frame so reads through stale pointers show up as garbage instead of plausible old data
+    for (melon_memory_block* block = partition->current_block; block; block = block->prev)
+    {
+        memset(block->start, MELON_FRAME_ARENA_POISON, block->offset);
+    }
+#endif
+    melon_arena_reset(partition);
+
+    frames->current_partition                = frame_index;
+    frames->partition_frame_ids[frame_index] = ++frames->last_frame_id;
+
+    return frames->last_frame_id;
+}
+
+void* melon_frame_arena_push_size(melon_frame_arena* frames, size_t size, size_t align)
+{
+    return melon_arena_push_size(&frames->partitions[frames->current_partition], size, align);
+}
+
+bool melon_frame_arena_is_live(const melon_frame_arena* frames, const void* ptr, uint64_t frame_id)
+{
+    const uint8_t* byte_ptr = (const uint8_t*) ptr;
+
+    for (uint32_t i = 0; i < frames->frame_count; i++)
+    {
+        if (frames->partition_frame_ids[i] != frame_id)
+            continue;
+
+        for (melon_memory_block* block = frames->partitions[i].current_block; block; block = block->prev)
+        {
+            if (byte_ptr >= block->start && byte_ptr < block->start + block->offset)
+                return true;
+        }
+        return false;
+    }
+
+    return false;
+}
@@ -3,29 +3,20 @@
 #include <string.h>
 #include <stdbool.h>
 
-#define handle_index(handle) melon_handle_index(handle)
-
-static inline uint64_t handle_generation(melon_handle handle)
-{
-    return ((handle & MELON_HANDLE_GENERATION_MASK) >> MELON_HANDLE_INDEX_BITS);
-}
-
-static inline void handle_set_index(melon_handle* handle, uint64_t index)
+// Handles are split according to the pool's layout, see melon_create_handle_pool_with_layout
+static inline uint64_t handle_index(const melon_handle_pool* pool, melon_handle handle)
 {
-    MELON_ASSERT(index <= MELON_HANDLE_INDEX_MAX);
-    (*handle) = index | ((*handle) | MELON_HANDLE_GENERATION_MASK);
+    return handle & pool->index_mask;
 }
 
-static inline void handle_set_generation(melon_handle* handle, uint64_t generation)
+static inline uint64_t handle_generation(const melon_handle_pool* pool, melon_handle handle)
 {
-    MELON_ASSERT(generation <= MELON_HANDLE_GENERATION_MAX);
-    (*handle) = (generation << MELON_HANDLE_GENERATION_BITS) | ((*handle) | MELON_HANDLE_INDEX_MASK);
+    return handle >> pool->index_bits;
 }
 
-static inline void handle_increment_generation(melon_handle* handle)
+static inline melon_handle make_handle(const melon_handle_pool* pool, uint64_t index, uint64_t generation)
 {
-    MELON_ASSERT(handle_generation(*handle) + 1 <= MELON_HANDLE_GENERATION_MAX);
-    (*handle) += ((melon_handle) 1 << MELON_HANDLE_GENERATION_BITS);
+    return (generation << pool->index_bits) | index;
 }
 
 static inline bool freelist_empty(melon_handle_pool* pool)
@@ -41,21 +32,18 @@ static inline bool freelist_empty(melon_handle_pool* pool)
 static bool push_free_handle(melon_handle_pool* pool, melon_handle handle)
 {
     // Get the index of the handle
-    uint64_t index = handle_index(handle);
+    uint64_t index = handle_index(pool, handle);
 
-    // Find the handle entry, update the data index and set the next handle index to be the sentinal
-    melon_handle_entry* new_tail = &pool->handle_entries[index];
-
-    // Check to see if the index has expired
+    // Check to see if the index has expired. Retired slots are never valid and never reused
     // TODO: Log that the index has expired
-    if (handle_generation(handle) >= MELON_HANDLE_GENERATION_MAX)
+    if (handle_generation(pool, handle) >= pool->generation_max)
     {
-        new_tail->handle = MELON_INVALID_HANDLE;
-        new_tail->next_handle_index = MELON_HANDLE_INDEX_INVALID;
+        pool->generations[index] = pool->generation_max;
+        pool->next_free[index]   = (uint32_t) MELON_HANDLE_INDEX_INVALID;
         return false;
     }
-    new_tail->handle = handle;
-    new_tail->next_handle_index = MELON_HANDLE_INDEX_INVALID;
+    pool->generations[index] = (uint32_t) handle_generation(pool, handle);
+    pool->next_free[index]   = (uint32_t) MELON_HANDLE_INDEX_INVALID;
 
     // If the freelist is empty, make handle the head
     if (freelist_empty(pool))
@@ -64,8 +52,7 @@ static bool push_free_handle(melon_handle_pool* pool, melon_handle handle)
     }
     else
     {
-        melon_handle_entry* tail      = &pool->handle_entries[pool->freelist_tail_index];
-        tail->next_handle_index = index;
+        pool->next_free[pool->freelist_tail_index] = (uint32_t) index;
     }
 
     // Set the tail index of the freelist to the new tail index
@@ -78,11 +65,12 @@ static melon_handle pop_free_handle(melon_handle_pool* pool)
 {
     if (freelist_empty(pool))
     {
-        return MELON_INVALID_HANDLE;
+        return pool->invalid_handle;
     }
 
-    // Get the current head entry
-    melon_handle_entry* head = &pool->handle_entries[pool->freelist_head_index];
+    // Rebuild the handle of the current head from its slot's generation
+    size_t       head_index = pool->freelist_head_index;
+    melon_handle handle     = make_handle(pool, head_index, pool->generations[head_index]);
 
     // If the head and the tail are the same (ie there's only one element in the freelist)
     // make both the tail and the head invalid
@@ -90,92 +78,179 @@ static melon_handle pop_free_handle(melon_handle_pool* pool)
     {
         pool->freelist_head_index = MELON_HANDLE_INDEX_INVALID;
         pool->freelist_tail_index = MELON_HANDLE_INDEX_INVALID;
-        return head->handle;
     }
     else
     {
         // Else, make the new head the next handle index
-        pool->freelist_head_index = head->next_handle_index;
-        return head->handle;
+        pool->freelist_head_index = pool->next_free[head_index];
     }
+    pool->next_free[head_index] = (uint32_t) head_index;
+    return handle;
 }
 
-void melon_create_handle_pool(melon_handle_pool* pool, size_t capacity, const melon_allocator_api* allocator, bool grow_by_default)
+// Handed out slots link to themselves, which a slot in the free list never does
+static inline bool slot_is_live(const melon_handle_pool* pool, size_t index)
+{
+    return pool->next_free[index] == (uint32_t) index;
+}
+
+// Relinks the free list in ascending index order so the lowest free slots are handed out first. Returns one past the
+// highest live slot
+static size_t sort_free_list(melon_handle_pool* pool)
+{
+    size_t live_end           = 0;
+    pool->freelist_head_index = MELON_HANDLE_INDEX_INVALID;
+    pool->freelist_tail_index = MELON_HANDLE_INDEX_INVALID;
+    for (size_t i = 0; i < pool->num_initialized; i++)
+    {
+        if (slot_is_live(pool, i))
+        {
+            live_end = i + 1;
+            continue;
+        }
+
+        // Retired slots stay out of the free list
+        if (pool->generations[i] == pool->generation_max)
+        {
+            continue;
+        }
+
+        if (freelist_empty(pool))
+        {
+            pool->freelist_head_index = i;
+        }
+        else
+        {
+            pool->next_free[pool->freelist_tail_index] = (uint32_t) i;
+        }
+        pool->freelist_tail_index = i;
+    }
+
+    if (!freelist_empty(pool))
+    {
+        pool->next_free[pool->freelist_tail_index] = (uint32_t) MELON_HANDLE_INDEX_INVALID;
+    }
+    return live_end;
+}
+
+// Resizes both slot arrays. Returns false and leaves the pool untouched on failure
+static bool resize_slots(melon_handle_pool* pool, size_t capacity)
 {
-    MELON_ASSERT(capacity <= MELON_HANDLE_INDEX_MAX);
+    uint32_t* generations = (uint32_t*) MELON_REALLOC(pool->allocator, pool->generations, sizeof(uint32_t) * capacity,
+                                                      MELON_DEFAULT_ALIGN);
+    if (!generations)
+    {
+        return false;
+    }
+    pool->generations = generations;
+
+    uint32_t* next_free = (uint32_t*) MELON_REALLOC(pool->allocator, pool->next_free, sizeof(uint32_t) * capacity,
+                                                    MELON_DEFAULT_ALIGN);
+    if (!next_free)
+    {
+        return false;
+    }
+    pool->next_free = next_free;
+    pool->capacity  = capacity;
+
+    return true;
+}
+
+void melon_create_handle_pool_with_layout(melon_handle_pool* pool, size_t capacity,
+                                          const melon_allocator_api* allocator, bool grow_by_default,
+                                          uint32_t index_bits, uint32_t generation_bits)
+{
+    MELON_ASSERT(index_bits > 0 && index_bits <= 32 && generation_bits > 0 && generation_bits <= 32,
+                 "Invalid handle layout %u/%u\n", index_bits, generation_bits);
+
+    pool->index_bits     = index_bits;
+    pool->index_mask     = ((melon_handle) 1 << index_bits) - 1;
+    pool->generation_max = (uint32_t) (((melon_handle) 1 << generation_bits) - 1);
+    pool->invalid_handle = make_handle(pool, pool->index_mask, pool->generation_max);
+
+    MELON_ASSERT(capacity <= pool->index_mask, "Capacity %zu doesn't fit in %u index bits\n", capacity, index_bits);
+
+    pool->allocator   = *allocator;
+    pool->generations = (uint32_t*) MELON_ALLOC(pool->allocator, sizeof(uint32_t) * capacity, MELON_DEFAULT_ALIGN);
+    pool->next_free   = (uint32_t*) MELON_ALLOC(pool->allocator, sizeof(uint32_t) * capacity, MELON_DEFAULT_ALIGN);
+    pool->capacity    = capacity;
 
-    pool->allocator = *allocator;
-    pool->handle_entries
-        = (melon_handle_entry*) MELON_ALLOC(pool->allocator, sizeof(melon_handle_entry) * capacity, MELON_DEFAULT_ALIGN);
-    pool->capacity = capacity;
     pool->grow_by_default = grow_by_default;
 
     melon_pool_reset(pool);
 }
 
-void melon_delete_handle_pool(melon_handle_pool* pool) { MELON_FREE(pool->allocator, pool->handle_entries); }
+void melon_create_handle_pool(melon_handle_pool* pool, size_t capacity, const melon_allocator_api* allocator, bool grow_by_default)
+{
+    melon_create_handle_pool_with_layout(pool, capacity, allocator, grow_by_default, MELON_HANDLE_INDEX_BITS,
+                                         MELON_HANDLE_GENERATION_BITS);
+}
+
+void melon_delete_handle_pool(melon_handle_pool* pool)
+{
+    MELON_FREE(pool->allocator, pool->generations);
+    MELON_FREE(pool->allocator, pool->next_free);
+}
 
 void melon_pool_reset(melon_handle_pool* pool)
 {
+    // Slots past the high-water mark are initialized when they are first handed out
     pool->freelist_head_index = MELON_HANDLE_INDEX_INVALID;
     pool->freelist_tail_index = MELON_HANDLE_INDEX_INVALID;
-    for (size_t i = 0; i < pool->capacity; i++)
-    {
-        melon_handle new_handle = i;
-        push_free_handle(pool, new_handle);
-    }
+    pool->num_initialized     = 0;
 }
 
 melon_handle melon_pool_create_handle(melon_handle_pool* pool)
 {
     // Try to pop a handle off the freelist
     melon_handle new_handle = pop_free_handle(pool);
-    if (new_handle != MELON_INVALID_HANDLE)
+    if (new_handle != pool->invalid_handle)
     {
         return new_handle;
     }
 
-    // If new_handle is invalid, it means we have to reallocate or return an invalid handle if the pool is not grow_by_default
-    if (!pool->grow_by_default)
+    // If the freelist is empty, grow the pool if every slot has been handed out at least once
+    if (pool->num_initialized == pool->capacity)
     {
-        return MELON_INVALID_HANDLE;
+        if (!pool->grow_by_default)
+        {
+            return pool->invalid_handle;
+        }
+
+        // If the new capacity is beyond the address space of the index, do not reallocate
+        size_t double_capacity = pool->capacity ? pool->capacity * 2 : 1;
+        size_t new_capacity = double_capacity > pool->index_mask ? pool->index_mask : double_capacity;
+
+        // If this part of the code is reached, then there's no more free indices and we can't expand. All there is
+        // to do is to wait for a handle to be freed.
+        if (new_capacity == pool->capacity)
+        {
+            return pool->invalid_handle;
+        }
+
+        if (!resize_slots(pool, new_capacity))
+        {
+            return pool->invalid_handle;
+        }
     }
 
-    // If the new capacity is beyond the address space of the index, do not reallocate
-    size_t double_capacity = pool->capacity * 2;
-    size_t new_capacity = double_capacity > MELON_HANDLE_INDEX_CAPACITY ? MELON_HANDLE_INDEX_CAPACITY : double_capacity;
-
-    // If this part of the code is reached, then there's no more free indices and we can't expand. All there is
-    // to do is to wait for a handle to be freed.
-    if (new_capacity == pool->capacity)
-    {
-        return MELON_INVALID_HANDLE;
-    }
+    // Hand out the next never used slot
+    new_handle                    = pool->num_initialized++;
+    pool->generations[new_handle] = 0;
+    pool->next_free[new_handle]   = (uint32_t) new_handle;
 
-    pool->handle_entries = (melon_handle_entry*) MELON_REALLOC(
-        pool->allocator, pool->handle_entries, sizeof(melon_handle_entry) * new_capacity, MELON_DEFAULT_ALIGN);
-
-    // Push new handles
-    for (size_t i = pool->capacity; i < new_capacity; i++)
-    {
-        melon_handle allocated_handle = i;
-        push_free_handle(pool, allocated_handle);
-    }
-
-    pool->capacity = new_capacity;
-
-    return pop_free_handle(pool);
+    return new_handle;
 }
 
 bool melon_handle_is_valid(melon_handle_pool* pool, melon_handle handle)
 {
-    uint64_t index      = handle_index(handle);
-    uint64_t generation = handle_generation(handle);
-    return handle != MELON_INVALID_HANDLE && generation < MELON_HANDLE_GENERATION_MAX
-           && pool->handle_entries[index].handle == handle && index < pool->capacity;
+    uint64_t index      = handle_index(pool, handle);
+    uint64_t generation = handle_generation(pool, handle);
+    return handle != pool->invalid_handle && generation < pool->generation_max && index < pool->num_initialized
+           && pool->generations[index] == generation;
 }
 
-melon_handle melon_pool_invalid_handle() { return MELON_INVALID_HANDLE; }
+melon_handle melon_pool_invalid_handle(const melon_handle_pool* pool) { return pool->invalid_handle; }
 
 bool melon_pool_delete_handle(melon_handle_pool* pool, melon_handle handle)
 {
@@ -185,29 +260,117 @@ bool melon_pool_delete_handle(melon_handle_pool* pool, melon_handle handle)
     }
 
     // Increment the handle's generation
-    handle_increment_generation(&handle);
+    handle = make_handle(pool, handle_index(pool, handle), handle_generation(pool, handle) + 1);
 
     push_free_handle(pool, handle);
     return true;
 }
 
+size_t melon_pool_create_handles(melon_handle_pool* pool, melon_handle* handles, size_t count)
+{
+    // Recycled slots are handed out first, in free list order
+    size_t created = 0;
+    while (created < count && !freelist_empty(pool))
+    {
+        handles[created++] = pop_free_handle(pool);
+    }
+
+    // Grow once for all of the remaining handles instead of checking on every handle
+    size_t remaining = count - created;
+    if (remaining > pool->capacity - pool->num_initialized && pool->grow_by_default)
+    {
+        size_t required        = pool->num_initialized + remaining;
+        size_t double_capacity = pool->capacity * 2;
+        size_t new_capacity    = double_capacity > required ? double_capacity : required;
+        new_capacity           = new_capacity > pool->index_mask ? pool->index_mask : new_capacity;
+        if (new_capacity > pool->capacity)
+        {
+            resize_slots(pool, new_capacity);
+        }
+    }
+
+    // Then never used slots are taken past the high-water mark
+    size_t available = pool->capacity - pool->num_initialized;
+    size_t fresh     = remaining < available ? remaining : available;
+    for (size_t i = 0; i < fresh; i++)
+    {
+        size_t index             = pool->num_initialized + i;
+        pool->generations[index] = 0;
+        pool->next_free[index]   = (uint32_t) index;
+        handles[created + i]     = index;
+    }
+    pool->num_initialized += fresh;
+    created += fresh;
+
+    for (size_t i = created; i < count; i++)
+    {
+        handles[i] = pool->invalid_handle;
+    }
+    return created;
+}
+
+size_t melon_pool_delete_handles(melon_handle_pool* pool, const melon_handle* handles, size_t count)
+{
+    size_t deleted = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        deleted += melon_pool_delete_handle(pool, handles[i]);
+    }
+    return deleted;
+}
+
+size_t melon_handles_are_valid(melon_handle_pool* pool, const melon_handle* handles, bool* valid, size_t count)
+{
+    if (pool->num_initialized == 0)
+    {
+        memset(valid, 0, sizeof(bool) * count);
+        return 0;
+    }
+
+    // The loop has no early outs so it compiles to selects rather than branches. Out of range indices read slot 0
+    // and are masked off by in_range
+    const uint32_t* generations     = pool->generations;
+    const size_t    num_initialized = pool->num_initialized;
+    const uint64_t  generation_max  = pool->generation_max;
+    size_t          valid_count     = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t index      = handle_index(pool, handles[i]);
+        uint64_t generation = handle_generation(pool, handles[i]);
+        bool     in_range   = index < num_initialized;
+        uint32_t current    = generations[in_range ? index : 0];
+
+        valid[i] = in_range & (generation < generation_max) & (current == generation);
+        valid_count += valid[i];
+    }
+    return valid_count;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // melon_map - a vector that uses an id pool for access
 ////////////////////////////////////////////////////////////////////////////////
 
-void _melon_create_map(void** data_ptr, _melon_map* pv, size_t capacity, size_t element_size,
-                       const melon_allocator_api* allocator, bool grow_by_default)
+void _melon_create_map_with_layout(void** data_ptr, _melon_map* pv, size_t capacity, size_t element_size,
+                                   const melon_allocator_api* allocator, bool grow_by_default, uint32_t index_bits,
+                                   uint32_t generation_bits)
 {
     pv->allocator       = *allocator;
     pv->capacity        = capacity;
     pv->element_size    = element_size;
     pv->grow_by_default = grow_by_default;
 
-    melon_create_handle_pool(&pv->pool, capacity, allocator, grow_by_default);
+    melon_create_handle_pool_with_layout(&pv->pool, capacity, allocator, grow_by_default, index_bits, generation_bits);
     pv->data    = data_ptr;
     *(pv->data) = MELON_ALLOC(pv->allocator, capacity * element_size, element_size);
 }
 
+void _melon_create_map(void** data_ptr, _melon_map* pv, size_t capacity, size_t element_size,
+                       const melon_allocator_api* allocator, bool grow_by_default)
+{
+    _melon_create_map_with_layout(data_ptr, pv, capacity, element_size, allocator, grow_by_default,
+                                  MELON_HANDLE_INDEX_BITS, MELON_HANDLE_GENERATION_BITS);
+}
+
 void _melon_delete_map(_melon_map* pv)
 {
     melon_delete_handle_pool(&pv->pool);
@@ -216,13 +379,14 @@ void _melon_delete_map(_melon_map* pv)
 
 melon_handle _melon_map_push(_melon_map* pv, const void* val)
 {
+    // A pool that is full or that can't grow past its index bits hands out the invalid handle, leave data alone
     melon_handle new_handle = melon_pool_create_handle(&pv->pool);
-    if (!melon_handle_is_valid(&pv->pool, new_handle) && !(pv->grow_by_default))
+    if (!melon_handle_is_valid(&pv->pool, new_handle))
     {
-        return melon_pool_invalid_handle();
+        return pv->pool.invalid_handle;
     }
 
-    size_t       new_index  = handle_index(new_handle);
+    size_t new_index = handle_index(&pv->pool, new_handle);
     if (new_index < pv->capacity)
     {
         memcpy((void*) ((uint8_t*) (*(pv->data)) + (pv->element_size * new_index)), val, pv->element_size);
@@ -246,7 +410,7 @@ bool _melon_map_set(_melon_map* pv, melon_handle handle, const void* val)
         return false;
     }
 
-    memcpy((void*) ((uint8_t*) (*(pv->data)) + (pv->element_size * handle_index(handle))), val, pv->element_size);
+    memcpy((void*) ((uint8_t*) (*(pv->data)) + (pv->element_size * handle_index(&pv->pool, handle))), val, pv->element_size);
 
     return true;
 }
@@ -262,3 +426,334 @@ bool _melon_map_delete(_melon_map* pv, const melon_handle handle)
 
     return true;
 }
+
+size_t _melon_map_push_array(_melon_map* pv, const void* vals, melon_handle* handles, size_t count)
+{
+    size_t created = melon_pool_create_handles(&pv->pool, handles, count);
+
+    // Every handle index is below the pool's high-water mark, so the data is grown at most once
+    size_t required = pv->pool.num_initialized;
+    if (required > pv->capacity)
+    {
+        size_t double_capacity = pv->capacity * 2;
+        size_t new_capacity    = double_capacity > required ? double_capacity : required;
+        *(pv->data)            = MELON_REALLOC(pv->allocator, *(pv->data), pv->element_size * new_capacity, MELON_DEFAULT_ALIGN);
+        pv->capacity           = new_capacity;
+    }
+
+    for (size_t i = 0; i < created; i++)
+    {
+        memcpy((void*) ((uint8_t*) (*(pv->data)) + (pv->element_size * handle_index(&pv->pool, handles[i]))),
+               (const uint8_t*) vals + (pv->element_size * i), pv->element_size);
+    }
+
+    return created;
+}
+
+size_t _melon_map_delete_array(_melon_map* pv, const melon_handle* handles, size_t count)
+{
+    return melon_pool_delete_handles(&pv->pool, handles, count);
+}
+
+static inline uint8_t* map_element(_melon_map* pv, size_t index)
+{
+    return (uint8_t*) (*(pv->data)) + (pv->element_size * index);
+}
+
+size_t _melon_map_compact(_melon_map* pv, size_t max_bytes, melon_map_remap_fn remap, void* user_data)
+{
+    melon_handle_pool* pool     = &pv->pool;
+    size_t             live_end = sort_free_list(pool);
+
+    // Always move at least one element so repeated calls make progress
+    size_t max_moves = max_bytes / pv->element_size;
+    max_moves        = max_moves ? max_moves : 1;
+
+    // Move the highest live element into the lowest free slot until every free slot is past the live elements
+    size_t moved = 0;
+    while (moved < max_moves && live_end > 0 && !freelist_empty(pool) && pool->freelist_head_index < live_end - 1)
+    {
+        size_t       old_index  = live_end - 1;
+        melon_handle old_handle = make_handle(pool, old_index, pool->generations[old_index]);
+        melon_handle new_handle = pop_free_handle(pool);
+
+        memcpy(map_element(pv, handle_index(pool, new_handle)), map_element(pv, old_index), pv->element_size);
+        melon_pool_delete_handle(pool, old_handle);
+        if (remap)
+        {
+            remap(old_handle, new_handle, user_data);
+        }
+        moved++;
+
+        while (live_end > 0 && !slot_is_live(pool, live_end - 1))
+        {
+            live_end--;
+        }
+    }
+
+    return moved;
+}
+
+void _melon_map_shrink(_melon_map* pv)
+{
+    size_t live_end = pv->pool.num_initialized;
+    while (live_end > 0 && !slot_is_live(&pv->pool, live_end - 1))
+    {
+        live_end--;
+    }
+
+    // Free slots past the new capacity grow the data back when they are reused, see _melon_map_push
+    size_t new_capacity = live_end ? live_end : 1;
+    if (new_capacity >= pv->capacity)
+    {
+        return;
+    }
+
+    void* data = MELON_REALLOC(pv->allocator, *(pv->data), pv->element_size * new_capacity, MELON_DEFAULT_ALIGN);
+    if (data)
+    {
+        *(pv->data)  = data;
+        pv->capacity = new_capacity;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// melon_paged_map - a map with stable element addresses
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void* paged_map_element(_melon_paged_map* pm, uint64_t index)
+{
+    uint8_t* page = (uint8_t*) (*(pm->pages))[index >> MELON_PAGED_MAP_PAGE_SHIFT];
+    return page + pm->element_size * (index & MELON_PAGED_MAP_PAGE_MASK);
+}
+
+// Allocates pages until index is covered. Only the page table is ever reallocated
+static bool paged_map_reserve(_melon_paged_map* pm, uint64_t index)
+{
+    size_t required_pages = (size_t) (index >> MELON_PAGED_MAP_PAGE_SHIFT) + 1;
+    if (required_pages <= pm->page_count)
+    {
+        return true;
+    }
+
+    if (required_pages > pm->page_table_capacity)
+    {
+        size_t new_capacity = pm->page_table_capacity ? pm->page_table_capacity * 2 : 1;
+        while (new_capacity < required_pages)
+            new_capacity *= 2;
+
+        void** new_table
+            = (void**) MELON_REALLOC(pm->allocator, *(pm->pages), sizeof(void*) * new_capacity, MELON_DEFAULT_ALIGN);
+        if (!new_table)
+        {
+            return false;
+        }
+        *(pm->pages)            = new_table;
+        pm->page_table_capacity = new_capacity;
+    }
+
+    for (; pm->page_count < required_pages; pm->page_count++)
+    {
+        void* page = MELON_ALLOC(pm->allocator, pm->element_size * MELON_PAGED_MAP_PAGE_SIZE, MELON_DEFAULT_ALIGN);
+        if (!page)
+        {
+            return false;
+        }
+        (*(pm->pages))[pm->page_count] = page;
+    }
+
+    return true;
+}
+
+void _melon_create_paged_map(void*** pages_ptr, _melon_paged_map* pm, size_t capacity, size_t element_size,
+                             const melon_allocator_api* allocator, bool grow_by_default)
+{
+    pm->allocator           = *allocator;
+    pm->element_size        = element_size;
+    pm->page_count          = 0;
+    pm->page_table_capacity = 0;
+    pm->pages               = pages_ptr;
+    *(pm->pages)            = NULL;
+
+    melon_create_handle_pool(&pm->pool, capacity, allocator, grow_by_default);
+    if (capacity)
+    {
+        paged_map_reserve(pm, capacity - 1);
+    }
+}
+
+void _melon_delete_paged_map(_melon_paged_map* pm)
+{
+    melon_delete_handle_pool(&pm->pool);
+    for (size_t i = 0; i < pm->page_count; i++)
+    {
+        MELON_FREE(pm->allocator, (*(pm->pages))[i]);
+    }
+    if (*(pm->pages))
+    {
+        MELON_FREE(pm->allocator, *(pm->pages));
+    }
+    *(pm->pages) = NULL;
+}
+
+melon_handle _melon_paged_map_push(_melon_paged_map* pm, const void* val)
+{
+    melon_handle new_handle = melon_pool_create_handle(&pm->pool);
+    if (new_handle == pm->pool.invalid_handle)
+    {
+        return pm->pool.invalid_handle;
+    }
+
+    uint64_t new_index = handle_index(&pm->pool, new_handle);
+    if (!paged_map_reserve(pm, new_index))
+    {
+        melon_pool_delete_handle(&pm->pool, new_handle);
+        return pm->pool.invalid_handle;
+    }
+
+    memcpy(paged_map_element(pm, new_index), val, pm->element_size);
+    return new_handle;
+}
+
+bool _melon_paged_map_set(_melon_paged_map* pm, melon_handle handle, const void* val)
+{
+    if (!melon_handle_is_valid(&(pm->pool), handle))
+    {
+        return false;
+    }
+
+    memcpy(paged_map_element(pm, handle_index(&pm->pool, handle)), val, pm->element_size);
+
+    return true;
+}
+
+bool _melon_paged_map_delete(_melon_paged_map* pm, const melon_handle handle)
+{
+    return melon_pool_delete_handle(&pm->pool, handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// melon_dense_map - a map that keeps its live elements packed
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void* dense_map_element(_melon_dense_map* dm, size_t slot)
+{
+    return (uint8_t*) (*(dm->data)) + dm->element_size * slot;
+}
+
+static bool dense_map_grow(_melon_dense_map* dm)
+{
+    size_t new_capacity = dm->capacity ? dm->capacity * 2 : 1;
+
+    void* new_data = MELON_REALLOC(dm->allocator, *(dm->data), dm->element_size * new_capacity, MELON_DEFAULT_ALIGN);
+    if (!new_data)
+    {
+        return false;
+    }
+    *(dm->data) = new_data;
+
+    melon_handle* new_handles = (melon_handle*) MELON_REALLOC(dm->allocator, dm->handles,
+                                                              sizeof(melon_handle) * new_capacity, MELON_DEFAULT_ALIGN);
+    if (!new_handles)
+    {
+        return false;
+    }
+    dm->handles  = new_handles;
+    dm->capacity = new_capacity;
+
+    return true;
+}
+
+void _melon_create_dense_map(void** data_ptr, _melon_dense_map* dm, size_t capacity, size_t element_size,
+                             const melon_allocator_api* allocator, bool grow_by_default)
+{
+    dm->allocator      = *allocator;
+    dm->element_size   = element_size;
+    dm->count          = 0;
+    dm->capacity       = capacity;
+    dm->slots_capacity = capacity;
+
+    melon_create_handle_pool(&dm->pool, capacity, allocator, grow_by_default);
+    dm->data    = data_ptr;
+    *(dm->data) = MELON_ALLOC(dm->allocator, capacity * element_size, MELON_DEFAULT_ALIGN);
+    dm->handles = (melon_handle*) MELON_ALLOC(dm->allocator, capacity * sizeof(melon_handle), MELON_DEFAULT_ALIGN);
+    dm->slots   = (size_t*) MELON_ALLOC(dm->allocator, capacity * sizeof(size_t), MELON_DEFAULT_ALIGN);
+}
+
+void _melon_delete_dense_map(_melon_dense_map* dm)
+{
+    melon_delete_handle_pool(&dm->pool);
+    MELON_FREE(dm->allocator, *(dm->data));
+    MELON_FREE(dm->allocator, dm->handles);
+    MELON_FREE(dm->allocator, dm->slots);
+}
+
+melon_handle _melon_dense_map_push(_melon_dense_map* dm, const void* val)
+{
+    melon_handle new_handle = melon_pool_create_handle(&dm->pool);
+    if (new_handle == dm->pool.invalid_handle)
+    {
+        return dm->pool.invalid_handle;
+    }
+
+    // The sparse table follows the pool's capacity, the dense arrays only the live count
+    if (dm->slots_capacity < dm->pool.capacity)
+    {
+        size_t* new_slots = (size_t*) MELON_REALLOC(dm->allocator, dm->slots, sizeof(size_t) * dm->pool.capacity,
+                                                    MELON_DEFAULT_ALIGN);
+        if (!new_slots)
+        {
+            melon_pool_delete_handle(&dm->pool, new_handle);
+            return dm->pool.invalid_handle;
+        }
+        dm->slots          = new_slots;
+        dm->slots_capacity = dm->pool.capacity;
+    }
+
+    if (dm->count == dm->capacity && !dense_map_grow(dm))
+    {
+        melon_pool_delete_handle(&dm->pool, new_handle);
+        return dm->pool.invalid_handle;
+    }
+
+    size_t slot = dm->count++;
+    memcpy(dense_map_element(dm, slot), val, dm->element_size);
+    dm->handles[slot]                              = new_handle;
+    dm->slots[handle_index(&dm->pool, new_handle)] = slot;
+
+    return new_handle;
+}
+
+bool _melon_dense_map_set(_melon_dense_map* dm, melon_handle handle, const void* val)
+{
+    if (!melon_handle_is_valid(&(dm->pool), handle))
+    {
+        return false;
+    }
+
+    memcpy(dense_map_element(dm, dm->slots[handle_index(&dm->pool, handle)]), val, dm->element_size);
+
+    return true;
+}
+
+bool _melon_dense_map_delete(_melon_dense_map* dm, const melon_handle handle)
+{
+    if (!melon_handle_is_valid(&(dm->pool), handle))
+    {
+        return false;
+    }
+
+    // Swap-remove: the last element fills the hole and its handle is pointed at the new slot
+    size_t slot = dm->slots[handle_index(&dm->pool, handle)];
+    size_t last = --dm->count;
+    if (slot != last)
+    {
+        memcpy(dense_map_element(dm, slot), dense_map_element(dm, last), dm->element_size);
+        dm->handles[slot]                                     = dm->handles[last];
+        dm->slots[handle_index(&dm->pool, dm->handles[slot])] = slot;
+    }
+
+    melon_pool_delete_handle(&dm->pool, handle);
+
+    return true;
+}
@@ -0,0 +1,145 @@
+#include <melon/core/huge_pages.h>
+#include <melon/core/error.h>
+
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Huge page callbacks
+// - every allocation is prefixed with a header telling mapped allocations
+//   apart from ones forwarded to the backing allocator. The header sits right
+//   before the returned pointer and is padded to the alignment, or to
+//   MELON_DEFAULT_ALIGN when that is larger.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    size_t   size;
+    // Size of the mapping, 0 for allocations made by the backing allocator
+    size_t   mapped_size;
+    uint32_t offset;
+    uint32_t kind;
+} huge_header;
+
+// The header is smaller than the default alignment allows for, so small alignments round up to the default one
+static inline size_t header_offset(size_t align)
+{
+    align = align > MELON_DEFAULT_ALIGN ? align : MELON_DEFAULT_ALIGN;
+    return (sizeof(huge_header) + align - 1) / align * align;
+}
+
+static inline huge_header* get_header(void* ptr) { return ((huge_header*) ptr) - 1; }
+
+static void* huge_alloc(void* user_data, size_t size, size_t align)
+{
+    melon_huge_page_allocator* huge        = (melon_huge_page_allocator*) user_data;
+    size_t                     offset      = header_offset(align);
+    size_t                     mapped_size = 0;
+    melon_vm_page_kind         kind        = MELON_VM_SMALL_PAGES;
+    uint8_t*                   base;
+
+    MELON_ASSERT(align <= MELON_HUGE_PAGE_SIZE, "Alignment %zu is larger than a huge page\n", align);
+
+    if (size >= huge->threshold)
+    {
+        base = (uint8_t*) melon_vm_alloc_huge(size + offset, &mapped_size, &kind);
+        if (base)
+            huge->live_mappings[kind]++;
+    }
+    else
+    {
+        base = (uint8_t*) MELON_ALLOC(huge->backing, size + offset, align);
+    }
+
+    if (!base)
+    {
+        return NULL;
+    }
+
+    void*        ptr    = base + offset;
+    huge_header* header = get_header(ptr);
+    header->size        = size;
+    header->mapped_size = mapped_size;
+    header->offset      = (uint32_t) offset;
+    header->kind        = kind;
+
+    return ptr;
+}
+
+static void huge_free(void* user_data, void* ptr)
+{
+    melon_huge_page_allocator* huge   = (melon_huge_page_allocator*) user_data;
+    huge_header*               header = get_header(ptr);
+    uint8_t*                   base   = (uint8_t*) ptr - header->offset;
+
+    if (header->mapped_size)
+    {
+        huge->live_mappings[header->kind]--;
+        melon_vm_free_huge(base, header->mapped_size, (melon_vm_page_kind) header->kind);
+    }
+    else
+    {
+        MELON_FREE(huge->backing, base);
+    }
+}
+
+static void* huge_realloc(void* user_data, void* ptr, size_t size, size_t align)
+{
+    melon_huge_page_allocator* huge = (melon_huge_page_allocator*) user_data;
+    if (!ptr)
+    {
+        return huge_alloc(user_data, size, align);
+    }
+
+    huge_header* header = get_header(ptr);
+    size_t       offset = header->offset;
+
+    if (offset == header_offset(align))
+    {
+        // Still fits in its mapping
+        if (header->mapped_size && size >= huge->threshold && size + offset <= header->mapped_size)
+        {
+            header->size = size;
+            return ptr;
+        }
+
+        // Stays small, let the backing allocator grow it in place if it can
+        if (!header->mapped_size && size < huge->threshold)
+        {
+            uint8_t* base = (uint8_t*) MELON_REALLOC(huge->backing, (uint8_t*) ptr - offset, size + offset, align);
+            if (!base)
+            {
+                return NULL;
+            }
+            ptr                   = base + offset;
+            get_header(ptr)->size = size;
+            return ptr;
+        }
+    }
+
+    void* result = huge_alloc(user_data, size, align);
+    if (result)
+    {
+        memcpy(result, ptr, header->size < size ? header->size : size);
+        huge_free(user_data, ptr);
+    }
+    return result;
+}
+
+void melon_create_huge_page_allocator(melon_huge_page_allocator* huge, size_t threshold,
+                                      const melon_allocator_api* backing)
+{
+    memset(huge, 0, sizeof(melon_huge_page_allocator));
+    huge->threshold = threshold;
+    huge->backing   = *backing;
+}
+
+melon_allocator_api melon_huge_page_allocator_api(melon_huge_page_allocator* huge)
+{
+    melon_allocator_api allocator;
+    allocator.alloc     = huge_alloc;
+    allocator.realloc   = huge_realloc;
+    allocator.dealloc   = huge_free;
+    allocator.user_data = huge;
+
+    return allocator;
+}
@@ -0,0 +1,321 @@
+#include <melon/core/job.h>
+#include <melon/core/atomic.h>
+#include <melon/core/error.h>
+
+// Spins a worker does without finding a job before it goes to sleep
+#define IDLE_SPIN_COUNT 64
+
+////////////////////////////////////////////////////////////////////////////////
+// Chase-Lev deque
+////////////////////////////////////////////////////////////////////////////////
+
+#define DEQUE_MASK (MELON_JOB_DEQUE_CAPACITY - 1)
+
+static bool deque_push(melon_job_deque* deque, const melon_job* job)
+{
+    int64_t bottom = (int64_t) melon_atomic_load_u64(&deque->bottom);
+    int64_t top    = (int64_t) melon_atomic_load_u64(&deque->top);
+    if (bottom - top >= MELON_JOB_DEQUE_CAPACITY)
+    {
+        return false;
+    }
+
+    deque->jobs[bottom & DEQUE_MASK] = *job;
+    melon_atomic_store_u64(&deque->bottom, (uint64_t) (bottom + 1));
+    return true;
+}
+
+static bool deque_pop(melon_job_deque* deque, melon_job* job)
+{
+    int64_t bottom = (int64_t) melon_atomic_load_u64(&deque->bottom) - 1;
+    melon_atomic_store_u64(&deque->bottom, (uint64_t) bottom);
+    // The new bottom must be visible to thieves before top is read
+    melon_atomic_thread_fence();
+    int64_t top = (int64_t) melon_atomic_load_u64(&deque->top);
+
+    if (top > bottom)
+    {
+        // Empty
+        melon_atomic_store_u64(&deque->bottom, (uint64_t) (bottom + 1));
+        return false;
+    }
+
+    *job = deque->jobs[bottom & DEQUE_MASK];
+    if (top == bottom)
+    {
+        // Last job: race thieves for it
+        bool won = melon_atomic_cas_u64(&deque->top, (uint64_t) top, (uint64_t) (top + 1));
+        melon_atomic_store_u64(&deque->bottom, (uint64_t) (bottom + 1));
+        return won;
+    }
+    return true;
+}
+
+static bool deque_steal(melon_job_deque* deque, melon_job* job)
+{
+    int64_t top = (int64_t) melon_atomic_load_u64(&deque->top);
+    melon_atomic_thread_fence();
+    int64_t bottom = (int64_t) melon_atomic_load_u64(&deque->bottom);
+    if (top >= bottom)
+    {
+        return false;
+    }
+
+    // The owner only overwrites this slot after top has moved past it, in which case the CAS fails
+    *job = deque->jobs[top & DEQUE_MASK];
+    return melon_atomic_cas_u64(&deque->top, (uint64_t) top, (uint64_t) (top + 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Workers
+////////////////////////////////////////////////////////////////////////////////
+
+static size_t current_worker(melon_job_system* system)
+{
+    size_t index = (size_t) (uintptr_t) tss_get(system->worker_index);
+    MELON_ASSERT(index != 0, "Jobs can only be queued and waited on by worker threads\n");
+    return index - 1;
+}
+
+static void run_job(const melon_job* job)
+{
+    job->fn(job->data);
+    if (job->counter)
+    {
+        melon_atomic_fetch_add_u32(&job->counter->pending, (uint32_t) -1);
+    }
+}
+
+// Pops a job off the worker's own deque, or steals one from another worker starting at a random victim
+static bool find_job(melon_job_system* system, melon_job_worker* worker, melon_job* job)
+{
+    bool found = deque_pop(&system->deques[worker->index], job);
+    if (!found)
+    {
+        worker->steal_seed = worker->steal_seed * 1664525 + 1013904223;
+        size_t victim      = (worker->steal_seed >> 16) % system->worker_count;
+        for (size_t i = 0; i < system->worker_count && !found; i++, victim = (victim + 1) % system->worker_count)
+        {
+            found = victim != worker->index && deque_steal(&system->deques[victim], job);
+        }
+    }
+
+    if (found)
+    {
+        melon_atomic_fetch_add_u32(&system->queued, (uint32_t) -1);
+    }
+    return found;
+}
+
+static void sleep_until_queued(melon_job_system* system)
+{
+    mtx_lock(&system->sleep_lock);
+    melon_atomic_fetch_add_u32(&system->sleeping, 1);
+    while (melon_atomic_load_u32(&system->queued) == 0 && melon_atomic_load_u32(&system->running))
+    {
+        cnd_wait(&system->wake, &system->sleep_lock);
+    }
+    melon_atomic_fetch_add_u32(&system->sleeping, (uint32_t) -1);
+    mtx_unlock(&system->sleep_lock);
+}
+
+static int worker_main(void* arg)
+{
+    melon_job_worker* worker = (melon_job_worker*) arg;
+    melon_job_system* system = worker->system;
+    tss_set(system->worker_index, (void*) (uintptr_t) (worker->index + 1));
+
+    size_t idle_spins = 0;
+    while (melon_atomic_load_u32(&system->running))
+    {
+        melon_job job;
+        if (find_job(system, worker, &job))
+        {
+            run_job(&job);
+            idle_spins = 0;
+        }
+        else if (++idle_spins < IDLE_SPIN_COUNT)
+        {
+            melon_cpu_relax();
+        }
+        else
+        {
+            sleep_until_queued(system);
+            idle_spins = 0;
+        }
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Job system
+////////////////////////////////////////////////////////////////////////////////
+
+bool melon_create_job_system(melon_job_system* system, size_t worker_count, const melon_allocator_api* allocator)
+{
+    MELON_ASSERT(worker_count > 0 && worker_count <= MELON_MAX_JOB_WORKERS, "Invalid worker count %zu\n", worker_count);
+
+    system->allocator    = *allocator;
+    system->worker_count = worker_count;
+    system->running      = 1;
+    system->queued       = 0;
+    system->sleeping     = 0;
+    if (tss_create(&system->worker_index, NULL) != thrd_success)
+    {
+        return false;
+    }
+    mtx_init(&system->sleep_lock, mtx_plain);
+    cnd_init(&system->wake);
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        melon_job_deque* deque = &system->deques[i];
+        deque->top             = 0;
+        deque->bottom          = 0;
+        deque->jobs            = MELON_ALLOC(system->allocator, sizeof(melon_job) * MELON_JOB_DEQUE_CAPACITY,
+                                             MELON_DEFAULT_ALIGN);
+
+        system->workers[i].system     = system;
+        system->workers[i].index      = i;
+        system->workers[i].steal_seed = (uint32_t) i * 7919 + 1;
+    }
+
+    // The creating thread is worker 0
+    tss_set(system->worker_index, (void*) (uintptr_t) 1);
+    for (size_t i = 1; i < worker_count; i++)
+    {
+        if (thrd_create(&system->workers[i].thread, worker_main, &system->workers[i]) != thrd_success)
+        {
+            // Shut down the workers that did start
+            for (size_t j = i; j < worker_count; j++)
+            {
+                MELON_FREE(system->allocator, system->deques[j].jobs);
+            }
+            system->worker_count = i;
+            melon_destroy_job_system(system);
+            return false;
+        }
+    }
+    return true;
+}
+
+void melon_destroy_job_system(melon_job_system* system)
+{
+    mtx_lock(&system->sleep_lock);
+    melon_atomic_store_u32(&system->running, 0);
+    cnd_broadcast(&system->wake);
+    mtx_unlock(&system->sleep_lock);
+
+    for (size_t i = 1; i < system->worker_count; i++)
+    {
+        thrd_join(system->workers[i].thread, NULL);
+    }
+    for (size_t i = 0; i < system->worker_count; i++)
+    {
+        MELON_FREE(system->allocator, system->deques[i].jobs);
+    }
+
+    cnd_destroy(&system->wake);
+    mtx_destroy(&system->sleep_lock);
+    tss_delete(system->worker_index);
+}
+
+void melon_job_system_run(melon_job_system* system, const melon_job* jobs, size_t count, melon_job_counter* counter)
+{
+    melon_job_deque* deque = &system->deques[current_worker(system)];
+    if (counter)
+    {
+        melon_atomic_fetch_add_u32(&counter->pending, (uint32_t) count);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        melon_job job = jobs[i];
+        job.counter   = counter;
+
+        // Counted before the push so a thief can't take the job before it is counted
+        melon_atomic_fetch_add_u32(&system->queued, 1);
+        if (!deque_push(deque, &job))
+        {
+            melon_atomic_fetch_add_u32(&system->queued, (uint32_t) -1);
+            run_job(&job);
+        }
+    }
+
+    // Sleeping workers check queued under the lock, so a wake-up can't be missed between their check and their wait
+    melon_atomic_thread_fence();
+    if (melon_atomic_load_u32(&system->sleeping))
+    {
+        mtx_lock(&system->sleep_lock);
+        cnd_broadcast(&system->wake);
+        mtx_unlock(&system->sleep_lock);
+    }
+}
+
+bool melon_job_system_try_run(melon_job_system* system)
+{
+    melon_job job;
+    if (!find_job(system, &system->workers[current_worker(system)], &job))
+    {
+        return false;
+    }
+
+    run_job(&job);
+    return true;
+}
+
+void melon_job_system_wait(melon_job_system* system, melon_job_counter* counter)
+{
+    while (melon_atomic_load_u32(&counter->pending) != 0)
+    {
+        if (!melon_job_system_try_run(system))
+        {
+            melon_cpu_relax();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// parallel_for
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    melon_parallel_for_fn fn;
+    void*                 data;
+    size_t                begin;
+    size_t                end;
+} parallel_for_batch;
+
+static void parallel_for_job(void* data)
+{
+    parallel_for_batch* batch = (parallel_for_batch*) data;
+    batch->fn(batch->data, batch->begin, batch->end);
+}
+
+void melon_parallel_for(melon_job_system* system, size_t count, size_t batch_size, melon_parallel_for_fn fn,
+                        void* data)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    batch_size               = batch_size ? batch_size : 1;
+    size_t              n    = (count + batch_size - 1) / batch_size;
+    parallel_for_batch* args = MELON_ALLOC(system->allocator, sizeof(parallel_for_batch) * n, MELON_DEFAULT_ALIGN);
+    melon_job*          jobs = MELON_ALLOC(system->allocator, sizeof(melon_job) * n, MELON_DEFAULT_ALIGN);
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t begin = i * batch_size;
+        args[i]      = (parallel_for_batch){fn, data, begin, begin + batch_size < count ? begin + batch_size : count};
+        jobs[i]      = (melon_job){parallel_for_job, &args[i], NULL};
+    }
+
+    melon_job_counter counter = {0};
+    melon_job_system_run(system, jobs, n, &counter);
+    melon_job_system_wait(system, &counter);
+
+    MELON_FREE(system->allocator, jobs);
+    MELON_FREE(system->allocator, args);
+}
@@ -1,5 +1,6 @@
 #include <melon/core/memory.h>
 #include <melon/core/error.h>
+#include <melon/core/virtual_memory.h>
 
 #include <stdarg.h>
 #include <stdlib.h>
@@ -27,9 +28,15 @@ static void* aligned_malloc(void* user_data, size_t size, size_t align)
 
 static void* aligned_realloc(void* user_data, void* ptr, size_t size, size_t align)
 {
-    size_t offset  = align - 1 + sizeof(void*);
-    void*  old_ptr = ((void**) ptr)[-1];
-    void*  new_ptr = realloc(old_ptr, size + offset);
+    if (ptr == NULL)
+    {
+        return aligned_malloc(user_data, size, align);
+    }
+
+    size_t offset     = align - 1 + sizeof(void*);
+    void*  old_ptr    = ((void**) ptr)[-1];
+    size_t old_offset = (uint8_t*) ptr - (uint8_t*) old_ptr;
+    void*  new_ptr    = realloc(old_ptr, size + offset);
 
     if (new_ptr == NULL)
     {
@@ -42,7 +49,13 @@ static void* aligned_realloc(void* user_data, void* ptr, size_t size, size_t ali
     }
 
     void** return_ptr = (void**) melon_align_forward(((void**) new_ptr) + 1, align);
-    return_ptr[-1]    = new_ptr;
+
+    // realloc keeps the data at its old offset from the start of the allocation, which may no longer be aligned
+    if ((uint8_t*) return_ptr != (uint8_t*) new_ptr + old_offset)
+    {
+        memmove(return_ptr, (uint8_t*) new_ptr + old_offset, size);
+    }
+    return_ptr[-1] = new_ptr;
 
     return (void*) return_ptr;
 }
@@ -71,8 +84,8 @@ const melon_allocator_api* melon_default_cb_allocator()
 // Arena functions
 ////////////////////////////////////////////////////////////////////////////////
 
-melon_memory_arena melon_create_arena_appended(melon_memory_block* prev, uint32_t melon_alloc_flags, size_t size,
-                                               size_t align, const melon_allocator_api* alloc)
+static melon_memory_block* create_block(melon_memory_block* prev, size_t size, size_t align,
+                                        const melon_allocator_api* alloc)
 {
     melon_memory_block* result
         = (melon_memory_block*) MELON_ALLOC((*alloc), size + align + sizeof(melon_memory_block), align);
@@ -82,14 +95,174 @@ melon_memory_arena melon_create_arena_appended(melon_memory_block* prev, uint32_
     result->allocator = *alloc;
     result->prev      = prev;
 
-    melon_memory_arena arena;
+    return result;
+}
+
+static size_t block_size_class(size_t size)
+{
+    size_t size_class = 0;
+    while (size >>= 1)
+        size_class++;
+
+    if (size_class < MELON_BLOCK_CACHE_MIN_CLASS)
+        return 0;
+    size_class -= MELON_BLOCK_CACHE_MIN_CLASS;
+    return size_class < MELON_BLOCK_CACHE_CLASSES ? size_class : MELON_BLOCK_CACHE_CLASSES - 1;
+}
+
+static bool block_fits(const melon_memory_block* block, size_t size, size_t align)
+{
+    uint8_t* result = (uint8_t*) melon_align_forward(block->start, align);
+    return (size_t) (result - block->start) + size <= block->size;
+}
+
+// Returns a block from the cache of at least block_size's class that can hold size bytes at align, or NULL if there is
+// none
+static melon_memory_block* take_cached_block(melon_block_cache* cache, size_t block_size, size_t size, size_t align)
+{
+    for (size_t size_class = block_size_class(block_size); size_class < MELON_BLOCK_CACHE_CLASSES; size_class++)
+    {
+        melon_memory_block** link = &cache->blocks[size_class];
+        while (*link)
+        {
+            melon_memory_block* block = *link;
+            if (block_fits(block, size, align))
+            {
+                *link = block->prev;
+                cache->count--;
+                return block;
+            }
+            link = &block->prev;
+        }
+    }
+
+    return NULL;
+}
+
+// Puts a block in the cache, or frees it if the cache is full
+static void release_block(melon_block_cache* cache, melon_memory_block* block)
+{
+    if (cache->count >= cache->capacity)
+    {
+        MELON_FREE(block->allocator, block);
+        return;
+    }
+
+    size_t size_class         = block_size_class(block->size);
+    block->prev               = cache->blocks[size_class];
+    block->offset             = 0;
+    cache->blocks[size_class] = block;
+    cache->count++;
+}
+
+// Releases blocks off the top of the arena until last_block is the current block
+static void release_blocks_until(melon_memory_arena* arena, melon_memory_block* last_block)
+{
+    while (arena->current_block != last_block)
+    {
+        melon_memory_block* prev = arena->current_block->prev;
+        release_block(&arena->block_cache, arena->current_block);
+
+        arena->current_block = prev;
+    }
+}
+
+melon_memory_arena melon_create_arena_appended(melon_memory_block* prev, uint32_t melon_alloc_flags, size_t size,
+                                               size_t align, const melon_allocator_api* alloc)
+{
+    melon_memory_arena arena = { 0 };
+    arena.current_block        = create_block(prev, size, align, alloc);
+    arena.allocation_flags     = melon_alloc_flags;
+    arena.temp_count           = 0;
+    arena.reserved_size        = 0;
+    arena.block_cache.capacity = MELON_BLOCK_CACHE_DEFAULT_CAPACITY;
+
+    return arena;
+}
+
+melon_memory_arena melon_create_virtual_arena(size_t reserve_size, size_t commit_size)
+{
+    melon_memory_arena arena = { 0 };
+
+    // A failed reserve or commit leaves the arena without a block, pushing to it returns NULL
+    arena.allocation_flags = MELON_ALLOC_VIRTUAL | MELON_ALLOC_EXPAND_DOUBLE;
+
+    reserve_size               = melon_vm_page_align(reserve_size);
+    melon_memory_block* result = (melon_memory_block*) melon_vm_reserve(reserve_size);
+    if (!result)
+    {
+        MELON_LOG("Virtual arena error: could not reserve %zu bytes\n", reserve_size);
+        return arena;
+    }
+
+    // The block header lives at the start of the reservation
+    uint8_t* start     = (uint8_t*) melon_align_forward(result + 1, MELON_DEFAULT_ALIGN);
+    size_t   header    = start - (uint8_t*) result;
+    size_t   committed = melon_vm_page_align(header + commit_size);
+    if (committed > reserve_size)
+        committed = reserve_size;
+
+    if (!melon_vm_commit(result, committed))
+    {
+        MELON_LOG("Virtual arena error: could not commit %zu bytes\n", committed);
+        melon_vm_release(result, reserve_size);
+        return arena;
+    }
+
+    memset(result, 0, sizeof(melon_memory_block));
+    result->start  = start;
+    result->offset = 0;
+    result->size   = committed - header;
+    result->prev   = NULL;
+
     arena.current_block = result;
+    arena.temp_count    = 0;
+    arena.reserved_size = reserve_size;
 
     return arena;
 }
 
+// Commits enough pages for the virtual arena's only block to hold required_size bytes
+static bool commit_virtual_block(melon_memory_arena* arena, size_t required_size)
+{
+    melon_memory_block* block     = arena->current_block;
+    uint8_t*            base      = (uint8_t*) block;
+    size_t              header    = block->start - base;
+    size_t              committed = header + block->size;
+    size_t              required  = header + required_size;
+
+    if (required > arena->reserved_size)
+    {
+        MELON_LOG("Virtual arena error: %zu bytes exceeds the reserved %zu bytes\n", required, arena->reserved_size);
+        return false;
+    }
+
+    size_t new_committed = arena->allocation_flags & MELON_ALLOC_EXPAND_DOUBLE ? committed * 2 : committed;
+    if (new_committed < required)
+        new_committed = required;
+    new_committed = melon_vm_page_align(new_committed);
+    if (new_committed > arena->reserved_size)
+        new_committed = arena->reserved_size;
+
+    if (!melon_vm_commit(base + committed, new_committed - committed))
+    {
+        return false;
+    }
+
+    block->size = new_committed - header;
+    return true;
+}
+
 void melon_destroy_arena(melon_memory_arena* arena)
 {
+    if (arena->allocation_flags & MELON_ALLOC_VIRTUAL)
+    {
+        if (arena->current_block)
+            melon_vm_release(arena->current_block, arena->reserved_size);
+        arena->current_block = NULL;
+        return;
+    }
+
     while (arena->current_block)
     {
         melon_memory_block* prev = arena->current_block->prev;
@@ -97,18 +270,38 @@ void melon_destroy_arena(melon_memory_arena* arena)
 
         arena->current_block = prev;
     }
+
+    melon_arena_trim_block_cache(arena);
 }
 
 void* melon_arena_push_size(melon_memory_arena* arena, size_t size, size_t align)
 {
+    // Only a virtual arena whose reservation failed has no block
+    melon_memory_block* block = arena->current_block;
+    if (!block)
+    {
+        return NULL;
+    }
+
     // Try to increment offset on current block
-    melon_memory_block* block  = arena->current_block;
-    uint8_t*            result = (uint8_t*) melon_align_forward(block->start + block->offset, align);
-    size_t              offset = result - block->start + size;
+    uint8_t* result = (uint8_t*) melon_align_forward(block->start + block->offset, align);
+    size_t   offset = result - block->start + size;
 
     // If the new offset is within the block, return the new pointer
-    if (offset < block->size)
+    if (offset <= block->size)
+    {
+        block->offset = offset;
+        return (void*) result;
+    }
+
+    // Virtual arenas grow in place by committing more of their reservation
+    if (arena->allocation_flags & MELON_ALLOC_VIRTUAL)
     {
+        if (!commit_virtual_block(arena, offset))
+        {
+            return NULL;
+        }
+
         block->offset = offset;
         return (void*) result;
     }
@@ -119,22 +312,181 @@ void* melon_arena_push_size(melon_memory_arena* arena, size_t size, size_t align
         new_block_size *= 2;
     new_block_size += align;
 
-    *arena = melon_create_arena_appended(block, arena->allocation_flags, new_block_size, align, &block->allocator);
-    melon_memory_block* new_block = arena->current_block;
+    // Reuse a block released by a previous reset or temp scope if one is big enough
+    melon_memory_block* new_block = take_cached_block(&arena->block_cache, new_block_size, size, align);
+    if (new_block)
+    {
+        arena->block_cache.hits++;
+        new_block->prev = block;
+    }
+    else
+    {
+        arena->block_cache.misses++;
+        new_block = create_block(block, new_block_size, align, &block->allocator);
+    }
+    arena->current_block = new_block;
 
     result            = (uint8_t*) melon_align_forward(new_block->start, align);
-    new_block->offset = melon_aligned_size(new_block->start, new_block->offset + size, align);
+    new_block->offset = result - new_block->start + size;
 
     return result;
 }
 
+// Returns true if the size bytes at ptr are the last allocation on the block
+static bool is_top_allocation(const melon_memory_block* block, const void* ptr, size_t size)
+{
+    const uint8_t* byte_ptr = (const uint8_t*) ptr;
+    return byte_ptr >= block->start && byte_ptr + size == block->start + block->offset;
+}
+
+void* melon_arena_realloc(melon_memory_arena* arena, void* ptr, size_t old_size, size_t new_size, size_t align)
+{
+    melon_memory_block* block = arena->current_block;
+    if (!ptr || !block)
+    {
+        return melon_arena_push_size(arena, new_size, align);
+    }
+
+    // Staying in place is only possible when ptr already satisfies the requested alignment
+    bool   aligned    = melon_align_forward(ptr, align) == ptr;
+    size_t old_offset = block->offset;
+    if (is_top_allocation(block, ptr, old_size))
+    {
+        size_t offset = (uint8_t*) ptr - block->start + new_size;
+        if (aligned && offset <= block->size)
+        {
+            block->offset = offset;
+            return ptr;
+        }
+
+        if (aligned && (arena->allocation_flags & MELON_ALLOC_VIRTUAL))
+        {
+            if (!commit_virtual_block(arena, offset))
+            {
+                return NULL;
+            }
+
+            block->offset = offset;
+            return ptr;
+        }
+
+        // Give the space back before moving. If the new allocation still fits in this block it starts at ptr rounded
+        // up to the new alignment, above ptr, so source and destination of the copy below can overlap
+        block->offset = (uint8_t*) ptr - block->start;
+    }
+    else if (aligned && new_size <= old_size)
+    {
+        return ptr;
+    }
+
+    void* result = melon_arena_push_size(arena, new_size, align);
+    if (!result)
+    {
+        // ptr stays valid when the arena is out of memory
+        block->offset = old_offset;
+        return NULL;
+    }
+
+    memmove(result, ptr, old_size < new_size ? old_size : new_size);
+    return result;
+}
+
+bool melon_arena_pop(melon_memory_arena* arena, void* ptr, size_t size)
+{
+    melon_memory_block* block = arena->current_block;
+    if (!block || !is_top_allocation(block, ptr, size))
+    {
+        return false;
+    }
+
+    block->offset = (uint8_t*) ptr - block->start;
+    return true;
+}
+
 // Deallocate extra blocks, reset offset to 0
 void melon_arena_reset(melon_memory_arena* arena)
 {
-    melon_memory_block* current_block = arena->current_block;
-    while (current_block->prev)
+    melon_memory_block* first_block = arena->current_block;
+    arena->temp_count               = 0;
+    if (!first_block)
+    {
+        return;
+    }
+
+    while (first_block->prev)
+        first_block = first_block->prev;
+
+    release_blocks_until(arena, first_block);
+    first_block->offset = 0;
+}
+
+void melon_arena_trim_block_cache(melon_memory_arena* arena)
+{
+    melon_block_cache* cache = &arena->block_cache;
+    for (size_t size_class = 0; size_class < MELON_BLOCK_CACHE_CLASSES; size_class++)
+    {
+        while (cache->blocks[size_class])
+        {
+            melon_memory_block* block = cache->blocks[size_class];
+            cache->blocks[size_class] = block->prev;
+            MELON_FREE(block->allocator, block);
+        }
+    }
+    cache->count = 0;
+}
+
+void melon_arena_reset_to_watermark(melon_memory_arena* arena, size_t watermark)
+{
+    melon_arena_reset(arena);
+
+    if (!(arena->allocation_flags & MELON_ALLOC_VIRTUAL) || !arena->current_block)
+    {
+        return;
+    }
+
+    melon_memory_block* block     = arena->current_block;
+    uint8_t*            base      = (uint8_t*) block;
+    size_t              header    = block->start - base;
+    size_t              committed = header + block->size;
+    size_t              keep      = melon_vm_page_align(header + watermark);
+
+    if (keep < committed)
+    {
+        melon_vm_decommit(base + keep, committed - keep);
+        block->size = keep - header;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Arena temp scopes
+////////////////////////////////////////////////////////////////////////////////
+
+melon_arena_temp melon_arena_begin_temp(melon_memory_arena* arena)
+{
+    melon_arena_temp temp;
+    temp.arena  = arena;
+    temp.block  = arena->current_block;
+    temp.offset = arena->current_block ? arena->current_block->offset : 0;
+
+    arena->temp_count++;
+
+    return temp;
+}
+
+void melon_arena_end_temp(melon_arena_temp temp)
+{
+    melon_memory_arena* arena = temp.arena;
+    MELON_ASSERT(arena->temp_count > 0, "Temp scope ended more times than it was begun\n");
+
+    // Release every block pushed after the scope began, then rewind the block that was current
+    release_blocks_until(arena, temp.block);
+    MELON_ASSERT(arena->current_block == temp.block, "Temp scope block is not part of the arena\n");
+    arena->temp_count--;
+    if (!arena->current_block)
     {
-        MELON_FREE(current_block->allocator, current_block);
+        return;
     }
-    current_block->offset = 0;
+
+    MELON_ASSERT(temp.offset <= arena->current_block->offset, "Temp scopes must be ended in reverse order\n");
+    arena->current_block->offset = temp.offset;
 }
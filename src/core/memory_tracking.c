@@ -0,0 +1,200 @@
+#include <melon/core/memory_tracking.h>
+#include <melon/core/error.h>
+
+#include <string.h>
+
+static melon_tracking_allocator* g_trackers = NULL;
+
+void melon_create_tracking_allocator(melon_tracking_allocator* tracker, const char* tag,
+                                     const melon_allocator_api* inner)
+{
+    memset(tracker, 0, sizeof(melon_tracking_allocator));
+    tracker->tag   = tag;
+    tracker->inner = *inner;
+
+    tracker->next = g_trackers;
+    g_trackers    = tracker;
+}
+
+void melon_destroy_tracking_allocator(melon_tracking_allocator* tracker)
+{
+    melon_tracking_allocator** link = &g_trackers;
+    while (*link && *link != tracker)
+        link = &(*link)->next;
+
+    if (*link)
+        *link = tracker->next;
+
+    if (tracker->stats.live_allocations)
+    {
+        MELON_LOG("Memory tracking: %s destroyed with %zu live allocations (%zu bytes)\n", tracker->tag,
+                  tracker->stats.live_allocations, tracker->stats.live_bytes);
+    }
+}
+
+#ifdef MELON_TRACK_MEMORY
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracking callbacks
+// - every allocation is prefixed with a header recording its size. The header
+//   sits right before the returned pointer and is padded to the alignment.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    size_t size;
+    size_t offset;
+} tracking_header;
+
+static inline size_t header_offset(size_t align)
+{
+    if (align < sizeof(tracking_header))
+        return sizeof(tracking_header);
+    return (sizeof(tracking_header) + align - 1) / align * align;
+}
+
+static inline tracking_header* get_header(void* ptr) { return ((tracking_header*) ptr) - 1; }
+
+static size_t histogram_bucket(size_t size)
+{
+    size_t bucket = 0;
+    for (size_t i = size >> 4; i; i >>= 1)
+        bucket++;
+    return bucket < MELON_ALLOCATION_HISTOGRAM_BUCKETS ? bucket : MELON_ALLOCATION_HISTOGRAM_BUCKETS - 1;
+}
+
+static void record_alloc(melon_allocation_stats* stats, size_t size)
+{
+    stats->live_bytes += size;
+    stats->live_allocations++;
+    stats->size_histogram[histogram_bucket(size)]++;
+    if (stats->live_bytes > stats->peak_bytes)
+        stats->peak_bytes = stats->live_bytes;
+}
+
+static void* tracking_alloc(void* user_data, size_t size, size_t align)
+{
+    melon_tracking_allocator* tracker = (melon_tracking_allocator*) user_data;
+
+    size_t   offset = header_offset(align);
+    uint8_t* base   = (uint8_t*) MELON_ALLOC(tracker->inner, size + offset, align);
+    if (!base)
+    {
+        return NULL;
+    }
+
+    void*            ptr    = base + offset;
+    tracking_header* header = get_header(ptr);
+    header->size            = size;
+    header->offset          = offset;
+
+    tracker->stats.total_allocations++;
+    record_alloc(&tracker->stats, size);
+
+    return ptr;
+}
+
+static void tracking_free(void* user_data, void* ptr)
+{
+    melon_tracking_allocator* tracker = (melon_tracking_allocator*) user_data;
+    tracking_header*          header  = get_header(ptr);
+
+    tracker->stats.live_bytes -= header->size;
+    tracker->stats.live_allocations--;
+    tracker->stats.total_frees++;
+
+    MELON_FREE(tracker->inner, (uint8_t*) ptr - header->offset);
+}
+
+static void* tracking_realloc(void* user_data, void* ptr, size_t size, size_t align)
+{
+    melon_tracking_allocator* tracker = (melon_tracking_allocator*) user_data;
+    if (!ptr)
+    {
+        return tracking_alloc(user_data, size, align);
+    }
+
+    tracking_header* header   = get_header(ptr);
+    size_t           old_size = header->size;
+    size_t           offset   = header->offset;
+
+    // A different alignment needs a different header size, so the data has to be moved by hand
+    if (offset != header_offset(align))
+    {
+        void* result = tracking_alloc(user_data, size, align);
+        if (result)
+        {
+            memcpy(result, ptr, old_size < size ? old_size : size);
+            tracking_free(user_data, ptr);
+        }
+        return result;
+    }
+
+    uint8_t* base = (uint8_t*) MELON_REALLOC(tracker->inner, (uint8_t*) ptr - offset, size + offset, align);
+    if (!base)
+    {
+        return NULL;
+    }
+
+    ptr          = base + offset;
+    header       = get_header(ptr);
+    header->size = size;
+
+    tracker->stats.total_reallocations++;
+    tracker->stats.live_bytes -= old_size;
+    tracker->stats.live_allocations--;
+    record_alloc(&tracker->stats, size);
+
+    return ptr;
+}
+
+melon_allocator_api melon_tracking_allocator_api(melon_tracking_allocator* tracker)
+{
+    melon_allocator_api allocator;
+    allocator.alloc     = tracking_alloc;
+    allocator.realloc   = tracking_realloc;
+    allocator.dealloc   = tracking_free;
+    allocator.user_data = tracker;
+
+    return allocator;
+}
+
+#else
+
+melon_allocator_api melon_tracking_allocator_api(melon_tracking_allocator* tracker) { return tracker->inner; }
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Report
+////////////////////////////////////////////////////////////////////////////////
+
+void melon_memory_report()
+{
+#ifdef MELON_TRACK_MEMORY
+    melon_logger_callback("Memory report:\n");
+    for (melon_tracking_allocator* tracker = g_trackers; tracker; tracker = tracker->next)
+    {
+        const melon_allocation_stats* stats = &tracker->stats;
+        melon_logger_callback("  %s: %zu bytes live in %zu allocations, %zu bytes peak\n", tracker->tag,
+                              stats->live_bytes, stats->live_allocations, stats->peak_bytes);
+        melon_logger_callback("    %zu allocations, %zu reallocations, %zu frees\n", stats->total_allocations,
+                              stats->total_reallocations, stats->total_frees);
+
+        for (size_t bucket = 0; bucket < MELON_ALLOCATION_HISTOGRAM_BUCKETS; bucket++)
+        {
+            if (!stats->size_histogram[bucket])
+                continue;
+
+            size_t low = bucket == 0 ? 0 : (size_t) 1 << (bucket + 3);
+            if (bucket == MELON_ALLOCATION_HISTOGRAM_BUCKETS - 1)
+                melon_logger_callback("    [%zu, ...): %zu\n", low, stats->size_histogram[bucket]);
+            else
+                melon_logger_callback("    [%zu, %zu): %zu\n", low, (size_t) 1 << (bucket + 4),
+                                      stats->size_histogram[bucket]);
+        }
+    }
+#else
+    melon_logger_callback("Memory report: tracking is disabled, build with MELON_TRACK_MEMORY\n");
+#endif
+}
@@ -0,0 +1,270 @@
+#include <melon/core/slab.h>
+#include <melon/core/error.h>
+#include <melon/core/virtual_memory.h>
+
+#include <string.h>
+
+// Slabs are committed this many at a time
+#define SLAB_COMMIT_COUNT 16
+
+static const uint32_t slab_class_sizes[MELON_SLAB_CLASSES]
+    = { 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024 };
+
+struct melon_slab
+{
+    struct melon_slab* next;
+    struct melon_slab* prev;
+
+    // Intrusive list of freed objects
+    void* free_list;
+    // Objects past bump_index have never been handed out
+    uint32_t bump_index;
+    uint32_t used;
+    uint32_t capacity;
+    uint32_t size_class;
+};
+
+static inline size_t slab_header_size()
+{
+    return (sizeof(melon_slab) + MELON_SLAB_MAX_ALIGN - 1) / MELON_SLAB_MAX_ALIGN * MELON_SLAB_MAX_ALIGN;
+}
+
+static inline bool slab_owns(const melon_slab_allocator* slab, const void* ptr)
+{
+    return (const uint8_t*) ptr >= slab->base && (const uint8_t*) ptr < slab->base + slab->used_size;
+}
+
+static inline melon_slab* slab_from_ptr(const melon_slab_allocator* slab, const void* ptr)
+{
+    size_t offset = (const uint8_t*) ptr - slab->base;
+    return (melon_slab*) (slab->base + offset / slab->slab_size * slab->slab_size);
+}
+
+static void unlink_slab(melon_slab** list, melon_slab* s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        *list = s->next;
+
+    if (s->next)
+        s->next->prev = s->prev;
+
+    s->next = NULL;
+    s->prev = NULL;
+}
+
+static void push_slab(melon_slab** list, melon_slab* s)
+{
+    s->prev = NULL;
+    s->next = *list;
+    if (*list)
+        (*list)->prev = s;
+    *list = s;
+}
+
+// Gets an empty slab for size_class, reusing a free slab or carving a new one out of the reservation
+static melon_slab* new_slab(melon_slab_allocator* slab, uint32_t size_class)
+{
+    melon_slab* result = slab->free_slabs;
+    if (result)
+    {
+        unlink_slab(&slab->free_slabs, result);
+    }
+    else
+    {
+        if (slab->used_size + slab->slab_size > slab->reserved_size)
+        {
+            return NULL;
+        }
+
+        if (slab->used_size + slab->slab_size > slab->committed_size)
+        {
+            size_t commit_size = slab->slab_size * SLAB_COMMIT_COUNT;
+            if (slab->committed_size + commit_size > slab->reserved_size)
+                commit_size = slab->reserved_size - slab->committed_size;
+
+            if (!melon_vm_commit(slab->base + slab->committed_size, commit_size))
+            {
+                return NULL;
+            }
+            slab->committed_size += commit_size;
+        }
+
+        result = (melon_slab*) (slab->base + slab->used_size);
+        slab->used_size += slab->slab_size;
+    }
+
+    result->next       = NULL;
+    result->prev       = NULL;
+    result->free_list  = NULL;
+    result->bump_index = 0;
+    result->used       = 0;
+    result->capacity   = (uint32_t) ((slab->slab_size - slab_header_size()) / slab_class_sizes[size_class]);
+    result->size_class = size_class;
+
+    return result;
+}
+
+void melon_create_slab_allocator(melon_slab_allocator* slab, size_t reserve_size, const melon_allocator_api* backing)
+{
+    memset(slab, 0, sizeof(melon_slab_allocator));
+
+    slab->slab_size     = melon_vm_page_size();
+    slab->reserved_size = reserve_size / slab->slab_size * slab->slab_size;
+    slab->base          = (uint8_t*) melon_vm_reserve(slab->reserved_size);
+    slab->backing       = *backing;
+
+    MELON_ASSERT(slab->base, "Could not reserve %zu bytes for a slab allocator\n", reserve_size);
+    MELON_ASSERT(slab->slab_size - slab_header_size() >= MELON_SLAB_MAX_SIZE, "Slabs are too small for the size classes\n");
+
+    // Map every size rounded up to MELON_SLAB_MAX_ALIGN to the smallest class that fits it
+    uint32_t size_class = 0;
+    for (size_t i = 0; i < sizeof(slab->size_class_lookup); i++)
+    {
+        while (slab_class_sizes[size_class] < i * MELON_SLAB_MAX_ALIGN)
+            size_class++;
+        slab->size_class_lookup[i] = (uint8_t) size_class;
+    }
+}
+
+void melon_destroy_slab_allocator(melon_slab_allocator* slab)
+{
+    if (slab->base)
+    {
+        melon_vm_release(slab->base, slab->reserved_size);
+    }
+    memset(slab, 0, sizeof(melon_slab_allocator));
+}
+
+void* melon_slab_alloc(melon_slab_allocator* slab, size_t size, size_t align)
+{
+    if (size > MELON_SLAB_MAX_SIZE || align > MELON_SLAB_MAX_ALIGN)
+    {
+        return MELON_ALLOC(slab->backing, size, align);
+    }
+
+    uint32_t    size_class = slab->size_class_lookup[(size + MELON_SLAB_MAX_ALIGN - 1) / MELON_SLAB_MAX_ALIGN];
+    melon_slab* s          = slab->partial_slabs[size_class];
+    if (!s)
+    {
+        s = new_slab(slab, size_class);
+        if (!s)
+        {
+            // Out of reserved space, fall back to the backing allocator
+            return MELON_ALLOC(slab->backing, size, align);
+        }
+        push_slab(&slab->partial_slabs[size_class], s);
+    }
+
+    void* result;
+    if (s->free_list)
+    {
+        result       = s->free_list;
+        s->free_list = *(void**) result;
+    }
+    else
+    {
+        result = (uint8_t*) s + slab_header_size() + (size_t) s->bump_index * slab_class_sizes[size_class];
+        s->bump_index++;
+    }
+
+    // Full slabs leave the partial list until one of their objects is freed
+    if (++s->used == s->capacity)
+    {
+        unlink_slab(&slab->partial_slabs[size_class], s);
+    }
+
+    return result;
+}
+
+void melon_slab_free(melon_slab_allocator* slab, void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    if (!slab_owns(slab, ptr))
+    {
+        MELON_FREE(slab->backing, ptr);
+        return;
+    }
+
+    melon_slab* s = slab_from_ptr(slab, ptr);
+    MELON_ASSERT(s->used > 0, "Slab double free\n");
+
+    *(void**) ptr = s->free_list;
+    s->free_list  = ptr;
+
+    if (s->used-- == s->capacity)
+    {
+        push_slab(&slab->partial_slabs[s->size_class], s);
+    }
+
+    // Keep one partially used slab per class around, hand empty ones back to the free list
+    if (s->used == 0 && (s->next || s->prev))
+    {
+        unlink_slab(&slab->partial_slabs[s->size_class], s);
+        push_slab(&slab->free_slabs, s);
+    }
+}
+
+void* melon_slab_realloc(melon_slab_allocator* slab, void* ptr, size_t size, size_t align)
+{
+    if (!ptr)
+    {
+        return melon_slab_alloc(slab, size, align);
+    }
+
+    if (!slab_owns(slab, ptr))
+    {
+        // Backing allocations that shrink into a size class stay with the backing allocator
+        return MELON_REALLOC(slab->backing, ptr, size, align);
+    }
+
+    melon_slab* s        = slab_from_ptr(slab, ptr);
+    size_t      old_size = slab_class_sizes[s->size_class];
+    if (size <= old_size && align <= MELON_SLAB_MAX_ALIGN)
+    {
+        return ptr;
+    }
+
+    void* result = melon_slab_alloc(slab, size, align);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    memcpy(result, ptr, old_size < size ? old_size : size);
+    melon_slab_free(slab, ptr);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocator callbacks
+////////////////////////////////////////////////////////////////////////////////
+
+static void* slab_alloc_cb(void* user_data, size_t size, size_t align)
+{
+    return melon_slab_alloc((melon_slab_allocator*) user_data, size, align);
+}
+
+static void* slab_realloc_cb(void* user_data, void* ptr, size_t size, size_t align)
+{
+    return melon_slab_realloc((melon_slab_allocator*) user_data, ptr, size, align);
+}
+
+static void slab_free_cb(void* user_data, void* ptr) { melon_slab_free((melon_slab_allocator*) user_data, ptr); }
+
+melon_allocator_api melon_slab_allocator_api(melon_slab_allocator* slab)
+{
+    melon_allocator_api allocator;
+    allocator.alloc     = slab_alloc_cb;
+    allocator.realloc   = slab_realloc_cb;
+    allocator.dealloc   = slab_free_cb;
+    allocator.user_data = slab;
+
+    return allocator;
+}
@@ -0,0 +1,302 @@
+#include <melon/core/task_graph.h>
+#include <melon/core/atomic.h>
+#include <melon/core/error.h>
+#include <melon/core/timer.h>
+#include <string.h>
+
+#define BIT(index) ((uint64_t) 1 << (index))
+
+void melon_create_task_graph(melon_task_graph* graph) { memset(graph, 0, sizeof(*graph)); }
+
+size_t melon_task_graph_add_task(melon_task_graph* graph, const melon_task_desc* desc)
+{
+    MELON_ASSERT(!graph->compiled, "Tasks can't be added to a compiled graph\n");
+    MELON_ASSERT(graph->task_count < MELON_TASK_GRAPH_MAX_TASKS, "Too many tasks\n");
+
+    size_t      index = graph->task_count++;
+    melon_task* task  = &graph->tasks[index];
+    memset(task, 0, sizeof(*task));
+    task->desc  = *desc;
+    task->graph = graph;
+    return index;
+}
+
+static size_t resource_index(melon_task_graph* graph, const char* resource)
+{
+    for (size_t i = 0; i < graph->resource_count; i++)
+    {
+        if (strcmp(graph->resources[i], resource) == 0)
+        {
+            return i;
+        }
+    }
+
+    MELON_ASSERT(graph->resource_count < MELON_TASK_GRAPH_MAX_RESOURCES, "Too many resources\n");
+    graph->resources[graph->resource_count] = resource;
+    return graph->resource_count++;
+}
+
+void melon_task_graph_read(melon_task_graph* graph, size_t task, const char* resource)
+{
+    graph->tasks[task].reads |= BIT(resource_index(graph, resource));
+}
+
+void melon_task_graph_write(melon_task_graph* graph, size_t task, const char* resource)
+{
+    graph->tasks[task].writes |= BIT(resource_index(graph, resource));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Compilation
+////////////////////////////////////////////////////////////////////////////////
+
+static void add_dependency(melon_task_graph* graph, size_t task, size_t dependency)
+{
+    graph->tasks[task].dependencies |= BIT(dependency);
+    graph->tasks[dependency].dependents |= BIT(task);
+}
+
+static uint32_t bit_count(uint64_t mask)
+{
+    uint32_t count = 0;
+    for (; mask; mask &= mask - 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+void melon_task_graph_compile(melon_task_graph* graph)
+{
+    MELON_ASSERT(!graph->compiled, "The task graph is already compiled\n");
+
+    // Last writer of each resource and the readers added since
+    int      last_writer[MELON_TASK_GRAPH_MAX_RESOURCES];
+    uint64_t readers[MELON_TASK_GRAPH_MAX_RESOURCES] = {0};
+    for (size_t r = 0; r < MELON_TASK_GRAPH_MAX_RESOURCES; r++)
+    {
+        last_writer[r] = -1;
+    }
+
+    // Dependencies only point at tasks that were added earlier, so the graph can't have cycles
+    for (size_t t = 0; t < graph->task_count; t++)
+    {
+        melon_task* task = &graph->tasks[t];
+        for (size_t r = 0; r < graph->resource_count; r++)
+        {
+            if (!((task->reads | task->writes) & BIT(r)))
+            {
+                continue;
+            }
+
+            if (last_writer[r] >= 0 && (size_t) last_writer[r] != t)
+            {
+                add_dependency(graph, t, (size_t) last_writer[r]);
+            }
+
+            if (task->writes & BIT(r))
+            {
+                for (size_t reader = 0; reader < t; reader++)
+                {
+                    if (readers[r] & BIT(reader))
+                    {
+                        add_dependency(graph, t, reader);
+                    }
+                }
+                last_writer[r] = (int) t;
+                readers[r]     = 0;
+            }
+            else
+            {
+                readers[r] |= BIT(t);
+            }
+        }
+    }
+
+    // Number of tasks on the longest chain starting at each task, computed from the last task backwards
+    uint32_t depth[MELON_TASK_GRAPH_MAX_TASKS];
+    for (size_t t = graph->task_count; t-- > 0;)
+    {
+        melon_task* task = &graph->tasks[t];
+        depth[t]         = 1;
+        for (size_t d = t + 1; d < graph->task_count; d++)
+        {
+            if ((task->dependents & BIT(d)) && depth[d] + 1 > depth[t])
+            {
+                depth[t] = depth[d] + 1;
+            }
+        }
+        task->dependency_count = bit_count(task->dependencies);
+    }
+
+    // Kahn's algorithm, taking the ready task with the longest chain first
+    uint64_t scheduled = 0;
+    for (size_t i = 0; i < graph->task_count; i++)
+    {
+        size_t best = graph->task_count;
+        for (size_t t = 0; t < graph->task_count; t++)
+        {
+            bool ready = !(scheduled & BIT(t)) && (graph->tasks[t].dependencies & ~scheduled) == 0;
+            if (ready && (best == graph->task_count || depth[t] > depth[best]))
+            {
+                best = t;
+            }
+        }
+        graph->order[i] = best;
+        scheduled |= BIT(best);
+    }
+
+    graph->compiled = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Execution
+////////////////////////////////////////////////////////////////////////////////
+
+static void run_task(void* data);
+
+static void make_ready(melon_task_graph* graph, size_t index)
+{
+    melon_task* task = &graph->tasks[index];
+    if (task->desc.main_thread)
+    {
+        uint64_t ready;
+        do
+        {
+            ready = melon_atomic_load_u64(&graph->main_thread_ready);
+        } while (!melon_atomic_cas_u64(&graph->main_thread_ready, ready, ready | BIT(index)));
+    }
+    else
+    {
+        melon_job job = {run_task, task, NULL};
+        melon_job_system_run(graph->system, &job, 1, NULL);
+    }
+}
+
+static void run_task(void* data)
+{
+    melon_task*       task  = (melon_task*) data;
+    melon_task_graph* graph = task->graph;
+
+    task->start_ns = melon_time_ns();
+    task->desc.fn(task->desc.data);
+    task->end_ns = melon_time_ns();
+
+    // Release the dependents whose last dependency this was
+    for (size_t d = 0; d < graph->task_count; d++)
+    {
+        if ((task->dependents & BIT(d))
+            && melon_atomic_fetch_add_u32(&graph->tasks[d].remaining, (uint32_t) -1) == 1)
+        {
+            make_ready(graph, d);
+        }
+    }
+
+    melon_atomic_fetch_add_u32(&graph->counter.pending, (uint32_t) -1);
+}
+
+// Runs one ready main thread task, if any
+static bool run_main_thread_task(melon_task_graph* graph)
+{
+    uint64_t ready;
+    uint64_t lowest;
+    do
+    {
+        ready = melon_atomic_load_u64(&graph->main_thread_ready);
+        if (ready == 0)
+        {
+            return false;
+        }
+        lowest = ready & (~ready + 1);
+    } while (!melon_atomic_cas_u64(&graph->main_thread_ready, ready, ready & ~lowest));
+
+    size_t index = 0;
+    while (!(lowest & BIT(index)))
+    {
+        index++;
+    }
+    run_task(&graph->tasks[index]);
+    return true;
+}
+
+static void record_critical_path(melon_task_graph* graph)
+{
+    // Longest path by measured duration, walking the schedule since it is topologically ordered
+    uint64_t path_ns[MELON_TASK_GRAPH_MAX_TASKS];
+    size_t   previous[MELON_TASK_GRAPH_MAX_TASKS];
+    size_t   last = graph->order[0];
+    for (size_t i = 0; i < graph->task_count; i++)
+    {
+        size_t      t    = graph->order[i];
+        melon_task* task = &graph->tasks[t];
+
+        path_ns[t]  = 0;
+        previous[t] = MELON_TASK_GRAPH_MAX_TASKS;
+        for (size_t d = 0; d < graph->task_count; d++)
+        {
+            if ((task->dependencies & BIT(d)) && (previous[t] == MELON_TASK_GRAPH_MAX_TASKS || path_ns[d] > path_ns[t]))
+            {
+                path_ns[t]  = path_ns[d];
+                previous[t] = d;
+            }
+        }
+        path_ns[t] += task->end_ns - task->start_ns;
+        if (path_ns[t] > path_ns[last])
+        {
+            last = t;
+        }
+    }
+
+    // Follow the chain back from its last task, filling the path in from the end
+    size_t length = 0;
+    for (size_t t = last; t != MELON_TASK_GRAPH_MAX_TASKS; t = previous[t])
+    {
+        length++;
+    }
+    graph->critical_path_ns     = path_ns[last];
+    graph->critical_path_length = length;
+    for (size_t t = last; t != MELON_TASK_GRAPH_MAX_TASKS; t = previous[t])
+    {
+        graph->critical_path[--length] = t;
+    }
+}
+
+void melon_task_graph_execute(melon_task_graph* graph, melon_job_system* system)
+{
+    MELON_ASSERT(graph->compiled, "The task graph must be compiled before it is executed\n");
+    if (graph->task_count == 0)
+    {
+        return;
+    }
+
+    uint64_t frame_start     = melon_time_ns();
+    graph->system            = system;
+    graph->main_thread_ready = 0;
+    graph->counter.pending   = (uint32_t) graph->task_count;
+    for (size_t t = 0; t < graph->task_count; t++)
+    {
+        graph->tasks[t].remaining = graph->tasks[t].dependency_count;
+    }
+
+    // The calling thread pops its own deque from the bottom, so the ready tasks are pushed shortest chain first to
+    // start it on the longest
+    for (size_t i = graph->task_count; i-- > 0;)
+    {
+        if (graph->tasks[graph->order[i]].dependency_count == 0)
+        {
+            make_ready(graph, graph->order[i]);
+        }
+    }
+
+    // The calling thread runs main thread tasks as they become ready and helps with the rest in between
+    while (melon_atomic_load_u32(&graph->counter.pending) != 0)
+    {
+        if (!run_main_thread_task(graph) && !melon_job_system_try_run(system))
+        {
+            melon_cpu_relax();
+        }
+    }
+
+    graph->frame_ns = melon_time_ns() - frame_start;
+    record_critical_path(graph);
+}
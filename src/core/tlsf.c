@@ -0,0 +1,499 @@
+#include <melon/core/tlsf.h>
+#include <melon/core/error.h>
+
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct melon_tlsf_block
+{
+    // Physically previous block, NULL for the first block in the region
+    struct melon_tlsf_block* prev_phys;
+    // Payload size, the low bits hold flags
+    size_t size;
+
+    // Only valid while the block is free, overlaps the payload otherwise
+    struct melon_tlsf_block* next_free;
+    struct melon_tlsf_block* prev_free;
+};
+
+#define BLOCK_FREE_BIT ((size_t) 1)
+#define BLOCK_HEADER_SIZE offsetof(melon_tlsf_block, next_free)
+#define BLOCK_SIZE_MIN (sizeof(melon_tlsf_block) - BLOCK_HEADER_SIZE)
+#define BLOCK_SIZE_MAX (((size_t) 1 << MELON_TLSF_FL_INDEX_MAX) - MELON_TLSF_ALIGN)
+#define SMALL_BLOCK_SIZE ((size_t) 1 << MELON_TLSF_FL_INDEX_SHIFT)
+
+MELON_STATIC_ASSERT(BLOCK_HEADER_SIZE == MELON_TLSF_ALIGN, tlsf_header_is_one_alignment_unit)
+MELON_STATIC_ASSERT(SMALL_BLOCK_SIZE / MELON_TLSF_SL_INDEX_COUNT == MELON_TLSF_ALIGN, tlsf_small_blocks_step_by_alignment)
+
+////////////////////////////////////////////////////////////////////////////////
+// Bit utilities
+////////////////////////////////////////////////////////////////////////////////
+
+static inline int tlsf_ffs(uint32_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    return _BitScanForward(&index, word) ? (int) index : -1;
+#else
+    return word ? __builtin_ctz(word) : -1;
+#endif
+}
+
+static inline int tlsf_fls(uint32_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    return _BitScanReverse(&index, word) ? (int) index : -1;
+#else
+    return word ? 31 - __builtin_clz(word) : -1;
+#endif
+}
+
+static inline int tlsf_fls_size(size_t size)
+{
+#if SIZE_MAX > 0xFFFFFFFF
+    uint32_t high = (uint32_t) (size >> 32);
+    return high ? 32 + tlsf_fls(high) : tlsf_fls((uint32_t) size);
+#else
+    return tlsf_fls((uint32_t) size);
+#endif
+}
+
+static inline size_t align_up(size_t size, size_t align) { return (size + align - 1) & ~(align - 1); }
+
+////////////////////////////////////////////////////////////////////////////////
+// Block helpers
+////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t block_size(const melon_tlsf_block* block) { return block->size & ~BLOCK_FREE_BIT; }
+
+static inline bool block_is_free(const melon_tlsf_block* block) { return block->size & BLOCK_FREE_BIT; }
+
+static inline void block_set_size(melon_tlsf_block* block, size_t size)
+{
+    block->size = size | (block->size & BLOCK_FREE_BIT);
+}
+
+static inline void block_set_free(melon_tlsf_block* block, bool is_free)
+{
+    block->size = is_free ? block->size | BLOCK_FREE_BIT : block->size & ~BLOCK_FREE_BIT;
+}
+
+static inline void* block_to_ptr(melon_tlsf_block* block) { return (uint8_t*) block + BLOCK_HEADER_SIZE; }
+
+static inline melon_tlsf_block* block_from_ptr(const void* ptr)
+{
+    return (melon_tlsf_block*) ((uint8_t*) ptr - BLOCK_HEADER_SIZE);
+}
+
+static inline melon_tlsf_block* block_next(melon_tlsf_block* block)
+{
+    return (melon_tlsf_block*) ((uint8_t*) block_to_ptr(block) + block_size(block));
+}
+
+// Size requests are rounded up to the alignment unit and the minimum payload
+static inline size_t adjust_request_size(size_t size)
+{
+    size_t adjusted = align_up(size, MELON_TLSF_ALIGN);
+    return adjusted < BLOCK_SIZE_MIN ? BLOCK_SIZE_MIN : adjusted;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Free lists
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void mapping_insert(size_t size, int* fl, int* sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        *fl = 0;
+        *sl = (int) (size / (SMALL_BLOCK_SIZE / MELON_TLSF_SL_INDEX_COUNT));
+    }
+    else
+    {
+        int fls = tlsf_fls_size(size);
+        *sl     = (int) (size >> (fls - MELON_TLSF_SL_INDEX_COUNT_LOG2)) ^ (1 << MELON_TLSF_SL_INDEX_COUNT_LOG2);
+        *fl     = fls - (MELON_TLSF_FL_INDEX_SHIFT - 1);
+    }
+}
+
+// Like mapping_insert, but rounds up to the next list so any block found there fits size
+static inline void mapping_search(size_t size, int* fl, int* sl)
+{
+    if (size >= SMALL_BLOCK_SIZE)
+    {
+        size += ((size_t) 1 << (tlsf_fls_size(size) - MELON_TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+static melon_tlsf_block* search_suitable_block(melon_tlsf_allocator* tlsf, int* fl, int* sl)
+{
+    uint32_t sl_map = tlsf->sl_bitmap[*fl] & (~0U << *sl);
+    if (!sl_map)
+    {
+        // Nothing left in this first level list, move on to the next non-empty one
+        uint32_t fl_map = tlsf->fl_bitmap & (~0U << (*fl + 1));
+        if (!fl_map)
+        {
+            return NULL;
+        }
+
+        *fl    = tlsf_ffs(fl_map);
+        sl_map = tlsf->sl_bitmap[*fl];
+    }
+
+    *sl = tlsf_ffs(sl_map);
+    return tlsf->blocks[*fl][*sl];
+}
+
+static void remove_free_block(melon_tlsf_allocator* tlsf, melon_tlsf_block* block)
+{
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    melon_tlsf_block* prev = block->prev_free;
+    melon_tlsf_block* next = block->next_free;
+    if (next)
+        next->prev_free = prev;
+    if (prev)
+        prev->next_free = next;
+
+    if (tlsf->blocks[fl][sl] == block)
+    {
+        tlsf->blocks[fl][sl] = next;
+        if (!next)
+        {
+            tlsf->sl_bitmap[fl] &= ~(1U << sl);
+            if (!tlsf->sl_bitmap[fl])
+            {
+                tlsf->fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+}
+
+static void insert_free_block(melon_tlsf_allocator* tlsf, melon_tlsf_block* block)
+{
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    melon_tlsf_block* head = tlsf->blocks[fl][sl];
+    block->next_free       = head;
+    block->prev_free       = NULL;
+    if (head)
+        head->prev_free = block;
+
+    tlsf->blocks[fl][sl] = block;
+    tlsf->fl_bitmap |= 1U << fl;
+    tlsf->sl_bitmap[fl] |= 1U << sl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Splitting and merging
+////////////////////////////////////////////////////////////////////////////////
+
+static inline bool block_can_split(melon_tlsf_block* block, size_t size)
+{
+    return block_size(block) >= size + BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN;
+}
+
+// Splits block so it has a payload of size bytes and returns the remainder, which is marked free
+static melon_tlsf_block* block_split(melon_tlsf_block* block, size_t size)
+{
+    melon_tlsf_block* remaining = (melon_tlsf_block*) ((uint8_t*) block_to_ptr(block) + size);
+    remaining->size             = (block_size(block) - size - BLOCK_HEADER_SIZE) | BLOCK_FREE_BIT;
+    remaining->prev_phys        = block;
+
+    block_next(remaining)->prev_phys = remaining;
+
+    block_set_size(block, size);
+    return remaining;
+}
+
+// Absorbs the physically next block into block
+static void block_absorb(melon_tlsf_block* block, melon_tlsf_block* next)
+{
+    block_set_size(block, block_size(block) + BLOCK_HEADER_SIZE + block_size(next));
+    block_next(block)->prev_phys = block;
+}
+
+static melon_tlsf_block* merge_prev(melon_tlsf_allocator* tlsf, melon_tlsf_block* block)
+{
+    melon_tlsf_block* prev = block->prev_phys;
+    if (prev && block_is_free(prev))
+    {
+        remove_free_block(tlsf, prev);
+        block_absorb(prev, block);
+        return prev;
+    }
+    return block;
+}
+
+static melon_tlsf_block* merge_next(melon_tlsf_allocator* tlsf, melon_tlsf_block* block)
+{
+    melon_tlsf_block* next = block_next(block);
+    if (block_is_free(next))
+    {
+        remove_free_block(tlsf, next);
+        block_absorb(block, next);
+    }
+    return block;
+}
+
+// Gives back the tail of a used block past size bytes, if it is big enough to be a block of its own
+static void trim_used(melon_tlsf_allocator* tlsf, melon_tlsf_block* block, size_t size)
+{
+    if (block_can_split(block, size))
+    {
+        melon_tlsf_block* remaining = block_split(block, size);
+        remaining                   = merge_next(tlsf, remaining);
+        insert_free_block(tlsf, remaining);
+    }
+}
+
+// Splits off the first gap bytes of a free block as their own free block and returns the rest
+static melon_tlsf_block* trim_free_leading(melon_tlsf_allocator* tlsf, melon_tlsf_block* block, size_t gap)
+{
+    melon_tlsf_block* remaining = block_split(block, gap - BLOCK_HEADER_SIZE);
+    insert_free_block(tlsf, block);
+    return remaining;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocator
+////////////////////////////////////////////////////////////////////////////////
+
+bool melon_create_tlsf_allocator(melon_tlsf_allocator* tlsf, void* memory, size_t size)
+{
+    memset(tlsf, 0, sizeof(melon_tlsf_allocator));
+
+    uint8_t* start   = (uint8_t*) melon_align_forward(memory, MELON_TLSF_ALIGN);
+    size_t   padding = start - (uint8_t*) memory;
+    size_t   usable  = size > padding ? (size - padding) & ~((size_t) MELON_TLSF_ALIGN - 1) : 0;
+
+    // One free block spanning the region, followed by a zero sized used sentinel
+    if (usable < 2 * BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN || usable - 2 * BLOCK_HEADER_SIZE > BLOCK_SIZE_MAX)
+    {
+        MELON_LOG("TLSF error: a region of %zu bytes is not supported\n", size);
+        return false;
+    }
+
+    tlsf->memory = start;
+    tlsf->size   = usable;
+
+    melon_tlsf_block* block = (melon_tlsf_block*) start;
+    block->prev_phys        = NULL;
+    block->size             = (usable - 2 * BLOCK_HEADER_SIZE) | BLOCK_FREE_BIT;
+
+    melon_tlsf_block* sentinel = block_next(block);
+    sentinel->prev_phys        = block;
+    sentinel->size             = 0;
+
+    insert_free_block(tlsf, block);
+    return true;
+}
+
+void* melon_tlsf_alloc(melon_tlsf_allocator* tlsf, size_t size, size_t align)
+{
+    size_t adjusted = adjust_request_size(size);
+    if (align < MELON_TLSF_ALIGN)
+        align = MELON_TLSF_ALIGN;
+
+    // Over-aligned requests search for enough slack to move the start forward by a whole block
+    size_t gap_min     = BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN;
+    size_t search_size = align > MELON_TLSF_ALIGN ? adjusted + align + gap_min : adjusted;
+    if (size > BLOCK_SIZE_MAX || search_size > BLOCK_SIZE_MAX)
+    {
+        return NULL;
+    }
+
+    int fl, sl;
+    mapping_search(search_size, &fl, &sl);
+    if (fl >= MELON_TLSF_FL_INDEX_COUNT)
+    {
+        return NULL;
+    }
+
+    melon_tlsf_block* block = search_suitable_block(tlsf, &fl, &sl);
+    if (!block)
+    {
+        return NULL;
+    }
+    remove_free_block(tlsf, block);
+
+    if (align > MELON_TLSF_ALIGN)
+    {
+        uint8_t* ptr     = (uint8_t*) block_to_ptr(block);
+        uint8_t* aligned = (uint8_t*) melon_align_forward(ptr, align);
+        size_t   gap     = aligned - ptr;
+        if (gap && gap < gap_min)
+        {
+            aligned = (uint8_t*) melon_align_forward(ptr + gap_min, align);
+            gap     = aligned - ptr;
+        }
+
+        if (gap)
+        {
+            block = trim_free_leading(tlsf, block, gap);
+        }
+    }
+
+    trim_used(tlsf, block, adjusted);
+    block_set_free(block, false);
+
+    return block_to_ptr(block);
+}
+
+void melon_tlsf_free(melon_tlsf_allocator* tlsf, void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    melon_tlsf_block* block = block_from_ptr(ptr);
+    MELON_ASSERT(!block_is_free(block), "TLSF double free\n");
+
+    block_set_free(block, true);
+    block = merge_prev(tlsf, block);
+    block = merge_next(tlsf, block);
+    insert_free_block(tlsf, block);
+}
+
+void* melon_tlsf_realloc(melon_tlsf_allocator* tlsf, void* ptr, size_t size, size_t align)
+{
+    if (!ptr)
+    {
+        return melon_tlsf_alloc(tlsf, size, align);
+    }
+
+    melon_tlsf_block* block    = block_from_ptr(ptr);
+    size_t            current  = block_size(block);
+    size_t            adjusted = adjust_request_size(size);
+
+    if (size <= BLOCK_SIZE_MAX && (align == 0 || (uintptr_t) ptr % align == 0))
+    {
+        melon_tlsf_block* next     = block_next(block);
+        size_t            combined = current + (block_is_free(next) ? BLOCK_HEADER_SIZE + block_size(next) : 0);
+
+        // Shrinking, or growing into a free neighbor, keeps the allocation where it is
+        if (adjusted > current && adjusted <= combined)
+        {
+            remove_free_block(tlsf, next);
+            block_absorb(block, next);
+        }
+
+        if (adjusted <= block_size(block))
+        {
+            trim_used(tlsf, block, adjusted);
+            return ptr;
+        }
+    }
+
+    void* result = melon_tlsf_alloc(tlsf, size, align);
+    if (result)
+    {
+        memcpy(result, ptr, current < size ? current : size);
+        melon_tlsf_free(tlsf, ptr);
+    }
+
+    return result;
+}
+
+size_t melon_tlsf_block_size(const void* ptr) { return block_size(block_from_ptr(ptr)); }
+
+bool melon_tlsf_validate(const melon_tlsf_allocator* tlsf)
+{
+    melon_tlsf_block* prev        = NULL;
+    melon_tlsf_block* block       = (melon_tlsf_block*) tlsf->memory;
+    size_t            free_blocks = 0;
+
+    // Walk the physical chain up to the sentinel
+    while (block_size(block) != 0)
+    {
+        if (block->prev_phys != prev)
+            return false;
+        if ((uint8_t*) block_next(block) > tlsf->memory + tlsf->size)
+            return false;
+
+        if (block_is_free(block))
+        {
+            // Free neighbors should always have been merged
+            if (prev && block_is_free(prev))
+                return false;
+
+            int fl, sl;
+            mapping_insert(block_size(block), &fl, &sl);
+
+            melon_tlsf_block* it = tlsf->blocks[fl][sl];
+            while (it && it != block)
+                it = it->next_free;
+            if (!it)
+                return false;
+
+            free_blocks++;
+        }
+
+        prev  = block;
+        block = block_next(block);
+    }
+
+    if (block->prev_phys != prev || block_is_free(block))
+        return false;
+
+    // Every listed block has to be accounted for and match the bitmaps
+    size_t listed_blocks = 0;
+    for (int fl = 0; fl < MELON_TLSF_FL_INDEX_COUNT; fl++)
+    {
+        bool fl_set = (tlsf->fl_bitmap & (1U << fl)) != 0;
+        if (fl_set != (tlsf->sl_bitmap[fl] != 0))
+            return false;
+
+        for (int sl = 0; sl < MELON_TLSF_SL_INDEX_COUNT; sl++)
+        {
+            bool sl_set = (tlsf->sl_bitmap[fl] & (1U << sl)) != 0;
+            if (sl_set != (tlsf->blocks[fl][sl] != NULL))
+                return false;
+
+            for (melon_tlsf_block* it = tlsf->blocks[fl][sl]; it; it = it->next_free)
+            {
+                if (!block_is_free(it))
+                    return false;
+                listed_blocks++;
+            }
+        }
+    }
+
+    return listed_blocks == free_blocks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocator callbacks
+////////////////////////////////////////////////////////////////////////////////
+
+static void* tlsf_alloc_cb(void* user_data, size_t size, size_t align)
+{
+    return melon_tlsf_alloc((melon_tlsf_allocator*) user_data, size, align);
+}
+
+static void* tlsf_realloc_cb(void* user_data, void* ptr, size_t size, size_t align)
+{
+    return melon_tlsf_realloc((melon_tlsf_allocator*) user_data, ptr, size, align);
+}
+
+static void tlsf_free_cb(void* user_data, void* ptr) { melon_tlsf_free((melon_tlsf_allocator*) user_data, ptr); }
+
+melon_allocator_api melon_tlsf_allocator_api(melon_tlsf_allocator* tlsf)
+{
+    melon_allocator_api allocator;
+    allocator.alloc     = tlsf_alloc_cb;
+    allocator.realloc   = tlsf_realloc_cb;
+    allocator.dealloc   = tlsf_free_cb;
+    allocator.user_data = tlsf;
+
+    return allocator;
+}
@@ -0,0 +1,161 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <melon/core/virtual_memory.h>
+#include <melon/core/error.h>
+#include <melon/core/memory.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Virtual memory functions
+////////////////////////////////////////////////////////////////////////////////
+
+// Only ask for explicit huge pages when rounding up to them wastes at most an eighth of the request
+static bool huge_rounding_is_cheap(size_t size, size_t huge_page_size)
+{
+    size_t huge_size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+    return huge_size - size <= huge_size / 8;
+}
+
+#ifdef _WIN32
+
+size_t melon_vm_page_size()
+{
+    static size_t page_size = 0;
+    if (page_size == 0)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        page_size = info.dwPageSize;
+    }
+    return page_size;
+}
+
+void* melon_vm_reserve(size_t size) { return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS); }
+
+bool melon_vm_commit(void* ptr, size_t size) { return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL; }
+
+void melon_vm_decommit(void* ptr, size_t size) { VirtualFree(ptr, size, MEM_DECOMMIT); }
+
+void melon_vm_release(void* ptr, size_t size) { VirtualFree(ptr, 0, MEM_RELEASE); }
+
+void* melon_vm_alloc_huge(size_t size, size_t* mapped_size, melon_vm_page_kind* kind)
+{
+    // Large pages need SeLockMemoryPrivilege, without it the first call fails and we use ordinary pages
+    size_t large_page_size = GetLargePageMinimum();
+    if (large_page_size && huge_rounding_is_cheap(size, large_page_size))
+    {
+        size_t huge_size = (size + large_page_size - 1) / large_page_size * large_page_size;
+        void*  ptr = VirtualAlloc(NULL, huge_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (ptr)
+        {
+            *mapped_size = huge_size;
+            *kind        = MELON_VM_HUGE_PAGES;
+            return ptr;
+        }
+    }
+
+    *mapped_size = melon_vm_page_align(size);
+    *kind        = MELON_VM_SMALL_PAGES;
+    return VirtualAlloc(NULL, *mapped_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void melon_vm_free_huge(void* ptr, size_t mapped_size, melon_vm_page_kind kind)
+{
+    // MEM_RELEASE frees the whole reservation whichever page size it was mapped with
+    (void) mapped_size;
+    (void) kind;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#else
+
+size_t melon_vm_page_size()
+{
+    static size_t page_size = 0;
+    if (page_size == 0)
+    {
+        page_size = (size_t) sysconf(_SC_PAGESIZE);
+    }
+    return page_size;
+}
+
+void* melon_vm_reserve(size_t size)
+{
+    void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        MELON_LOG("Virtual memory error: could not reserve %zu bytes\n", size);
+        return NULL;
+    }
+    return ptr;
+}
+
+bool melon_vm_commit(void* ptr, size_t size) { return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0; }
+
+void melon_vm_decommit(void* ptr, size_t size)
+{
+    madvise(ptr, size, MADV_DONTNEED);
+    mprotect(ptr, size, PROT_NONE);
+}
+
+void melon_vm_release(void* ptr, size_t size) { munmap(ptr, size); }
+
+void* melon_vm_alloc_huge(size_t size, size_t* mapped_size, melon_vm_page_kind* kind)
+{
+#ifdef MAP_HUGETLB
+    // Fails unless the system has huge pages set aside in vm.nr_hugepages
+    if (huge_rounding_is_cheap(size, MELON_HUGE_PAGE_SIZE))
+    {
+        size_t huge_size = (size + MELON_HUGE_PAGE_SIZE - 1) / MELON_HUGE_PAGE_SIZE * MELON_HUGE_PAGE_SIZE;
+        void*  ptr = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+        {
+            *mapped_size = huge_size;
+            *kind        = MELON_VM_HUGE_PAGES;
+            return ptr;
+        }
+    }
+#endif
+
+    // Over-map by a huge page and trim both ends so the range starts on a huge page boundary, which the kernel needs
+    // before it can back it with huge pages
+    size_t   small_size = melon_vm_page_align(size);
+    size_t   over_size  = small_size + MELON_HUGE_PAGE_SIZE;
+    uint8_t* base       = (uint8_t*) mmap(NULL, over_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        MELON_LOG("Virtual memory error: could not map %zu bytes\n", size);
+        return NULL;
+    }
+
+    uint8_t* ptr  = (uint8_t*) melon_align_forward(base, MELON_HUGE_PAGE_SIZE);
+    size_t   head = ptr - base;
+    if (head)
+        munmap(base, head);
+    munmap(ptr + small_size, over_size - head - small_size);
+
+    *mapped_size = small_size;
+    *kind        = MELON_VM_SMALL_PAGES;
+#ifdef MADV_HUGEPAGE
+    if (madvise(ptr, small_size, MADV_HUGEPAGE) == 0)
+        *kind = MELON_VM_TRANSPARENT_HUGE_PAGES;
+#endif
+    return ptr;
+}
+
+void melon_vm_free_huge(void* ptr, size_t mapped_size, melon_vm_page_kind kind)
+{
+    // Huge and small page mappings are both released by munmap
+    (void) kind;
+    munmap(ptr, mapped_size);
+}
+
+#endif
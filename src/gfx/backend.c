@@ -37,7 +37,11 @@ const melon_device_params* melon_default_device_params()
         default_device_params.resource_count.max_buffers         = 256;
         default_device_params.resource_count.max_pipelines       = 256;
         default_device_params.resource_count.max_command_buffers = 256;
+        default_device_params.resource_count.max_buffer_ranges   = 4096;
         default_device_params.allocator                          = *(melon_default_cb_allocator());
+        default_device_params.range_buffer_size                  = MELON_GFX_DEFAULT_RANGE_BUFFER_SIZE;
+        default_device_params.render_thread                      = false;
+        default_device_params.render_queue_depth                 = MELON_GFX_DEFAULT_RENDER_QUEUE_DEPTH;
         
         p_default_device_params                                  = &default_device_params;
     }
@@ -1,7 +1,9 @@
 #ifdef MELON_USE_OPENGL
 
 #include <melon/gfx.h>
+#include <string.h>
 #include "gfx_commands.h"
+#include "window_backend.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // OPENGL
@@ -42,7 +44,7 @@ static GLenum gl_melon_buffer_usage(melon_buffer_usage usage)
         case MELON_STATIC_BUFFER: return GL_STATIC_DRAW;
         case MELON_DYNAMIC_BUFFER: return GL_DYNAMIC_DRAW;
         case MELON_STREAM_BUFFER: return GL_STREAM_DRAW;
-        default: MELON_ASSERT("Buffer usage not supported\n");
+        default: MELON_ASSERT(false, "Buffer usage not supported\n"); return GL_STATIC_DRAW;
     }
 }
 
@@ -58,7 +60,7 @@ static GLenum gl_data_format(melon_vertex_data_type type)
         case MELON_FORMAT_UINT: return GL_UNSIGNED_INT;
         case MELON_FORMAT_HALF: return GL_HALF_FLOAT;
         case MELON_FORMAT_FLOAT: return GL_FLOAT;
-        default: MELON_ASSERT(false, "Data format not supported\n");
+        default: MELON_ASSERT(false, "Data format not supported\n"); return GL_FLOAT;
     }
 }
 
@@ -80,20 +82,122 @@ typedef struct
     size_t            stride;
 } pipeline_gl;
 
+// One of the large buffers that buffer ranges are sub-allocated from
+typedef struct
+{
+    GLuint                buffer;
+    melon_buffer_usage    usage;
+    melon_buddy_allocator ranges;
+} range_buffer_gl;
+
+typedef struct
+{
+    size_t range_buffer_index;
+    size_t offset;
+    size_t size;
+} buffer_range_gl;
+
+typedef enum
+{
+    RENDER_ITEM_SUBMIT,
+    RENDER_ITEM_CALL,
+    RENDER_ITEM_PRESENT,
+    RENDER_ITEM_QUIT
+} render_item_type;
+
+// Work queued for the render thread
+typedef struct
+{
+    render_item_type type;
+
+    // RENDER_ITEM_SUBMIT, already claimed for consuming by the submitting thread
+    cb_command_buffer** command_buffers;
+    size_t              num_cbs;
+
+    // RENDER_ITEM_CALL
+    void (*fn)(void* data);
+    void* data;
+
+    // RENDER_ITEM_PRESENT
+    melon_window* window;
+
+    uint64_t queued_ns;
+} render_item;
+
 MELON_HANDLE_MAP_TYPEDEF(pipeline_gl)
 MELON_HANDLE_MAP_TYPEDEF(cb_command_buffer)
+MELON_HANDLE_MAP_TYPEDEF(buffer_range_gl)
 
 typedef struct
 {
     melon_map_pipeline_gl       pipelines;
     melon_map_cb_command_buffer command_buffers;
-    GLuint                              dummy_vao;
+    melon_map_buffer_range_gl   buffer_ranges;
+    GLuint                      dummy_vao;
+    // Vertex arrays aren't shared between contexts, the render context changes when windows come and go
+    void*                       dummy_vao_context;
+
+    range_buffer_gl range_buffers[MELON_GFX_MAX_RANGE_BUFFERS];
+    size_t          num_range_buffers;
 
     melon_device_params config;
+
+    melon_huge_page_allocator huge_pages;
+    melon_tracking_allocator  device_memory;
+
+    // Command buffers are recorded on many threads at once, so their arenas get an allocator chain of their own that
+    // is guarded by a lock. It is only taken when an arena needs a new block, never on the push path
+    melon_huge_page_allocator command_buffer_huge_pages;
+    melon_tracking_allocator  command_buffer_memory;
+    melon_allocator_api       command_buffer_inner_allocator;
+    mtx_t                     command_buffer_lock;
+    melon_allocator_api       command_buffer_allocator;
+    // Command buffers claimed by the submission in progress, max_command_buffers of them
+    cb_command_buffer** submitted_command_buffers;
+
+    // Ring of render_queue_depth items. Item n lives in slot n % render_queue_depth and the slot is reused once the
+    // render thread has executed it
+    bool                      render_thread_running;
+    thrd_t                    render_thread;
+    mtx_t                     render_lock;
+    cnd_t                     render_queued;
+    cnd_t                     render_done;
+    render_item               render_queue[MELON_GFX_MAX_RENDER_QUEUE_DEPTH];
+    size_t                    render_queue_depth;
+    uint64_t                  render_items_queued;
+    uint64_t                  render_items_done;
+    melon_render_thread_stats render_stats;
 } device_gl;
 
 static device_gl g_device;
 
+static bool start_render_thread();
+static void stop_render_thread();
+static void run_gl(void (*fn)(void* data), void* data);
+
+static void* command_buffer_alloc(void* user_data, size_t size, size_t align)
+{
+    mtx_lock(&g_device.command_buffer_lock);
+    void* result = MELON_ALLOC(g_device.command_buffer_inner_allocator, size, align);
+    mtx_unlock(&g_device.command_buffer_lock);
+    return result;
+}
+
+static void* command_buffer_realloc(void* user_data, void* ptr, size_t size, size_t align)
+{
+    mtx_lock(&g_device.command_buffer_lock);
+    void* result = MELON_REALLOC(g_device.command_buffer_inner_allocator, ptr, size, align);
+    mtx_unlock(&g_device.command_buffer_lock);
+    return result;
+}
+
+static void command_buffer_free(void* user_data, void* ptr)
+{
+    mtx_lock(&g_device.command_buffer_lock);
+    MELON_FREE(g_device.command_buffer_inner_allocator, ptr);
+    mtx_unlock(&g_device.command_buffer_lock);
+}
+
 MELON_GFX_CREATE_DEVICE(melon_gfx_backend_init)
 {
     if (!device_config)
@@ -105,16 +209,82 @@ MELON_GFX_CREATE_DEVICE(melon_gfx_backend_init)
         g_device.config = *device_config;
     }
 
+    // Command buffer blocks and large resource maps are walked every frame, back them with huge pages
+    melon_create_huge_page_allocator(&g_device.huge_pages, MELON_HUGE_PAGE_SIZE / 2, &g_device.config.allocator);
+    melon_allocator_api huge_page_allocator = melon_huge_page_allocator_api(&g_device.huge_pages);
+
+    melon_create_huge_page_allocator(&g_device.command_buffer_huge_pages, MELON_HUGE_PAGE_SIZE / 2,
+                                     &g_device.config.allocator);
+    melon_allocator_api command_buffer_huge_page_allocator =
+        melon_huge_page_allocator_api(&g_device.command_buffer_huge_pages);
+
+    // Route device allocations through tracking allocators so melon_memory_report() can attribute them
+    melon_create_tracking_allocator(&g_device.device_memory, "gfx device", &huge_page_allocator);
+    melon_create_tracking_allocator(&g_device.command_buffer_memory, "gfx command buffers",
+                                    &command_buffer_huge_page_allocator);
+    g_device.config.allocator               = melon_tracking_allocator_api(&g_device.device_memory);
+    g_device.command_buffer_inner_allocator = melon_tracking_allocator_api(&g_device.command_buffer_memory);
+
+    mtx_init(&g_device.command_buffer_lock, mtx_plain);
+    g_device.command_buffer_allocator.alloc     = command_buffer_alloc;
+    g_device.command_buffer_allocator.realloc   = command_buffer_realloc;
+    g_device.command_buffer_allocator.dealloc   = command_buffer_free;
+    g_device.command_buffer_allocator.user_data = NULL;
+
     melon_create_map(&g_device.pipelines, g_device.config.resource_count.max_pipelines,
                              &g_device.config.allocator, false);
     melon_create_map(&g_device.command_buffers, g_device.config.resource_count.max_command_buffers,
                              &g_device.config.allocator, false);
+    melon_create_map(&g_device.buffer_ranges, g_device.config.resource_count.max_buffer_ranges,
+                     &g_device.config.allocator, true);
+
+    if (!g_device.config.range_buffer_size)
+        g_device.config.range_buffer_size = MELON_GFX_DEFAULT_RANGE_BUFFER_SIZE;
+    g_device.num_range_buffers = 0;
 
-    g_device.dummy_vao = 0;
+    g_device.dummy_vao         = 0;
+    g_device.dummy_vao_context = NULL;
+
+    g_device.submitted_command_buffers
+        = MELON_ALLOC(g_device.config.allocator,
+                      sizeof(cb_command_buffer*) * g_device.config.resource_count.max_command_buffers,
+                      MELON_DEFAULT_ALIGN);
+
+    g_device.render_thread_running = false;
+    if (g_device.config.render_thread)
+    {
+        return start_render_thread();
+    }
     return true;
 }
 
-MELON_GFX_DELETE_DEVICE(melon_gfx_backend_destroy) { glDeleteVertexArrays(1, &g_device.dummy_vao); }
+static void destroy_gl_objects(void* data)
+{
+    glDeleteVertexArrays(1, &g_device.dummy_vao);
+
+    melon_delete_map(&g_device.pipelines);
+    melon_delete_map(&g_device.command_buffers);
+    melon_delete_map(&g_device.buffer_ranges);
+
+    for (size_t i = 0; i < g_device.num_range_buffers; i++)
+    {
+        glDeleteBuffers(1, &g_device.range_buffers[i].buffer);
+        melon_destroy_buddy_allocator(&g_device.range_buffers[i].ranges);
+    }
+    g_device.num_range_buffers = 0;
+
+    MELON_FREE(g_device.config.allocator, g_device.submitted_command_buffers);
+}
+
+MELON_GFX_DELETE_DEVICE(melon_gfx_backend_destroy)
+{
+    run_gl(destroy_gl_objects, NULL);
+    stop_render_thread();
+
+    melon_destroy_tracking_allocator(&g_device.device_memory);
+    melon_destroy_tracking_allocator(&g_device.command_buffer_memory);
+    mtx_destroy(&g_device.command_buffer_lock);
+}
 
 static GLuint compile_shader(const melon_allocator_api* allocator, GLenum type,
                              const melon_shader_stage_params* shader_stage_create_info)
@@ -153,7 +323,7 @@ static GLuint compile_shader(const melon_allocator_api* allocator, GLenum type,
     return shader_stage;
 }
 
-MELON_GFX_CREATE_SHADER(melon_create_shader)
+static MELON_GFX_CREATE_SHADER(gl_create_shader)
 {
     melon_shader_handle shader_id = { MELON_GL_INVALID_ID };
 
@@ -208,9 +378,9 @@ MELON_GFX_CREATE_SHADER(melon_create_shader)
     return shader_id;
 }
 
-MELON_GFX_DELETE_SHADER(melon_delete_shader) { glDeleteProgram((GLuint) shader.data); }
+static MELON_GFX_DELETE_SHADER(gl_delete_shader) { glDeleteProgram((GLuint) shader.data); }
 
-MELON_GFX_CREATE_BUFFER(melon_create_buffer)
+static MELON_GFX_CREATE_BUFFER(gl_create_buffer)
 {
     melon_buffer_handle buffer_id = { MELON_GL_INVALID_ID };
 
@@ -236,13 +406,113 @@ MELON_GFX_CREATE_BUFFER(melon_create_buffer)
     return buffer_id;
 }
 
-MELON_GFX_DELETE_BUFFER(melon_delete_buffer)
+static MELON_GFX_DELETE_BUFFER(gl_delete_buffer)
 {
     GLuint handle = (GLuint) buffer.data;
     glDeleteBuffers(1, &handle);
 }
 
-MELON_GFX_CREATE_PIPELINE(melon_create_pipeline)
+static range_buffer_gl* create_range_buffer(melon_buffer_usage usage)
+{
+    if (g_device.num_range_buffers == MELON_GFX_MAX_RANGE_BUFFERS)
+    {
+        MELON_LOG("Buffer range error: all %d range buffers are in use\n", MELON_GFX_MAX_RANGE_BUFFERS);
+        return NULL;
+    }
+
+    range_buffer_gl* range_buffer = &g_device.range_buffers[g_device.num_range_buffers];
+    if (!melon_create_buddy_allocator(&range_buffer->ranges, g_device.config.range_buffer_size,
+                                      MELON_GFX_MIN_BUFFER_RANGE_SIZE, &g_device.config.allocator))
+    {
+        return NULL;
+    }
+
+    range_buffer->usage  = usage;
+    range_buffer->buffer = 0;
+    glGenBuffers(1, &range_buffer->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, range_buffer->buffer);
+    glBufferData(GL_ARRAY_BUFFER, g_device.config.range_buffer_size, NULL, gl_melon_buffer_usage(usage));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    g_device.num_range_buffers++;
+    return range_buffer;
+}
+
+static MELON_GFX_CREATE_BUFFER_RANGE(gl_create_buffer_range)
+{
+    melon_buffer_range_handle range_id = { melon_gfx_invalid_handle };
+
+    if (buffer_create_info->size > g_device.config.range_buffer_size)
+    {
+        MELON_LOG("Buffer range error: %zu bytes is larger than a range buffer, create a buffer instead\n",
+                  buffer_create_info->size);
+        return range_id;
+    }
+
+    // First fit over the existing buffers of the same usage, then open a new one
+    buffer_range_gl new_range = { 0 };
+    new_range.offset          = MELON_BUDDY_INVALID_OFFSET;
+    for (size_t i = 0; i < g_device.num_range_buffers && new_range.offset == MELON_BUDDY_INVALID_OFFSET; i++)
+    {
+        if (g_device.range_buffers[i].usage != buffer_create_info->usage)
+            continue;
+
+        new_range.range_buffer_index = i;
+        new_range.offset             = melon_buddy_alloc(&g_device.range_buffers[i].ranges, buffer_create_info->size);
+    }
+
+    if (new_range.offset == MELON_BUDDY_INVALID_OFFSET)
+    {
+        range_buffer_gl* range_buffer = create_range_buffer(buffer_create_info->usage);
+        if (!range_buffer)
+        {
+            return range_id;
+        }
+
+        new_range.range_buffer_index = range_buffer - g_device.range_buffers;
+        new_range.offset             = melon_buddy_alloc(&range_buffer->ranges, buffer_create_info->size);
+    }
+    new_range.size = buffer_create_info->size;
+
+    if (buffer_create_info->data)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, g_device.range_buffers[new_range.range_buffer_index].buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, new_range.offset, new_range.size, buffer_create_info->data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    range_id.data = melon_map_push(&g_device.buffer_ranges, &new_range);
+    return range_id;
+}
+
+static MELON_GFX_DELETE_BUFFER_RANGE(gl_delete_buffer_range)
+{
+    buffer_range_gl* p = melon_map_get(&g_device.buffer_ranges, range.data);
+    if (!p)
+    {
+        MELON_LOG("Buffer range deletion error: invalid ID.\n");
+        return;
+    }
+
+    melon_buddy_free(&g_device.range_buffers[p->range_buffer_index].ranges, p->offset);
+    melon_map_delete(&g_device.buffer_ranges, range.data);
+}
+
+MELON_GFX_GET_BUFFER_RANGE(melon_get_buffer_range)
+{
+    melon_buffer_range result = { { melon_gfx_invalid_handle }, 0, 0 };
+
+    buffer_range_gl* p = melon_map_get(&g_device.buffer_ranges, range.data);
+    if (p)
+    {
+        result.buffer.data = g_device.range_buffers[p->range_buffer_index].buffer;
+        result.offset      = p->offset;
+        result.size        = p->size;
+    }
+    return result;
+}
+
+static MELON_GFX_CREATE_PIPELINE(gl_create_pipeline)
 {
     pipeline_gl new_pipeline    = { 0 };
     new_pipeline.shader_program = pipeline_create_info->shader_program;
@@ -294,7 +564,7 @@ MELON_GFX_CREATE_PIPELINE(melon_create_pipeline)
     return (melon_pipeline_handle) { melon_map_push(&g_device.pipelines, &new_pipeline) };
 }
 
-MELON_GFX_DELETE_PIPELINE(melon_delete_pipeline)
+static MELON_GFX_DELETE_PIPELINE(gl_delete_pipeline)
 {
     if (!melon_map_delete(&g_device.pipelines, pipeline.data))
     {
@@ -302,31 +572,64 @@ MELON_GFX_DELETE_PIPELINE(melon_delete_pipeline)
     }
 }
 
-static void gl3_clear_pipeline(melon_pipeline_handle pipeline_id)
+// Disables the attributes of the pipeline, except for the locations set in keep
+static void gl3_disable_attribs(melon_pipeline_handle pipeline_id, uint32_t keep)
 {
     pipeline_gl* pipeline_gl = melon_map_get(&g_device.pipelines, pipeline_id.data);
 
     for (size_t attrib_index = 0; attrib_index < pipeline_gl->num_attribs; attrib_index++)
     {
         vertex_attrib_gl* attrib = &pipeline_gl->attribs[attrib_index];
-        glDisableVertexAttribArray(attrib->location);
+        bool              kept   = attrib->location >= 0 && attrib->location < 32 && (keep & (1u << attrib->location));
+        if (!kept)
+            glDisableVertexAttribArray(attrib->location);
     }
+}
 
+static void gl3_clear_pipeline(melon_pipeline_handle pipeline_id)
+{
+    gl3_disable_attribs(pipeline_id, 0);
     glUseProgram(0);
 }
 
+// The state starts out with no pipeline bound, g_device.pipelines' invalid handle
+static melon_draw_state gl3_empty_draw_state()
+{
+    melon_draw_state state = { 0 };
+    state.pipeline.data    = g_device.pipelines.map.pool.invalid_handle;
+    return state;
+}
+
 static void gl3_melon_cmd_bind_pipeline(melon_draw_state*           current_melon_draw_state,
                                         const melon_pipeline_handle pipeline_id)
 {
-    pipeline_gl* pipeline_gl           = melon_map_get(&g_device.pipelines, pipeline_id.data);
-    current_melon_draw_state->pipeline = pipeline_id;
-    gl3_clear_pipeline(pipeline_id);
+    if (current_melon_draw_state->pipeline.data == pipeline_id.data)
+        return;
 
+    pipeline_gl* pipeline_gl = melon_map_get(&g_device.pipelines, pipeline_id.data);
     MELON_ASSERT(MELON_GFX_HANDLE_IS_VALID(pipeline_gl->shader_program),
                  "Pipeline creation error: shader program ID invalid.");
     GLuint shader_program = MELON_GL_HANDLE(pipeline_gl->shader_program);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Attributes the new pipeline doesn't use are disabled. The ones it does use are respecified by the next
+    // gl3_bind_resources, since their layout may differ, so the bound vertex buffers are forgotten
+    if (melon_map_handle_is_valid(&g_device.pipelines, current_melon_draw_state->pipeline.data))
+    {
+        uint32_t locations = 0;
+        for (size_t attrib_index = 0; attrib_index < pipeline_gl->num_attribs; attrib_index++)
+        {
+            int location = pipeline_gl->attribs[attrib_index].location;
+            locations |= location >= 0 && location < 32 ? 1u << location : 0;
+        }
+        gl3_disable_attribs(current_melon_draw_state->pipeline, locations);
+    }
+    for (size_t binding = 0; binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS; binding++)
+    {
+        current_melon_draw_state->resources.buffers[binding].data   = melon_gfx_invalid_handle;
+        current_melon_draw_state->resources.buffer_offsets[binding] = 0;
+    }
+    current_melon_draw_state->pipeline = pipeline_id;
+
     glUseProgram(shader_program);
 }
 
@@ -335,40 +638,57 @@ static void gl3_bind_resources(melon_pipeline_handle pipeline_id, melon_draw_sta
 {
     pipeline_gl* pipeline_gl = melon_map_get(&g_device.pipelines, pipeline_id.data);
 
+    // Attribute pointers only need to be respecified for bindings whose buffer or offset changed. Meshes sharing a
+    // range buffer differ only in offset, so the buffer itself stays bound
+    bool binding_changed[MELON_GFX_MAX_BUFFER_ATTACHMENTS];
+    for (size_t binding = 0; binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS; binding++)
+    {
+        binding_changed[binding]
+            = current_melon_draw_state->resources.buffers[binding].data != melon_draw_resources->buffers[binding].data
+              || current_melon_draw_state->resources.buffer_offsets[binding]
+                     != melon_draw_resources->buffer_offsets[binding];
+    }
+
+    GLuint current_buffer = 0;
     for (size_t attrib_index = 0; attrib_index < pipeline_gl->num_attribs; attrib_index++)
     {
-        GLuint            current_buffer = 0;
-        vertex_attrib_gl* attrib         = &pipeline_gl->attribs[attrib_index];
+        vertex_attrib_gl* attrib = &pipeline_gl->attribs[attrib_index];
 
         melon_buffer_handle buffer = melon_draw_resources->buffers[attrib->buffer_binding];
         MELON_ASSERT(MELON_GFX_HANDLE_IS_VALID(buffer), "Buffer at binding %lu was invalid", attrib->buffer_binding);
 
-        if (current_melon_draw_state->resources.buffers[attrib->buffer_binding].data == buffer.data)
+        if (!binding_changed[attrib->buffer_binding])
             continue;
 
-        current_melon_draw_state->resources.buffers[attrib->buffer_binding] = buffer;
-
         if (current_buffer != MELON_GL_HANDLE(buffer))
         {
             current_buffer = MELON_GL_HANDLE(buffer);
             glBindBuffer(GL_ARRAY_BUFFER, current_buffer);
         }
 
+        size_t offset = melon_draw_resources->buffer_offsets[attrib->buffer_binding] + attrib->offset;
         glVertexAttribPointer(attrib->location, attrib->size, attrib->data_type, GL_FALSE, pipeline_gl->stride,
-                              (GLvoid*) attrib->offset);
+                              (GLvoid*) offset);
         glVertexAttribDivisor(attrib->location, attrib->divisor);
         glEnableVertexAttribArray(attrib->location);
     }
 
-    if (current_melon_draw_state->resources.index_buffer.data != melon_draw_resources->index_buffer.data
-        && MELON_GFX_HANDLE_IS_VALID(current_melon_draw_state->resources.index_buffer))
+    for (size_t binding = 0; binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS; binding++)
     {
-        current_melon_draw_state->resources.index_buffer = melon_draw_resources->index_buffer;
-        current_melon_draw_state->resources.index_type   = melon_draw_resources->index_type;
+        current_melon_draw_state->resources.buffers[binding]        = melon_draw_resources->buffers[binding];
+        current_melon_draw_state->resources.buffer_offsets[binding] = melon_draw_resources->buffer_offsets[binding];
+    }
 
-        GLuint index_buffer = MELON_GL_HANDLE(current_melon_draw_state->resources.index_buffer);
+    // The index offset is passed to the draw call, so only a different buffer needs a rebind
+    if (current_melon_draw_state->resources.index_buffer.data != melon_draw_resources->index_buffer.data
+        && MELON_GFX_HANDLE_IS_VALID(melon_draw_resources->index_buffer))
+    {
+        GLuint index_buffer = MELON_GL_HANDLE(melon_draw_resources->index_buffer);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
     }
+    current_melon_draw_state->resources.index_buffer        = melon_draw_resources->index_buffer;
+    current_melon_draw_state->resources.index_buffer_offset = melon_draw_resources->index_buffer_offset;
+    current_melon_draw_state->resources.index_type          = melon_draw_resources->index_type;
 }
 
 static GLenum gl_melon_draw_type(melon_draw_type type)
@@ -377,22 +697,46 @@ static GLenum gl_melon_draw_type(melon_draw_type type)
     {
         case MELON_TRIANGLES: return GL_TRIANGLES;
         case MELON_TRIANGLE_STRIP: return GL_TRIANGLE_STRIP;
-        case MELON_LINES: return GL_LINE;
-        case MELON_POINTS: return GL_POINT;
+        case MELON_LINES: return GL_LINES;
+        case MELON_POINTS: return GL_POINTS;
+        default: MELON_ASSERT(false, "Draw type not supported\n"); return GL_TRIANGLES;
     }
 }
 
-// TODO: should pass in a "command context" object to store current state, eventually wrap
-// everything in a command buffer
-MELON_GFX_EXECUTE_DRAW_GROUPS(melon_execute_draw_groups)
+static void gl3_draw(const melon_draw_call_params* draw_call, const melon_draw_resources* resources)
 {
-    if (g_device.dummy_vao == 0)
+    if (MELON_GFX_HANDLE_IS_VALID(resources->index_buffer))
+    {
+        glDrawElementsInstancedBaseVertex(gl_melon_draw_type(draw_call->type), draw_call->num_vertices,
+                                          gl_data_format(resources->index_type),
+                                          (GLvoid*) resources->index_buffer_offset, draw_call->instances,
+                                          draw_call->base_vertex);
+    }
+    else
+    {
+        glDrawArraysInstanced(gl_melon_draw_type(draw_call->type), draw_call->base_vertex, draw_call->num_vertices,
+                              draw_call->instances);
+    }
+}
+
+static void bind_dummy_vao()
+{
+    void* context = melon_window_backend_render_context();
+    if (g_device.dummy_vao == 0 || g_device.dummy_vao_context != context)
     {
         glGenVertexArrays(1, &g_device.dummy_vao);
         glBindVertexArray(g_device.dummy_vao);
+        g_device.dummy_vao_context = context;
     }
+}
+
+// TODO: should pass in a "command context" object to store current state, eventually wrap
+// everything in a command buffer
+static MELON_GFX_EXECUTE_DRAW_GROUPS(gl_execute_draw_groups)
+{
+    bind_dummy_vao();
 
-    melon_draw_state current_melon_draw_state = { 0 };
+    melon_draw_state current_melon_draw_state = gl3_empty_draw_state();
     for (size_t i = 0; i < num_melon_draw_groups; i++)
     {
         melon_pipeline_handle       pipeline  = melon_draw_groups[i].pipeline;
@@ -410,32 +754,25 @@ MELON_GFX_EXECUTE_DRAW_GROUPS(melon_execute_draw_groups)
             gl3_bind_resources(pipeline, &current_melon_draw_state, resources);
             glCheckError();
 
-            if (MELON_GFX_HANDLE_IS_VALID(resources->index_buffer))
-            {
-                glDrawElementsInstancedBaseVertex(gl_melon_draw_type(draw_call->type), draw_call->num_vertices,
-                                                  gl_data_format(resources->index_type), NULL, draw_call->instances,
-                                                  draw_call->base_vertex);
-            }
-            else
-            {
-                glDrawArraysInstanced(gl_melon_draw_type(draw_call->type), draw_call->base_vertex,
-                                      draw_call->num_vertices, draw_call->instances);
-            }
+            gl3_draw(draw_call, resources);
         }
     }
-    gl3_clear_pipeline(current_melon_draw_state.pipeline);
+    if (melon_map_handle_is_valid(&g_device.pipelines, current_melon_draw_state.pipeline.data))
+        gl3_clear_pipeline(current_melon_draw_state.pipeline);
 }
 
 MELON_GFX_CREATE_COMMAND_BUFFER(melon_create_command_buffer)
 {
     cb_command_buffer new_cb;
-    cb_create(&g_device.config.allocator, &new_cb, MELON_MEGABYTE(2));
+    cb_create(&g_device.command_buffer_allocator, &new_cb, MELON_MEGABYTE(2));
     return (melon_command_buffer_handle){ melon_map_push(&g_device.command_buffers, &new_cb) };
 }
 
 MELON_GFX_DELETE_COMMAND_BUFFER(melon_delete_command_buffer)
 {
     cb_command_buffer* p = melon_map_get(&g_device.command_buffers, cb.data);
+    // A queued submission may still be reading it
+    cb_wait_consumed(p);
     cb_destroy(p);
 }
 
@@ -453,14 +790,15 @@ MELON_GFX_CB_END_RECORDING(melon_end_recording)
 
 MELON_GFX_CB_BIND_VERTEX_BUFFER(melon_cmd_bind_vertex_buffer)
 {
+    MELON_ASSERT(binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS, "Vertex buffer binding %zu is out of range\n", binding);
     cb_command_buffer* p = melon_map_get(&g_device.command_buffers, cb.data);
-    cb_cmd_bind_vertex_buffer(p, buffer, binding);
+    cb_cmd_bind_vertex_buffer(p, buffer, binding, offset);
 }
 
 MELON_GFX_CB_BIND_INDEX_BUFFER(melon_cmd_bind_index_buffer)
 {
     cb_command_buffer* p = melon_map_get(&g_device.command_buffers, cb.data);
-    cb_cmd_bind_index_buffer(p, buffer);
+    cb_cmd_bind_index_buffer(p, buffer, index_type, offset);
 }
 
 MELON_GFX_CB_BIND_PIPELINE(melon_cmd_bind_pipeline)
@@ -475,6 +813,12 @@ MELON_GFX_CB_DRAW(melon_cmd_draw)
     cb_cmd_draw(p, params);
 }
 
+MELON_GFX_CB_CLEAR(melon_cmd_clear)
+{
+    cb_command_buffer* p = melon_map_get(&g_device.command_buffers, cb.data);
+    cb_cmd_clear(p, color);
+}
+
 MELON_GFX_CB_RESET(melon_reset)
 {
     cb_command_buffer* p = melon_map_get(&g_device.command_buffers, cb.data);
@@ -493,58 +837,472 @@ void melon_end_consuming(melon_command_buffer_handle cb)
     cb_end_consuming(p);
 }
 
+// GL side of cb_translate
+typedef struct
+{
+    pipeline_gl* pipeline;
+    GLuint       array_buffer;
+} gl3_translation;
+
+static void gl3_translate_bind_pipeline(void* user_data, melon_pipeline_handle pipeline,
+                                        melon_pipeline_handle previous)
+{
+    gl3_translation* translation = (gl3_translation*) user_data;
+    melon_draw_state state       = gl3_empty_draw_state();
+    state.pipeline               = previous;
+    gl3_melon_cmd_bind_pipeline(&state, pipeline);
+    translation->pipeline = melon_map_get(&g_device.pipelines, pipeline.data);
+}
+
+static void gl3_translate_bind_vertex_buffer(void* user_data, size_t binding, melon_buffer_handle buffer,
+                                             size_t offset)
+{
+    gl3_translation* translation = (gl3_translation*) user_data;
+    pipeline_gl*     pipeline_gl = translation->pipeline;
+    if (!pipeline_gl)
+        return;
+
+    for (size_t attrib_index = 0; attrib_index < pipeline_gl->num_attribs; attrib_index++)
+    {
+        vertex_attrib_gl* attrib = &pipeline_gl->attribs[attrib_index];
+        if (attrib->buffer_binding != binding)
+            continue;
+
+        MELON_ASSERT(MELON_GFX_HANDLE_IS_VALID(buffer), "Buffer at binding %lu was invalid", binding);
+        if (translation->array_buffer != MELON_GL_HANDLE(buffer))
+        {
+            translation->array_buffer = MELON_GL_HANDLE(buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, translation->array_buffer);
+        }
+
+        glVertexAttribPointer(attrib->location, attrib->size, attrib->data_type, GL_FALSE, pipeline_gl->stride,
+                              (GLvoid*) (offset + attrib->offset));
+        glVertexAttribDivisor(attrib->location, attrib->divisor);
+        glEnableVertexAttribArray(attrib->location);
+    }
+}
+
+static void gl3_translate_bind_index_buffer(void* user_data, melon_buffer_handle buffer)
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MELON_GL_HANDLE(buffer));
+}
+
+static void gl3_translate_draw(void* user_data, const melon_draw_call_params* params,
+                               const melon_draw_resources* resources)
+{
+    MELON_ASSERT(((gl3_translation*) user_data)->pipeline, "Draw recorded without a valid pipeline bound\n");
+    gl3_draw(params, resources);
+}
+
+static void gl3_translate_clear(void* user_data, const float color[4])
+{
+    glClearColor(color[0], color[1], color[2], color[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Translates command buffers that were claimed with cb_begin_consuming() to GL, in order
+static void execute_command_buffers(cb_command_buffer** command_buffers, size_t num_cbs)
+{
+    bind_dummy_vao();
+
+    gl3_translation translation = { NULL, 0 };
+    cb_backend      backend     = { gl3_translate_bind_pipeline, gl3_translate_bind_vertex_buffer,
+                                    gl3_translate_bind_index_buffer, gl3_translate_draw, gl3_translate_clear,
+                                    &translation };
+
+    melon_draw_state empty = gl3_empty_draw_state();
+    melon_draw_state bound = empty;
+    cb_translate(command_buffers, num_cbs, &empty, &bound, &backend);
+
+    if (melon_map_handle_is_valid(&g_device.pipelines, bound.pipeline.data))
+        gl3_clear_pipeline(bound.pipeline);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Render thread
+// - Owns the GL context while it runs. Everything that touches GL or the
+//   maps the translation reads goes through one FIFO queue, so resource
+//   changes and submissions reach the driver in the order they were made.
+// - Submissions are queued without waiting, up to render_queue_depth of them.
+//   Other calls are queued and waited on.
+////////////////////////////////////////////////////////////////////////////////
+
+// Waits for a free slot and returns it with render_lock held
+static render_item* begin_render_item(render_item_type type)
+{
+    mtx_lock(&g_device.render_lock);
+    if (g_device.render_items_queued - g_device.render_items_done == g_device.render_queue_depth)
+    {
+        uint64_t stall_start = melon_time_ns();
+        while (g_device.render_items_queued - g_device.render_items_done == g_device.render_queue_depth)
+        {
+            cnd_wait(&g_device.render_done, &g_device.render_lock);
+        }
+        g_device.render_stats.submit_stall_ns += melon_time_ns() - stall_start;
+    }
+
+    render_item* item = &g_device.render_queue[g_device.render_items_queued % g_device.render_queue_depth];
+    item->type        = type;
+    return item;
+}
+
+// Queues the item and releases render_lock. Returns the number of items queued so far, including this one
+static uint64_t end_render_item(render_item* item)
+{
+    item->queued_ns = melon_time_ns();
+    uint64_t ticket = ++g_device.render_items_queued;
+    cnd_signal(&g_device.render_queued);
+    mtx_unlock(&g_device.render_lock);
+    return ticket;
+}
+
+static void wait_for_render_items(uint64_t ticket)
+{
+    mtx_lock(&g_device.render_lock);
+    while (g_device.render_items_done < ticket)
+    {
+        cnd_wait(&g_device.render_done, &g_device.render_lock);
+    }
+    mtx_unlock(&g_device.render_lock);
+}
+
+// Runs fn on the thread that owns the GL context and returns once it has
+static void run_gl(void (*fn)(void* data), void* data)
+{
+    if (!g_device.render_thread_running)
+    {
+        fn(data);
+        return;
+    }
+
+    render_item* item = begin_render_item(RENDER_ITEM_CALL);
+    item->fn          = fn;
+    item->data        = data;
+    wait_for_render_items(end_render_item(item));
+}
+
+static int render_thread_main(void* arg)
+{
+    void* context = NULL;
+
+    mtx_lock(&g_device.render_lock);
+    for (;;)
+    {
+        while (g_device.render_items_done == g_device.render_items_queued)
+        {
+            cnd_wait(&g_device.render_queued, &g_device.render_lock);
+        }
+        render_item* item = &g_device.render_queue[g_device.render_items_done % g_device.render_queue_depth];
+        mtx_unlock(&g_device.render_lock);
+
+        // Follows the render context over to the first window once it has been created
+        void* render_context = melon_window_backend_render_context();
+        if (render_context != context)
+        {
+            melon_window_backend_make_current(render_context);
+            context = render_context;
+        }
+
+        uint64_t start = melon_time_ns();
+        switch (item->type)
+        {
+            case RENDER_ITEM_SUBMIT: execute_command_buffers(item->command_buffers, item->num_cbs); break;
+            case RENDER_ITEM_CALL: item->fn(item->data); break;
+            case RENDER_ITEM_PRESENT: melon_window_backend_swap_buffers(item->window); break;
+            case RENDER_ITEM_QUIT: break;
+        }
+        uint64_t end = melon_time_ns();
+
+        mtx_lock(&g_device.render_lock);
+        if (item->type == RENDER_ITEM_SUBMIT)
+        {
+            melon_render_thread_stats* stats = &g_device.render_stats;
+            stats->frames++;
+            stats->last_queue_latency_ns = start - item->queued_ns;
+            stats->last_execute_ns       = end - start;
+            if (stats->last_queue_latency_ns > stats->max_queue_latency_ns)
+                stats->max_queue_latency_ns = stats->last_queue_latency_ns;
+            if (stats->last_execute_ns > stats->max_execute_ns)
+                stats->max_execute_ns = stats->last_execute_ns;
+        }
+
+        bool quit = item->type == RENDER_ITEM_QUIT;
+        g_device.render_items_done++;
+        cnd_broadcast(&g_device.render_done);
+        if (quit)
+        {
+            break;
+        }
+    }
+    mtx_unlock(&g_device.render_lock);
+
+    // Hand the context back to the thread that stops the render thread
+    melon_window_backend_make_current(NULL);
+    return 0;
+}
+
+static bool start_render_thread()
+{
+    size_t depth = g_device.config.render_queue_depth;
+    depth        = depth ? depth : MELON_GFX_DEFAULT_RENDER_QUEUE_DEPTH;
+    MELON_ASSERT(depth <= MELON_GFX_MAX_RENDER_QUEUE_DEPTH, "Render queue depth %zu is too large\n", depth);
+
+    // Each slot can hold every command buffer of the device
+    size_t              max_cbs = g_device.config.resource_count.max_command_buffers;
+    cb_command_buffer** cbs     = MELON_ALLOC(g_device.config.allocator, sizeof(cb_command_buffer*) * max_cbs * depth,
+                                              MELON_DEFAULT_ALIGN);
+    for (size_t i = 0; i < depth; i++)
+    {
+        g_device.render_queue[i].command_buffers = cbs + i * max_cbs;
+    }
+
+    g_device.render_queue_depth  = depth;
+    g_device.render_items_queued = 0;
+    g_device.render_items_done   = 0;
+    g_device.render_stats        = (melon_render_thread_stats){ 0 };
+    mtx_init(&g_device.render_lock, mtx_plain);
+    cnd_init(&g_device.render_queued);
+    cnd_init(&g_device.render_done);
+
+    // The render thread takes over the context that is current here
+    melon_window_backend_make_current(NULL);
+    if (thrd_create(&g_device.render_thread, render_thread_main, NULL) != thrd_success)
+    {
+        MELON_LOG("Render thread error: could not start the render thread\n");
+        melon_window_backend_make_current(melon_window_backend_render_context());
+        cnd_destroy(&g_device.render_done);
+        cnd_destroy(&g_device.render_queued);
+        mtx_destroy(&g_device.render_lock);
+        MELON_FREE(g_device.config.allocator, cbs);
+        return false;
+    }
+
+    g_device.render_thread_running = true;
+    return true;
+}
+
+static void stop_render_thread()
+{
+    if (!g_device.render_thread_running)
+    {
+        return;
+    }
+
+    end_render_item(begin_render_item(RENDER_ITEM_QUIT));
+    thrd_join(g_device.render_thread, NULL);
+    g_device.render_thread_running = false;
+    melon_window_backend_make_current(melon_window_backend_render_context());
+
+    cnd_destroy(&g_device.render_done);
+    cnd_destroy(&g_device.render_queued);
+    mtx_destroy(&g_device.render_lock);
+    MELON_FREE(g_device.config.allocator, g_device.render_queue[0].command_buffers);
+}
+
 /**
+ * Command buffers are consumed in the order they are passed in, whichever threads recorded them, so a frame recorded
+ * in parallel translates to the same GL calls every time. With a render thread the submission is only queued; the
+ * command buffers can be recorded again once it has been executed.
  * TODO: Render passes, sorting commands by render pass
  */
-MELON_GFX_CB_SUBMIT(submit_commands)
+MELON_GFX_CB_SUBMIT(melon_submit_command_buffers)
 {
-    if (g_device.dummy_vao == 0)
-    {
-        glGenVertexArrays(1, &g_device.dummy_vao);
-        glBindVertexArray(g_device.dummy_vao);
-    }
-    // Translate to GL
+    MELON_ASSERT(num_cbs <= g_device.config.resource_count.max_command_buffers, "Too many command buffers\n");
+
+    // Claim every command buffer before translating or queueing, recording into them again waits until they have
+    // been consumed. A command buffer passed twice is only claimed and translated the first time, claiming it again
+    // would wait on this submission forever
+    cb_command_buffer** claimed     = g_device.submitted_command_buffers;
+    size_t              num_claimed = 0;
     for (size_t i = 0; i < num_cbs; i++)
     {
-        cb_command_buffer* p = melon_map_get(&g_device.command_buffers, command_buffers[i].data);
-        cb_begin_consuming(p);
-
-        cb_command* cmd = cb_pop_command(p);
-        while (cmd)
+        bool duplicate = false;
+        for (size_t j = 0; j < i && !duplicate; j++)
+        {
+            duplicate = command_buffers[j].data == command_buffers[i].data;
+        }
+        if (duplicate)
         {
-            switch (cmd->type)
-            {
-                case MELON_CMD_BIND_VERTEX_BUFFER:
-                {
-                    cb_cmd_bind_vertex_buffer_data* bind_data = (cb_cmd_bind_vertex_buffer_data*) cmd->data;
-                    // TODO
-                    break;
-                }
-                case MELON_CMD_BIND_INDEX_BUFFER:
-                {
-                    melon_buffer_handle* ib = (melon_buffer_handle*) cmd->data;
-                    // TODO
-                    break;
-                }
-                case MELON_CMD_BIND_PIPELINE:
-                {
-                    melon_pipeline_handle* pipeline = (melon_pipeline_handle*) cmd->data;
-                    // TODO
-                    break;
-                }
-                case MELON_CMD_DRAW:
-                {
-                    melon_draw_call_params* params = (melon_draw_call_params*) cmd->data;
-                    // TODO
-                    break;
-                }
-            }
-
-            cmd = cb_pop_command(p);
+            continue;
         }
 
-        cb_end_consuming(p);
+        claimed[num_claimed] = melon_map_get(&g_device.command_buffers, command_buffers[i].data);
+        cb_begin_consuming(claimed[num_claimed]);
+        num_claimed++;
+    }
+
+    if (!g_device.render_thread_running)
+    {
+        execute_command_buffers(claimed, num_claimed);
+        return;
+    }
+
+    render_item* item = begin_render_item(RENDER_ITEM_SUBMIT);
+    memcpy(item->command_buffers, claimed, sizeof(cb_command_buffer*) * num_claimed);
+    item->num_cbs = num_claimed;
+    end_render_item(item);
+}
+
+// Swaps after everything submitted so far, without waiting for it
+void melon_gfx_backend_present(melon_window* window)
+{
+    if (!g_device.render_thread_running)
+    {
+        melon_window_backend_swap_buffers(window);
+        return;
+    }
+
+    render_item* item = begin_render_item(RENDER_ITEM_PRESENT);
+    item->window      = window;
+    end_render_item(item);
+}
+
+static void sync_context(void* data) {}
+
+void melon_gfx_backend_sync_context()
+{
+    // The render thread picks the render context up before running any item
+    if (g_device.render_thread_running)
+    {
+        run_gl(sync_context, NULL);
     }
 }
 
-#endif
\ No newline at end of file
+MELON_GFX_WAIT_IDLE(melon_gfx_wait_idle)
+{
+    if (g_device.render_thread_running)
+    {
+        mtx_lock(&g_device.render_lock);
+        uint64_t ticket = g_device.render_items_queued;
+        mtx_unlock(&g_device.render_lock);
+        wait_for_render_items(ticket);
+    }
+}
+
+MELON_GFX_GET_RENDER_THREAD_STATS(melon_get_render_thread_stats)
+{
+    melon_render_thread_stats stats = { 0 };
+    if (g_device.render_thread_running)
+    {
+        mtx_lock(&g_device.render_lock);
+        stats        = g_device.render_stats;
+        stats.queued = (size_t) (g_device.render_items_queued - g_device.render_items_done);
+        mtx_unlock(&g_device.render_lock);
+    }
+    return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Device functions that touch GL, run on the render thread when there is one
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    const void*      params;
+    size_t           count;
+    melon_gfx_handle handle;
+} gl_call;
+
+static void call_create_shader(void* data)
+{
+    gl_call* call = (gl_call*) data;
+    call->handle  = gl_create_shader((const melon_shader_params*) call->params).data;
+}
+
+static void call_delete_shader(void* data) { gl_delete_shader((melon_shader_handle){ ((gl_call*) data)->handle }); }
+
+static void call_create_buffer(void* data)
+{
+    gl_call* call = (gl_call*) data;
+    call->handle  = gl_create_buffer((const melon_buffer_params*) call->params).data;
+}
+
+static void call_delete_buffer(void* data) { gl_delete_buffer((melon_buffer_handle){ ((gl_call*) data)->handle }); }
+
+static void call_create_buffer_range(void* data)
+{
+    gl_call* call = (gl_call*) data;
+    call->handle  = gl_create_buffer_range((const melon_buffer_params*) call->params).data;
+}
+
+static void call_delete_buffer_range(void* data)
+{
+    gl_delete_buffer_range((melon_buffer_range_handle){ ((gl_call*) data)->handle });
+}
+
+static void call_create_pipeline(void* data)
+{
+    gl_call* call = (gl_call*) data;
+    call->handle  = gl_create_pipeline((const melon_pipeline_params*) call->params).data;
+}
+
+static void call_delete_pipeline(void* data)
+{
+    gl_delete_pipeline((melon_pipeline_handle){ ((gl_call*) data)->handle });
+}
+
+static void call_execute_draw_groups(void* data)
+{
+    gl_call* call = (gl_call*) data;
+    gl_execute_draw_groups((melon_draw_group*) call->params, call->count);
+}
+
+MELON_GFX_CREATE_SHADER(melon_create_shader)
+{
+    gl_call call = { shader_create_info };
+    run_gl(call_create_shader, &call);
+    return (melon_shader_handle){ call.handle };
+}
+
+MELON_GFX_DELETE_SHADER(melon_delete_shader)
+{
+    gl_call call = { NULL, 0, shader.data };
+    run_gl(call_delete_shader, &call);
+}
+
+MELON_GFX_CREATE_BUFFER(melon_create_buffer)
+{
+    gl_call call = { buffer_create_info };
+    run_gl(call_create_buffer, &call);
+    return (melon_buffer_handle){ call.handle };
+}
+
+MELON_GFX_DELETE_BUFFER(melon_delete_buffer)
+{
+    gl_call call = { NULL, 0, buffer.data };
+    run_gl(call_delete_buffer, &call);
+}
+
+MELON_GFX_CREATE_BUFFER_RANGE(melon_create_buffer_range)
+{
+    gl_call call = { buffer_create_info };
+    run_gl(call_create_buffer_range, &call);
+    return (melon_buffer_range_handle){ call.handle };
+}
+
+MELON_GFX_DELETE_BUFFER_RANGE(melon_delete_buffer_range)
+{
+    gl_call call = { NULL, 0, range.data };
+    run_gl(call_delete_buffer_range, &call);
+}
+
+MELON_GFX_CREATE_PIPELINE(melon_create_pipeline)
+{
+    gl_call call = { pipeline_create_info };
+    run_gl(call_create_pipeline, &call);
+    return (melon_pipeline_handle){ call.handle };
+}
+
+MELON_GFX_DELETE_PIPELINE(melon_delete_pipeline)
+{
+    gl_call call = { NULL, 0, pipeline.data };
+    run_gl(call_delete_pipeline, &call);
+}
+
+MELON_GFX_EXECUTE_DRAW_GROUPS(melon_execute_draw_groups)
+{
+    gl_call call = { melon_draw_groups, num_melon_draw_groups };
+    run_gl(call_execute_draw_groups, &call);
+}
+
+#endif
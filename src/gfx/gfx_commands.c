@@ -1,81 +1,114 @@
+#include <melon/core/atomic.h>
 #include <melon/core/memory.h>
+#include <tinycthread.h>
 
 #include "gfx_commands.h"
 
 void cb_create(const melon_allocator_api* alloc, cb_command_buffer* cb, size_t block_size)
 {
-    cb->recording = false;
-    cb->consuming = false;
-    mtx_init(&cb->mtx, mtx_plain);
+    cb->state = CB_STATE_IDLE;
 
     cb->memory = melon_create_arena(block_size, MELON_DEFAULT_ALIGN, alloc);
 
-    cb->last = NULL;
+    cb->first        = NULL;
+    cb->last         = NULL;
+    cb->num_commands = 0;
 }
 
-void cb_destroy(cb_command_buffer* cb)
+void cb_destroy(cb_command_buffer* cb) { melon_destroy_arena(&cb->memory); }
+
+// Waits until the buffer can be moved from one of the from states to the to state
+static void wait_for_state(cb_command_buffer* cb, cb_state from_a, cb_state from_b, cb_state to)
 {
-    mtx_destroy(&cb->mtx);
+    while (!melon_atomic_cas_u32(&cb->state, from_a, to) && !melon_atomic_cas_u32(&cb->state, from_b, to))
+    {
+        thrd_yield();
+    }
+}
 
-    melon_destroy_arena(&cb->memory);
+static void clear_commands(cb_command_buffer* cb)
+{
+    melon_arena_reset(&cb->memory);
+    cb->first        = NULL;
+    cb->last         = NULL;
+    cb->num_commands = 0;
 }
 
 void cb_begin_recording(cb_command_buffer* cb)
 {
-    // Attempt to pass submission fence, ie: do not begin recording until submission involving this command
-    // buffer is completed
-    mtx_lock(&cb->mtx);
-    cb->recording = true;
+    // Do not begin recording until submission involving this command buffer is completed. Recording again before
+    // submitting appends to the commands that are already there
+    wait_for_state(cb, CB_STATE_IDLE, CB_STATE_RECORDED, CB_STATE_RECORDING);
 }
 
 void cb_end_recording(cb_command_buffer* cb)
 {
-    // Block any operations until submission is complete
-    cb->recording = false;
-    mtx_unlock(&cb->mtx);
+    MELON_ASSERT(melon_atomic_load_u32(&cb->state) == CB_STATE_RECORDING,
+                 "melon_end_recording() called without melon_begin_recording()!");
+
+    // Publishes the recorded commands to the thread that consumes them
+    melon_atomic_store_u32(&cb->state, CB_STATE_RECORDED);
 }
 
 void* cb_push_command(cb_command_buffer* cb, size_t size, size_t align, cb_command_type type)
 {
-    MELON_ASSERT(!cb->recording, "Don't push commands outside of melon_begin_recording() and melon_end_recording() calls!");
+    MELON_ASSERT(melon_atomic_load_u32(&cb->state) == CB_STATE_RECORDING,
+                 "Don't push commands outside of melon_begin_recording() and melon_end_recording() calls!");
 
-    cb_command* cmd = MELON_ARENA_PUSH_STRUCT(cb->memory, cb_command);
-    cmd->type       = type;
-    cmd->data       = MELON_ARENA_PUSH(cb->memory, size, align);
-    cmd->next       = NULL;
+    // The command and its data share a single push
+    align              = align > sizeof(void*) ? align : sizeof(void*);
+    size_t      offset = melon_aligned_size(NULL, sizeof(cb_command), align);
+    cb_command* cmd    = (cb_command*) MELON_ARENA_PUSH(cb->memory, offset + size, align);
+    cmd->type          = type;
+    cmd->data          = (uint8_t*) cmd + offset;
+    cmd->next          = NULL;
 
     if (cb->last)
         cb->last->next = cmd;
+    else
+        cb->first = cmd;
     cb->last = cmd;
+    cb->num_commands++;
 
     return cmd->data;
 }
 
 void cb_reset(cb_command_buffer* cb)
 {
-    mtx_lock(&cb->mtx);
-
-    // Reset command buffer
-    melon_arena_reset(&cb->memory);
-
-    mtx_unlock(&cb->mtx);
+    // Discard recorded commands that were not submitted
+    wait_for_state(cb, CB_STATE_IDLE, CB_STATE_RECORDED, CB_STATE_CONSUMING);
+    clear_commands(cb);
+    melon_atomic_store_u32(&cb->state, CB_STATE_IDLE);
 }
 
 void cb_begin_consuming(cb_command_buffer* cb)
 {
-    mtx_lock(&cb->mtx);
-    cb->consuming = true;
+    // Empty buffers can be submitted as well
+    wait_for_state(cb, CB_STATE_RECORDED, CB_STATE_IDLE, CB_STATE_CONSUMING);
 }
 
 void cb_end_consuming(cb_command_buffer* cb)
 {
-    cb->consuming = false;
-    mtx_unlock(&cb->mtx);
+    MELON_ASSERT(melon_atomic_load_u32(&cb->state) == CB_STATE_CONSUMING,
+                 "melon_end_consuming() called without melon_begin_consuming()!");
+
+    clear_commands(cb);
+    melon_atomic_store_u32(&cb->state, CB_STATE_IDLE);
+}
+
+void cb_wait_consumed(cb_command_buffer* cb)
+{
+    // A submission claims its command buffers up front, wait until it has translated this one
+    while (melon_atomic_load_u32(&cb->state) == CB_STATE_CONSUMING)
+    {
+        thrd_yield();
+    }
 }
 
 cb_command* cb_pop_command(cb_command_buffer* cb)
 {
-    MELON_ASSERT(!cb->consuming, "Don't pop commands outside of melon_begin_consuming() and melon_end_consuming() calls!");
+    MELON_ASSERT(melon_atomic_load_u32(&cb->state) == CB_STATE_CONSUMING,
+                 "Don't pop commands outside of melon_begin_consuming() and melon_end_consuming() calls!");
 
     cb_command* result = cb->first;
 
@@ -85,18 +118,23 @@ cb_command* cb_pop_command(cb_command_buffer* cb)
     return result;
 }
 
-void cb_cmd_bind_vertex_buffer(cb_command_buffer* cb, melon_buffer_handle buffer, size_t binding)
+void cb_cmd_bind_vertex_buffer(cb_command_buffer* cb, melon_buffer_handle buffer, size_t binding, size_t offset)
 {
     cb_cmd_bind_vertex_buffer_data* bind_data = (cb_cmd_bind_vertex_buffer_data*) cb_push_command(
         cb, sizeof(cb_cmd_bind_vertex_buffer_data), MELON_DEFAULT_ALIGN, MELON_CMD_BIND_VERTEX_BUFFER);
+    bind_data->buffer  = buffer;
     bind_data->binding = binding;
+    bind_data->offset  = offset;
 }
 
-void cb_cmd_bind_index_buffer(cb_command_buffer* cb, melon_buffer_handle buffer)
+void cb_cmd_bind_index_buffer(cb_command_buffer* cb, melon_buffer_handle buffer, melon_vertex_data_type type,
+                              size_t offset)
 {
-    melon_buffer_handle* ib_buffer = (melon_buffer_handle*) cb_push_command(
-        cb, sizeof(melon_buffer_handle), MELON_DEFAULT_ALIGN, MELON_CMD_BIND_INDEX_BUFFER);
-    *ib_buffer = buffer;
+    cb_cmd_bind_index_buffer_data* bind_data = (cb_cmd_bind_index_buffer_data*) cb_push_command(
+        cb, sizeof(cb_cmd_bind_index_buffer_data), MELON_DEFAULT_ALIGN, MELON_CMD_BIND_INDEX_BUFFER);
+    bind_data->buffer = buffer;
+    bind_data->type   = type;
+    bind_data->offset = offset;
 }
 
 void cb_cmd_bind_pipeline(cb_command_buffer* cb, melon_pipeline_handle pipeline)
@@ -111,4 +149,104 @@ void cb_cmd_draw(cb_command_buffer* cb, const melon_draw_call_params* params)
     melon_draw_call_params* dc = (melon_draw_call_params*) cb_push_command(cb, sizeof(melon_draw_call_params),
                                                                        MELON_DEFAULT_ALIGN, MELON_CMD_DRAW);
     *dc                      = *params;
-}
\ No newline at end of file
+}
+
+void cb_cmd_clear(cb_command_buffer* cb, const float color[4])
+{
+    cb_cmd_clear_data* clear_data = (cb_cmd_clear_data*) cb_push_command(cb, sizeof(cb_cmd_clear_data),
+                                                                         MELON_DEFAULT_ALIGN, MELON_CMD_CLEAR);
+    for (size_t i = 0; i < 4; i++)
+        clear_data->color[i] = color[i];
+}
+
+static void translate_draw(const melon_draw_state* requested, melon_draw_state* bound, const cb_backend* backend,
+                           const melon_draw_call_params* params)
+{
+    if (requested->pipeline.data != bound->pipeline.data)
+    {
+        backend->bind_pipeline(backend->user_data, requested->pipeline, bound->pipeline);
+        bound->pipeline = requested->pipeline;
+        for (size_t binding = 0; binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS; binding++)
+        {
+            bound->resources.buffers[binding].data   = melon_gfx_invalid_handle;
+            bound->resources.buffer_offsets[binding] = 0;
+        }
+    }
+
+    for (size_t binding = 0; binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS; binding++)
+    {
+        melon_buffer_handle buffer = requested->resources.buffers[binding];
+        size_t              offset = requested->resources.buffer_offsets[binding];
+        if (buffer.data != bound->resources.buffers[binding].data
+            || offset != bound->resources.buffer_offsets[binding])
+        {
+            backend->bind_vertex_buffer(backend->user_data, binding, buffer, offset);
+            bound->resources.buffers[binding]        = buffer;
+            bound->resources.buffer_offsets[binding] = offset;
+        }
+    }
+
+    // The index offset and type are passed to the draw, only a different buffer needs a bind. A buffer that stops
+    // being requested stays bound, so it is still known to be bound when it is requested again
+    melon_buffer_handle index_buffer = requested->resources.index_buffer;
+    if (MELON_GFX_HANDLE_IS_VALID(index_buffer) && index_buffer.data != bound->resources.index_buffer.data)
+    {
+        backend->bind_index_buffer(backend->user_data, index_buffer);
+        bound->resources.index_buffer = index_buffer;
+    }
+
+    backend->draw(backend->user_data, params, &requested->resources);
+}
+
+void cb_translate(cb_command_buffer** cbs, size_t num_cbs, const melon_draw_state* empty, melon_draw_state* bound,
+                  const cb_backend* backend)
+{
+    for (size_t i = 0; i < num_cbs; i++)
+    {
+        melon_draw_state requested = *empty;
+
+        cb_command* cmd = cb_pop_command(cbs[i]);
+        while (cmd)
+        {
+            switch (cmd->type)
+            {
+                case MELON_CMD_BIND_VERTEX_BUFFER:
+                {
+                    cb_cmd_bind_vertex_buffer_data* bind_data = (cb_cmd_bind_vertex_buffer_data*) cmd->data;
+                    MELON_ASSERT(bind_data->binding < MELON_GFX_MAX_BUFFER_ATTACHMENTS,
+                                 "Vertex buffer binding %zu is out of range\n", bind_data->binding);
+                    requested.resources.buffers[bind_data->binding]        = bind_data->buffer;
+                    requested.resources.buffer_offsets[bind_data->binding] = bind_data->offset;
+                    break;
+                }
+                case MELON_CMD_BIND_INDEX_BUFFER:
+                {
+                    cb_cmd_bind_index_buffer_data* bind_data = (cb_cmd_bind_index_buffer_data*) cmd->data;
+                    requested.resources.index_buffer         = bind_data->buffer;
+                    requested.resources.index_buffer_offset  = bind_data->offset;
+                    requested.resources.index_type           = bind_data->type;
+                    break;
+                }
+                case MELON_CMD_BIND_PIPELINE:
+                {
+                    requested.pipeline = *(melon_pipeline_handle*) cmd->data;
+                    break;
+                }
+                case MELON_CMD_DRAW:
+                {
+                    translate_draw(&requested, bound, backend, (melon_draw_call_params*) cmd->data);
+                    break;
+                }
+                case MELON_CMD_CLEAR:
+                {
+                    backend->clear(backend->user_data, ((cb_cmd_clear_data*) cmd->data)->color);
+                    break;
+                }
+            }
+
+            cmd = cb_pop_command(cbs[i]);
+        }
+
+        cb_end_consuming(cbs[i]);
+    }
+}
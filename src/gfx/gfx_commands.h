@@ -5,25 +5,41 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 // COMMAND BUFFER
-// - NOT completely thread safe. Recording is intended to be done on one thread
-//   at a time
-// - Recording is blocked by consuming and vice versa, meaning you can call
-//   submit on a consumer thread and begin recording on a recording thread, it's
-//   just that they will not happen at the same time.
+// - Each command buffer is recorded by one thread at a time, with no locking
+//   on the push path. Different threads record into different command buffers
+//   at the same time, each into its own arena.
+// - Recording and consuming hand the buffer over through its state: beginning
+//   to record waits until a submission involving the buffer is done, and
+//   beginning to consume waits until recording has ended.
+// - Consuming a command buffer empties it.
 ////////////////////////////////////////////////////////////////////////////////
 
 typedef struct
 {
     melon_buffer_handle buffer;
-    size_t            binding;
+    size_t              binding;
+    size_t              offset;
 } cb_cmd_bind_vertex_buffer_data;
 
+typedef struct
+{
+    melon_buffer_handle    buffer;
+    melon_vertex_data_type type;
+    size_t                 offset;
+} cb_cmd_bind_index_buffer_data;
+
+typedef struct
+{
+    float color[4];
+} cb_cmd_clear_data;
+
 typedef enum
 {
     MELON_CMD_BIND_VERTEX_BUFFER,
     MELON_CMD_BIND_INDEX_BUFFER,
     MELON_CMD_BIND_PIPELINE,
-    MELON_CMD_DRAW
+    MELON_CMD_DRAW,
+    MELON_CMD_CLEAR
 } cb_command_type;
 
 typedef struct cb_command
@@ -34,15 +50,22 @@ typedef struct cb_command
     struct cb_command* next;
 } cb_command;
 
+typedef enum
+{
+    CB_STATE_IDLE,
+    CB_STATE_RECORDING,
+    CB_STATE_RECORDED,
+    CB_STATE_CONSUMING
+} cb_state;
+
 typedef struct
 {
     melon_memory_arena    memory;
     melon_draw_resources  current_resources;
     melon_pipeline_handle current_pipeline;
 
-    bool  consuming;
-    bool  recording;
-    mtx_t mtx;
+    // cb_state, changed atomically when the buffer is handed between threads
+    volatile uint32_t state;
 
     cb_command* first;
     cb_command* last;
@@ -63,11 +86,44 @@ void*       cb_push_command(cb_command_buffer* cb, size_t size, size_t align, cb
 void        cb_reset(cb_command_buffer* cb);
 void        cb_begin_consuming(cb_command_buffer* cb);
 void        cb_end_consuming(cb_command_buffer* cb);
+void        cb_wait_consumed(cb_command_buffer* cb);
 cb_command* cb_pop_command(cb_command_buffer* cb);
 
-void cb_cmd_bind_vertex_buffer(cb_command_buffer* cb, melon_buffer_handle buffer, size_t binding);
-void cb_cmd_bind_index_buffer(cb_command_buffer* cb, melon_buffer_handle buffer);
+void cb_cmd_bind_vertex_buffer(cb_command_buffer* cb, melon_buffer_handle buffer, size_t binding, size_t offset);
+void cb_cmd_bind_index_buffer(cb_command_buffer* cb, melon_buffer_handle buffer, melon_vertex_data_type type,
+                              size_t offset);
 void cb_cmd_bind_pipeline(cb_command_buffer* cb, melon_pipeline_handle pipeline);
 void cb_cmd_draw(cb_command_buffer* cb, const melon_draw_call_params* params);
+void cb_cmd_clear(cb_command_buffer* cb, const float color[4]);
+
+////////////////////////////////////////////////////////////////////////////////
+// TRANSLATION
+// - Bind commands only change the requested state. A draw hands the backend
+//   just the changes between the requested state and what it has bound, so
+//   replaying redundant binds costs nothing.
+////////////////////////////////////////////////////////////////////////////////
+
+/* cb_backend - Calls the translation makes to bring the backend in line with the requested state
+ *
+ * bind_pipeline - previous is the pipeline that was bound before. Every vertex binding is passed to
+ *                 bind_vertex_buffer again before the next draw, since the new pipeline's layout may differ
+ */
+typedef struct
+{
+    void (*bind_pipeline)(void* user_data, melon_pipeline_handle pipeline, melon_pipeline_handle previous);
+    void (*bind_vertex_buffer)(void* user_data, size_t binding, melon_buffer_handle buffer, size_t offset);
+    void (*bind_index_buffer)(void* user_data, melon_buffer_handle buffer);
+    void (*draw)(void* user_data, const melon_draw_call_params* params, const melon_draw_resources* resources);
+    void (*clear)(void* user_data, const float color[4]);
+    void* user_data;
+} cb_backend;
+
+/**
+ * Replays command buffers that were claimed with cb_begin_consuming() through backend, in order, and ends consuming
+ * them. Each command buffer starts out requesting empty, while bound carries what the backend has bound from one
+ * command buffer to the next.
+ */
+void cb_translate(cb_command_buffer** cbs, size_t num_cbs, const melon_draw_state* empty, melon_draw_state* bound,
+                  const cb_backend* backend);
 
 #endif
\ No newline at end of file
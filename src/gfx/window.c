@@ -1,5 +1,6 @@
 #include <melon/gfx/window.h>
 #include <melon/core/memory.h>
+#include <melon/core/memory_tracking.h>
 
 static struct
 {
@@ -9,7 +10,8 @@ static struct
     size_t capacity;
 } input_queue;
 
-static melon_input_params config;
+static melon_input_params       config;
+static melon_tracking_allocator input_memory;
 
 const melon_input_params* melon_default_input_params()
 {
@@ -37,6 +39,9 @@ bool melon_input_init(const melon_input_params* in_config)
         config = *in_config;
     }
 
+    melon_create_tracking_allocator(&input_memory, "input queue", &config.allocator);
+    config.allocator = melon_tracking_allocator_api(&input_memory);
+
     input_queue.event_buffer = MELON_ALLOC(
         config.allocator, sizeof(melon_input_event) * (config.input_buffer_capacity + 1), MELON_DEFAULT_ALIGN);
     
@@ -55,6 +60,7 @@ bool melon_input_init(const melon_input_params* in_config)
 void melon_input_destroy() 
 {
     MELON_FREE(config.allocator, input_queue.event_buffer);
+    melon_destroy_tracking_allocator(&input_memory);
 }
 
 bool melon_push_input_event(const melon_input_event* input_event)
@@ -6,6 +6,18 @@
 bool melon_window_backend_init();
 void melon_window_backend_destroy();
 
+// Context that rendering targets: the headless one until the first window is created, then that window's
+void* melon_window_backend_render_context();
+// Makes context current on the calling thread, NULL releases the current one
+void melon_window_backend_make_current(void* context);
+// Swaps on the calling thread, called by the gfx backend on the thread that owns the render context
+void melon_window_backend_swap_buffers(melon_window* window);
+
+// Implemented by the gfx backend. Present queues the swap behind the submitted work. Sync returns once the thread
+// that owns the GL context has run everything queued so far and switched to melon_window_backend_render_context()
+void melon_gfx_backend_present(melon_window* window);
+void melon_gfx_backend_sync_context();
+
 bool melon_input_init(const melon_input_params* config);
 void melon_input_destroy();
 
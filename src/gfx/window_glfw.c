@@ -1,6 +1,7 @@
 #ifdef MELON_USE_GLFW
 
 #include "window_backend.h"
+#include <melon/core/atomic.h>
 #include <melon/core/error.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -21,6 +22,8 @@ static void glfw_cursor_pos_cb(GLFWwindow* window, double x, double y)
 }
 
 static GLFWwindow* g_glfw_headless_window;
+// Read by the render thread, which makes it current before running queued GL work
+static void* volatile g_glfw_render_context;
 
 bool melon_window_backend_init()
 {
@@ -34,6 +37,7 @@ bool melon_window_backend_init()
 #endif
 
     g_glfw_headless_window = glfwCreateWindow(1, 1, "", NULL, NULL);
+    g_glfw_render_context  = g_glfw_headless_window;
     
     glfwMakeContextCurrent(g_glfw_headless_window);
 
@@ -49,20 +53,33 @@ void melon_window_backend_destroy()
     glfwDestroyWindow(g_glfw_headless_window);
 }
 
+void* melon_window_backend_render_context() { return melon_atomic_load_ptr(&g_glfw_render_context); }
+
+void melon_window_backend_make_current(void* context) { glfwMakeContextCurrent((GLFWwindow*) context); }
+
+void melon_window_backend_swap_buffers(melon_window* window) { glfwSwapBuffers((GLFWwindow*) window); }
+
 melon_window* melon_create_window(int width, int height, const char* title) 
 {
     glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
-    GLFWwindow* window = glfwCreateWindow(width, height, title, NULL, NULL);
+    // Shares objects with the headless context, which takes over rendering again once the window is destroyed
+    GLFWwindow* window = glfwCreateWindow(width, height, title, NULL, g_glfw_headless_window);
     MELON_ASSERT(window, "Window creation error");
 
+    // With a render thread no context is current here, it picks the window up before its next GL call
+    if (melon_atomic_load_ptr(&g_glfw_render_context) == g_glfw_headless_window)
+    {
+        melon_atomic_store_ptr(&g_glfw_render_context, window);
+    }
+
     if (g_glfw_headless_window == glfwGetCurrentContext())
     {
         glfwMakeContextCurrent(window);
     }    
 
-    MELON_ASSERT(window == glfwGetCurrentContext());
+    MELON_ASSERT(window == glfwGetCurrentContext() || glfwGetCurrentContext() == NULL);
 
     glfwSetCursorPosCallback(window, glfw_cursor_pos_cb);
 
@@ -71,6 +88,19 @@ melon_window* melon_create_window(int width, int height, const char* title)
 
 void melon_destroy_window(melon_window* window) 
 {
+    // The context can't be current on any thread while its window is destroyed, and queued presents may still
+    // swap it
+    if (melon_atomic_load_ptr(&g_glfw_render_context) == window)
+    {
+        melon_atomic_store_ptr(&g_glfw_render_context, g_glfw_headless_window);
+    }
+    melon_gfx_backend_sync_context();
+
+    if (glfwGetCurrentContext() == (GLFWwindow*) window)
+    {
+        glfwMakeContextCurrent(g_glfw_headless_window);
+    }
+
     glfwDestroyWindow((GLFWwindow*) window);
 }
 
@@ -86,7 +116,7 @@ void melon_poll_input_events()
 
 void melon_swap_buffers(melon_window* window)
 {
-    glfwSwapBuffers((GLFWwindow*) window);
+    melon_gfx_backend_present(window);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,445 @@
+#include <gtest/gtest.h>
+#include <melon/core/memory.h>
+#include <melon/core/error.h>
+
+static size_t count_blocks(const melon_memory_arena* arena)
+{
+    size_t count = 0;
+    for (melon_memory_block* block = arena->current_block; block; block = block->prev)
+        count++;
+    return count;
+}
+
+static bool is_aligned(const void* ptr, size_t align) { return ((uintptr_t) ptr % align) == 0; }
+
+TEST(ArenaTest, push_respects_alignment)
+{
+    melon_memory_arena arena = melon_create_arena(256, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    const size_t alignments[] = { 1, 2, 4, 8, 16, 32, 64 };
+    for (size_t i = 0; i < 64; i++)
+    {
+        size_t align = alignments[i % (sizeof(alignments) / sizeof(alignments[0]))];
+        void*  ptr   = melon_arena_push_size(&arena, i + 1, align);
+        EXPECT_TRUE(is_aligned(ptr, align));
+    }
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaTest, block_overflow_does_not_overlap)
+{
+    melon_memory_arena arena = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    uint8_t* first  = (uint8_t*) melon_arena_push_size(&arena, 48, MELON_DEFAULT_ALIGN);
+    uint8_t* second = (uint8_t*) melon_arena_push_size(&arena, 10, MELON_DEFAULT_ALIGN);
+    uint8_t* third  = (uint8_t*) melon_arena_push_size(&arena, 10, MELON_DEFAULT_ALIGN);
+    memset(first, 1, 48);
+    memset(second, 2, 10);
+    memset(third, 3, 10);
+
+    EXPECT_EQ(2u, count_blocks(&arena));
+    EXPECT_TRUE(third >= second + 10 || third + 10 <= second);
+    for (size_t i = 0; i < 10; i++)
+        EXPECT_EQ(2, second[i]);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaTest, reset_frees_chained_blocks)
+{
+    melon_memory_arena  arena       = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+    melon_memory_block* first_block = arena.current_block;
+
+    for (size_t i = 0; i < 16; i++)
+        melon_arena_push_size(&arena, 100, MELON_DEFAULT_ALIGN);
+    EXPECT_LT(1u, count_blocks(&arena));
+
+    melon_arena_reset(&arena);
+    EXPECT_EQ(first_block, arena.current_block);
+    EXPECT_EQ(1u, count_blocks(&arena));
+    EXPECT_EQ(0u, arena.current_block->offset);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaTempTest, temp_scope_rewinds_offset)
+{
+    melon_memory_arena arena = melon_create_arena(1024, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    melon_arena_push_size(&arena, 32, MELON_DEFAULT_ALIGN);
+    size_t offset = arena.current_block->offset;
+
+    melon_arena_temp temp = melon_arena_begin_temp(&arena);
+    void*            ptr  = melon_arena_push_size(&arena, 128, MELON_DEFAULT_ALIGN);
+    EXPECT_LT(offset, arena.current_block->offset);
+    melon_arena_end_temp(temp);
+
+    EXPECT_EQ(offset, arena.current_block->offset);
+    EXPECT_EQ(0u, arena.temp_count);
+
+    // The same memory is handed out again after the rewind
+    EXPECT_EQ(ptr, melon_arena_push_size(&arena, 128, MELON_DEFAULT_ALIGN));
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaTempTest, nested_scopes_across_block_boundaries)
+{
+    melon_memory_arena  arena       = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+    melon_memory_block* first_block = arena.current_block;
+
+    uint8_t* persistent = (uint8_t*) melon_arena_push_size(&arena, 16, MELON_DEFAULT_ALIGN);
+    memset(persistent, 0xAB, 16);
+    size_t first_offset = arena.current_block->offset;
+
+    melon_arena_temp outer = melon_arena_begin_temp(&arena);
+    {
+        // Overflow into a second block
+        melon_arena_push_size(&arena, 48, MELON_DEFAULT_ALIGN);
+        melon_arena_push_size(&arena, 100, MELON_DEFAULT_ALIGN);
+        EXPECT_EQ(2u, count_blocks(&arena));
+
+        melon_memory_block* second_block  = arena.current_block;
+        size_t              second_offset = second_block->offset;
+
+        melon_arena_temp inner = melon_arena_begin_temp(&arena);
+        {
+            // Overflow into several more blocks
+            for (size_t i = 0; i < 8; i++)
+                melon_arena_push_size(&arena, 512, MELON_DEFAULT_ALIGN);
+            EXPECT_LT(2u, count_blocks(&arena));
+        }
+        melon_arena_end_temp(inner);
+
+        EXPECT_EQ(second_block, arena.current_block);
+        EXPECT_EQ(second_offset, arena.current_block->offset);
+        EXPECT_EQ(2u, count_blocks(&arena));
+    }
+    melon_arena_end_temp(outer);
+
+    EXPECT_EQ(first_block, arena.current_block);
+    EXPECT_EQ(first_offset, arena.current_block->offset);
+    EXPECT_EQ(1u, count_blocks(&arena));
+    EXPECT_EQ(0u, arena.temp_count);
+
+    for (size_t i = 0; i < 16; i++)
+        EXPECT_EQ(0xAB, persistent[i]);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaTempTest, reset_clears_open_scopes)
+{
+    melon_memory_arena arena = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    melon_arena_begin_temp(&arena);
+    melon_arena_begin_temp(&arena);
+    melon_arena_push_size(&arena, 256, MELON_DEFAULT_ALIGN);
+
+    melon_arena_reset(&arena);
+    EXPECT_EQ(0u, arena.temp_count);
+    EXPECT_EQ(1u, count_blocks(&arena));
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(VirtualArenaTest, grows_without_chaining_blocks)
+{
+    melon_memory_arena  arena        = melon_create_virtual_arena(MELON_MEGABYTE(64), MELON_KILOBYTE(4));
+    melon_memory_block* block        = arena.current_block;
+    size_t              initial_size = block->size;
+
+    uint8_t* first = (uint8_t*) melon_arena_push_size(&arena, 64, MELON_DEFAULT_ALIGN);
+    uint8_t* prev  = first;
+    for (size_t i = 0; i < 1024; i++)
+    {
+        uint8_t* ptr = (uint8_t*) melon_arena_push_size(&arena, MELON_KILOBYTE(4), MELON_DEFAULT_ALIGN);
+        ASSERT_NE(nullptr, ptr);
+        memset(ptr, (int) i, MELON_KILOBYTE(4));
+
+        // Every allocation follows the previous one in the same region
+        EXPECT_LT(prev, ptr);
+        prev = ptr;
+    }
+
+    EXPECT_EQ(block, arena.current_block);
+    EXPECT_EQ(nullptr, arena.current_block->prev);
+    EXPECT_LT(initial_size, arena.current_block->size);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(VirtualArenaTest, push_past_reservation_fails)
+{
+    melon_memory_arena arena = melon_create_virtual_arena(MELON_MEGABYTE(1), MELON_KILOBYTE(4));
+
+    EXPECT_NE(nullptr, melon_arena_push_size(&arena, MELON_KILOBYTE(512), MELON_DEFAULT_ALIGN));
+    EXPECT_EQ(nullptr, melon_arena_push_size(&arena, MELON_MEGABYTE(1), MELON_DEFAULT_ALIGN));
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(VirtualArenaTest, failed_realloc_keeps_allocation)
+{
+    melon_memory_arena arena = melon_create_virtual_arena(MELON_MEGABYTE(1), MELON_KILOBYTE(4));
+
+    // Misaligned for the realloc below, so it can't grow in place and has to push a copy
+    melon_arena_push_size(&arena, 8, 8);
+    uint8_t* ptr = (uint8_t*) melon_arena_push_size(&arena, 256, 8);
+    memset(ptr, 0xab, 256);
+    size_t offset = arena.current_block->offset;
+
+    EXPECT_EQ(nullptr, melon_arena_realloc(&arena, ptr, 256, MELON_MEGABYTE(2), 256));
+    EXPECT_EQ(offset, arena.current_block->offset);
+    for (size_t i = 0; i < 256; i++)
+        ASSERT_EQ(0xab, ptr[i]);
+
+    // Pushes still land after the allocation
+    uint8_t* next = (uint8_t*) melon_arena_push_size(&arena, 64, 8);
+    EXPECT_LE(ptr + 256, next);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(VirtualArenaTest, failed_reservation_leaves_arena_empty)
+{
+    // Larger than any address space the arena can run in
+    melon_memory_arena arena = melon_create_virtual_arena((size_t) 1 << 62, MELON_KILOBYTE(4));
+
+    EXPECT_EQ(nullptr, arena.current_block);
+    EXPECT_EQ(nullptr, melon_arena_push_size(&arena, 64, MELON_DEFAULT_ALIGN));
+    EXPECT_EQ(nullptr, melon_arena_realloc(&arena, nullptr, 0, 64, MELON_DEFAULT_ALIGN));
+
+    uint8_t outside[64];
+    EXPECT_EQ(nullptr, melon_arena_realloc(&arena, outside, sizeof(outside), 128, MELON_DEFAULT_ALIGN));
+    EXPECT_FALSE(melon_arena_pop(&arena, outside, sizeof(outside)));
+
+    melon_arena_temp temp = melon_arena_begin_temp(&arena);
+    EXPECT_EQ(nullptr, temp.block);
+    EXPECT_EQ(nullptr, melon_arena_push_size(&arena, 64, MELON_DEFAULT_ALIGN));
+    melon_arena_end_temp(temp);
+    EXPECT_EQ(0u, arena.temp_count);
+
+    melon_arena_reset(&arena);
+    melon_arena_reset_to_watermark(&arena, MELON_KILOBYTE(4));
+    EXPECT_EQ(nullptr, arena.current_block);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(VirtualArenaTest, reset_to_watermark_decommits)
+{
+    melon_memory_arena arena = melon_create_virtual_arena(MELON_MEGABYTE(64), MELON_KILOBYTE(4));
+
+    uint8_t* ptr = (uint8_t*) melon_arena_push_size(&arena, MELON_MEGABYTE(8), MELON_DEFAULT_ALIGN);
+    memset(ptr, 0xFF, MELON_MEGABYTE(8));
+    EXPECT_LE((size_t) MELON_MEGABYTE(8), arena.current_block->size);
+
+    melon_arena_reset_to_watermark(&arena, MELON_KILOBYTE(64));
+    EXPECT_EQ(0u, arena.current_block->offset);
+    EXPECT_GT((size_t) MELON_KILOBYTE(128), arena.current_block->size);
+
+    // Pages committed again after a decommit are usable and start zeroed
+    uint8_t* again = (uint8_t*) melon_arena_push_size(&arena, MELON_MEGABYTE(8), MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(ptr, again);
+    EXPECT_EQ(0, again[MELON_MEGABYTE(4)]);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(VirtualArenaTest, temp_scopes_rewind)
+{
+    melon_memory_arena arena = melon_create_virtual_arena(MELON_MEGABYTE(16), MELON_KILOBYTE(4));
+
+    melon_arena_push_size(&arena, 32, MELON_DEFAULT_ALIGN);
+    size_t offset = arena.current_block->offset;
+
+    melon_arena_temp temp = melon_arena_begin_temp(&arena);
+    melon_arena_push_size(&arena, MELON_MEGABYTE(2), MELON_DEFAULT_ALIGN);
+    melon_arena_end_temp(temp);
+
+    EXPECT_EQ(offset, arena.current_block->offset);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaBlockCacheTest, reset_recycles_blocks)
+{
+    melon_memory_arena arena = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    for (size_t i = 0; i < 4; i++)
+        melon_arena_push_size(&arena, 48, MELON_DEFAULT_ALIGN);
+    size_t misses = arena.block_cache.misses;
+    EXPECT_LT(0u, misses);
+    EXPECT_EQ(0u, arena.block_cache.hits);
+
+    // The next frame overflows in the same way and is served entirely from the cache
+    for (size_t frame = 0; frame < 8; frame++)
+    {
+        melon_arena_reset(&arena);
+        EXPECT_EQ(misses, arena.block_cache.count);
+
+        for (size_t i = 0; i < 4; i++)
+            melon_arena_push_size(&arena, 48, MELON_DEFAULT_ALIGN);
+    }
+
+    EXPECT_EQ(misses, arena.block_cache.misses);
+    EXPECT_EQ(misses * 8, arena.block_cache.hits);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaBlockCacheTest, cache_is_bounded)
+{
+    melon_memory_arena arena   = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+    arena.block_cache.capacity = 2;
+
+    for (size_t i = 0; i < 16; i++)
+        melon_arena_push_size(&arena, 60, MELON_DEFAULT_ALIGN);
+    EXPECT_LT(2u, count_blocks(&arena) - 1);
+
+    melon_arena_reset(&arena);
+    EXPECT_EQ(2u, arena.block_cache.count);
+
+    melon_arena_trim_block_cache(&arena);
+    EXPECT_EQ(0u, arena.block_cache.count);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaBlockCacheTest, cached_blocks_fit_request)
+{
+    melon_memory_arena arena = melon_create_arena(64, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    melon_arena_temp temp = melon_arena_begin_temp(&arena);
+    melon_arena_push_size(&arena, 100, MELON_DEFAULT_ALIGN);
+    melon_arena_end_temp(temp);
+    EXPECT_EQ(1u, arena.block_cache.count);
+
+    // The cached block is too small for this push, so a new block is allocated
+    uint8_t* ptr = (uint8_t*) melon_arena_push_size(&arena, MELON_KILOBYTE(8), 64);
+    EXPECT_EQ(0u, (uintptr_t) ptr % 64);
+    EXPECT_EQ(0u, arena.block_cache.hits);
+    EXPECT_EQ(2u, arena.block_cache.misses);
+    memset(ptr, 0, MELON_KILOBYTE(8));
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaReallocTest, top_allocation_grows_in_place)
+{
+    melon_memory_arena arena = melon_create_arena(1024, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    melon_arena_push_size(&arena, 10, 1);
+    uint32_t* values = MELON_ARENA_PUSH_ARRAY(arena, uint32_t, 4, 4);
+    for (uint32_t i = 0; i < 4; i++)
+        values[i] = i;
+
+    uint32_t* grown = (uint32_t*) melon_arena_realloc(&arena, values, 4 * sizeof(uint32_t), 64 * sizeof(uint32_t), 4);
+    EXPECT_EQ(values, grown);
+    EXPECT_EQ((size_t) ((uint8_t*) (grown + 64) - arena.current_block->start), arena.current_block->offset);
+
+    // Shrinking the top gives the space back
+    grown = (uint32_t*) melon_arena_realloc(&arena, grown, 64 * sizeof(uint32_t), 8 * sizeof(uint32_t), 4);
+    EXPECT_EQ(values, grown);
+    EXPECT_EQ((size_t) ((uint8_t*) (grown + 8) - arena.current_block->start), arena.current_block->offset);
+    for (uint32_t i = 0; i < 4; i++)
+        EXPECT_EQ(i, grown[i]);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaReallocTest, buried_allocation_is_copied)
+{
+    melon_memory_arena arena = melon_create_arena(1024, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    uint8_t* first = (uint8_t*) melon_arena_push_size(&arena, 16, 1);
+    memset(first, 7, 16);
+    uint8_t* second = (uint8_t*) melon_arena_push_size(&arena, 16, 1);
+
+    uint8_t* moved = (uint8_t*) melon_arena_realloc(&arena, first, 16, 32, 1);
+    EXPECT_NE(first, moved);
+    EXPECT_LE(second + 16, moved);
+    for (size_t i = 0; i < 16; i++)
+        EXPECT_EQ(7, moved[i]);
+
+    // Shrinking a buried allocation keeps it where it is
+    EXPECT_EQ(second, melon_arena_realloc(&arena, second, 16, 8, 1));
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaReallocTest, shrink_with_larger_align_moves)
+{
+    melon_memory_arena arena = melon_create_arena(1024, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    // Put the top allocation one byte past a 64 byte boundary
+    uint8_t* base = (uint8_t*) melon_arena_push_size(&arena, 1, 64);
+    uint8_t* top  = (uint8_t*) melon_arena_push_size(&arena, 32, 1);
+    EXPECT_EQ(base + 1, top);
+    for (uint8_t i = 0; i < 32; i++)
+        top[i] = i;
+
+    uint8_t* shrunk = (uint8_t*) melon_arena_realloc(&arena, top, 32, 16, 64);
+    EXPECT_EQ(0u, (uintptr_t) shrunk % 64);
+    for (uint8_t i = 0; i < 16; i++)
+        EXPECT_EQ(i, shrunk[i]);
+
+    // Same for an allocation that isn't on top
+    uint8_t* buried = (uint8_t*) melon_arena_push_size(&arena, 8, 1);
+    melon_arena_push_size(&arena, 8, 1);
+    EXPECT_NE(0u, (uintptr_t) buried % 64);
+    EXPECT_EQ(0u, (uintptr_t) melon_arena_realloc(&arena, buried, 8, 4, 64) % 64);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaReallocTest, top_allocation_moves_to_new_block_when_full)
+{
+    melon_memory_arena arena = melon_create_arena(128, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    uint8_t* data = (uint8_t*) melon_arena_push_size(&arena, 100, MELON_DEFAULT_ALIGN);
+    for (size_t i = 0; i < 100; i++)
+        data[i] = (uint8_t) i;
+    melon_memory_block* first_block = arena.current_block;
+
+    uint8_t* grown = (uint8_t*) melon_arena_realloc(&arena, data, 100, 1000, MELON_DEFAULT_ALIGN);
+    EXPECT_NE(first_block, arena.current_block);
+    EXPECT_EQ(0u, first_block->offset);
+    for (size_t i = 0; i < 100; i++)
+        EXPECT_EQ((uint8_t) i, grown[i]);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaReallocTest, virtual_arena_grows_in_place)
+{
+    melon_memory_arena arena = melon_create_virtual_arena(MELON_MEGABYTE(16), MELON_KILOBYTE(4));
+
+    uint8_t* data = (uint8_t*) melon_arena_push_size(&arena, 64, MELON_DEFAULT_ALIGN);
+    memset(data, 3, 64);
+    uint8_t* grown = (uint8_t*) melon_arena_realloc(&arena, data, 64, MELON_MEGABYTE(1), MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(data, grown);
+    memset(grown + 64, 0, MELON_MEGABYTE(1) - 64);
+    EXPECT_EQ(3, grown[63]);
+
+    melon_destroy_arena(&arena);
+}
+
+TEST(ArenaPopTest, pop_releases_only_the_top)
+{
+    melon_memory_arena arena = melon_create_arena(1024, MELON_DEFAULT_ALIGN, melon_default_cb_allocator());
+
+    void* a = melon_arena_push_size(&arena, 32, MELON_DEFAULT_ALIGN);
+    void* b = melon_arena_push_size(&arena, 32, MELON_DEFAULT_ALIGN);
+
+    EXPECT_FALSE(melon_arena_pop(&arena, a, 32));
+    EXPECT_TRUE(melon_arena_pop(&arena, b, 32));
+    EXPECT_TRUE(melon_arena_pop(&arena, a, 32));
+    EXPECT_EQ(0u, arena.current_block->offset);
+
+    EXPECT_EQ(a, melon_arena_push_size(&arena, 32, MELON_DEFAULT_ALIGN));
+
+    melon_destroy_arena(&arena);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <melon/core/buddy.h>
+
+#include <random>
+#include <vector>
+
+class BuddyAllocatorTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        ASSERT_TRUE(melon_create_buddy_allocator(&buddy, MELON_KILOBYTE(64), 256, melon_default_cb_allocator()));
+    }
+    void TearDown() override { melon_destroy_buddy_allocator(&buddy); }
+
+    melon_buddy_allocator buddy;
+};
+
+TEST(BuddyAllocatorCreateTest, rejects_non_power_of_two_sizes)
+{
+    melon_buddy_allocator buddy;
+    EXPECT_FALSE(melon_create_buddy_allocator(&buddy, 1000, 16, melon_default_cb_allocator()));
+    EXPECT_FALSE(melon_create_buddy_allocator(&buddy, 1024, 24, melon_default_cb_allocator()));
+    EXPECT_FALSE(melon_create_buddy_allocator(&buddy, 1024, 2048, melon_default_cb_allocator()));
+}
+
+TEST_F(BuddyAllocatorTest, blocks_are_rounded_and_aligned_to_their_size)
+{
+    size_t a = melon_buddy_alloc(&buddy, 100);
+    size_t b = melon_buddy_alloc(&buddy, 1000);
+    size_t c = melon_buddy_alloc(&buddy, 256);
+
+    EXPECT_EQ(0u, a);
+    EXPECT_EQ(256u, melon_buddy_block_size(&buddy, a));
+    EXPECT_EQ(1024u, melon_buddy_block_size(&buddy, b));
+    EXPECT_EQ(0u, b % 1024);
+    EXPECT_EQ(256u, c);
+    EXPECT_EQ(256u + 1024u + 256u, buddy.used_size);
+
+    melon_buddy_free(&buddy, a);
+    melon_buddy_free(&buddy, b);
+    melon_buddy_free(&buddy, c);
+    EXPECT_EQ(0u, buddy.used_size);
+}
+
+TEST_F(BuddyAllocatorTest, freed_buddies_merge)
+{
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < MELON_KILOBYTE(64) / 256; i++)
+        offsets.push_back(melon_buddy_alloc(&buddy, 256));
+    EXPECT_EQ(MELON_BUDDY_INVALID_OFFSET, melon_buddy_alloc(&buddy, 1));
+
+    for (size_t offset : offsets)
+        melon_buddy_free(&buddy, offset);
+
+    // Everything coalesced back into the root
+    EXPECT_EQ(0u, melon_buddy_alloc(&buddy, MELON_KILOBYTE(64)));
+    EXPECT_EQ(MELON_BUDDY_INVALID_OFFSET, melon_buddy_alloc(&buddy, 256));
+}
+
+TEST_F(BuddyAllocatorTest, too_large_request_fails)
+{
+    EXPECT_EQ(MELON_BUDDY_INVALID_OFFSET, melon_buddy_alloc(&buddy, MELON_KILOBYTE(64) + 1));
+}
+
+TEST_F(BuddyAllocatorTest, random_allocations_never_overlap)
+{
+    std::mt19937                          rng(7);
+    std::uniform_int_distribution<size_t> size_dist(1, 4096);
+    std::vector<bool>                     used(MELON_KILOBYTE(64) / 256, false);
+    std::vector<size_t>                   live;
+
+    for (size_t i = 0; i < 10000; i++)
+    {
+        if (live.empty() || rng() % 2)
+        {
+            size_t offset = melon_buddy_alloc(&buddy, size_dist(rng));
+            if (offset == MELON_BUDDY_INVALID_OFFSET)
+                continue;
+
+            size_t block_size = melon_buddy_block_size(&buddy, offset);
+            ASSERT_EQ(0u, offset % block_size);
+            for (size_t leaf = offset / 256; leaf < (offset + block_size) / 256; leaf++)
+            {
+                ASSERT_FALSE(used[leaf]);
+                used[leaf] = true;
+            }
+            live.push_back(offset);
+        }
+        else
+        {
+            size_t index  = rng() % live.size();
+            size_t offset = live[index];
+            for (size_t leaf = offset / 256; leaf < (offset + melon_buddy_block_size(&buddy, offset)) / 256; leaf++)
+                used[leaf] = false;
+
+            melon_buddy_free(&buddy, offset);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+
+    for (size_t offset : live)
+        melon_buddy_free(&buddy, offset);
+    EXPECT_EQ(0u, buddy.used_size);
+    EXPECT_EQ(0u, melon_buddy_alloc(&buddy, MELON_KILOBYTE(64)));
+}
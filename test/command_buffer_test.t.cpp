@@ -0,0 +1,386 @@
+#include <gtest/gtest.h>
+#include <melon/gfx.h>
+#include <tinycthread.h>
+
+extern "C"
+{
+#include "../src/gfx/gfx_commands.h"
+}
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Records the calls the translation makes instead of issuing them to a device
+struct recorded_calls
+{
+    std::vector<std::string> calls;
+};
+
+void record_bind_pipeline(void* user_data, melon_pipeline_handle pipeline, melon_pipeline_handle previous)
+{
+    ((recorded_calls*) user_data)->calls.push_back("pipeline " + std::to_string(pipeline.data));
+}
+
+void record_bind_vertex_buffer(void* user_data, size_t binding, melon_buffer_handle buffer, size_t offset)
+{
+    ((recorded_calls*) user_data)
+        ->calls.push_back("vertex " + std::to_string(binding) + " " + std::to_string(buffer.data) + " "
+                          + std::to_string(offset));
+}
+
+void record_bind_index_buffer(void* user_data, melon_buffer_handle buffer)
+{
+    ((recorded_calls*) user_data)->calls.push_back("index " + std::to_string(buffer.data));
+}
+
+void record_draw(void* user_data, const melon_draw_call_params* params, const melon_draw_resources* resources)
+{
+    ((recorded_calls*) user_data)
+        ->calls.push_back("draw " + std::to_string(params->num_vertices) + " "
+                          + std::to_string(resources->index_buffer_offset));
+}
+
+void record_clear(void* user_data, const float color[4])
+{
+    ((recorded_calls*) user_data)->calls.push_back("clear " + std::to_string(color[0]));
+}
+
+const melon_pipeline_handle  no_pipeline = {~(melon_gfx_handle) 0};
+const melon_pipeline_handle  pipeline_a  = {1};
+const melon_pipeline_handle  pipeline_b  = {2};
+const melon_buffer_handle    vertices    = {10};
+const melon_buffer_handle    indices     = {11};
+const melon_draw_call_params draw        = {MELON_TRIANGLES, 1, 0, 3};
+} // namespace
+
+class CommandBufferTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        for (cb_command_buffer& cb : cbs)
+            cb_create(melon_default_cb_allocator(), &cb, MELON_KILOBYTE(4));
+
+        backend = {record_bind_pipeline, record_bind_vertex_buffer, record_bind_index_buffer,
+                   record_draw,          record_clear,              &recorded};
+
+        empty          = melon_draw_state{};
+        empty.pipeline = no_pipeline;
+        bound          = empty;
+    }
+
+    void TearDown() override
+    {
+        for (cb_command_buffer& cb : cbs)
+            cb_destroy(&cb);
+    }
+
+    void translate(size_t count)
+    {
+        cb_command_buffer* claimed[2];
+        for (size_t i = 0; i < count; i++)
+        {
+            claimed[i] = &cbs[i];
+            cb_begin_consuming(claimed[i]);
+        }
+        cb_translate(claimed, count, &empty, &bound, &backend);
+    }
+
+    cb_command_buffer cbs[2];
+    recorded_calls    recorded;
+    cb_backend        backend;
+    melon_draw_state  empty;
+    melon_draw_state  bound;
+};
+
+TEST_F(CommandBufferTest, redundant_binds_are_filtered)
+{
+    cb_begin_recording(&cbs[0]);
+    cb_cmd_bind_pipeline(&cbs[0], pipeline_a);
+    cb_cmd_bind_vertex_buffer(&cbs[0], vertices, 0, 0);
+    cb_cmd_draw(&cbs[0], &draw);
+    // Rebinding what is already bound
+    cb_cmd_bind_pipeline(&cbs[0], pipeline_a);
+    cb_cmd_bind_vertex_buffer(&cbs[0], vertices, 0, 0);
+    cb_cmd_draw(&cbs[0], &draw);
+    // Only the offset changes
+    cb_cmd_bind_vertex_buffer(&cbs[0], vertices, 0, 64);
+    cb_cmd_draw(&cbs[0], &draw);
+    // Index offsets go to the draw, the buffer is bound once
+    cb_cmd_bind_index_buffer(&cbs[0], indices, MELON_FORMAT_UINT, 0);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_cmd_bind_index_buffer(&cbs[0], indices, MELON_FORMAT_UINT, 12);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_end_recording(&cbs[0]);
+
+    translate(1);
+
+    std::vector<std::string> expected = {"pipeline 1",     "vertex 0 10 0", "draw 3 0", "draw 3 0",
+                                         "vertex 0 10 64", "draw 3 0",      "index 11", "draw 3 0",
+                                         "draw 3 12"};
+    EXPECT_EQ(expected, recorded.calls);
+    EXPECT_EQ(pipeline_a.data, bound.pipeline.data);
+    EXPECT_EQ(64u, bound.resources.buffer_offsets[0]);
+    EXPECT_EQ(indices.data, bound.resources.index_buffer.data);
+
+    // Consuming empties the buffer
+    EXPECT_EQ(0u, cbs[0].num_commands);
+    EXPECT_EQ((uint32_t) CB_STATE_IDLE, cbs[0].state);
+}
+
+TEST_F(CommandBufferTest, bound_state_carries_across_command_buffers)
+{
+    for (cb_command_buffer& cb : cbs)
+    {
+        cb_begin_recording(&cb);
+        cb_cmd_bind_pipeline(&cb, pipeline_a);
+        cb_cmd_bind_vertex_buffer(&cb, vertices, 0, 0);
+        cb_cmd_bind_index_buffer(&cb, indices, MELON_FORMAT_USHORT, 0);
+        cb_cmd_draw(&cb, &draw);
+        cb_end_recording(&cb);
+    }
+
+    translate(2);
+
+    std::vector<std::string> expected = {"pipeline 1", "vertex 0 10 0", "index 11", "draw 3 0", "draw 3 0"};
+    EXPECT_EQ(expected, recorded.calls);
+}
+
+TEST_F(CommandBufferTest, pipeline_change_rebinds_vertex_buffers)
+{
+    cb_begin_recording(&cbs[0]);
+    cb_cmd_bind_pipeline(&cbs[0], pipeline_a);
+    cb_cmd_bind_vertex_buffer(&cbs[0], vertices, 0, 0);
+    cb_cmd_bind_vertex_buffer(&cbs[0], vertices, 1, 32);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_cmd_bind_pipeline(&cbs[0], pipeline_b);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_end_recording(&cbs[0]);
+
+    translate(1);
+
+    std::vector<std::string> expected = {"pipeline 1", "vertex 0 10 0", "vertex 1 10 32", "draw 3 0",
+                                         "pipeline 2", "vertex 0 10 0", "vertex 1 10 32", "draw 3 0"};
+    EXPECT_EQ(expected, recorded.calls);
+}
+
+TEST_F(CommandBufferTest, each_command_buffer_starts_empty)
+{
+    // The second command buffer doesn't inherit the first one's bindings
+    cb_begin_recording(&cbs[0]);
+    cb_cmd_bind_pipeline(&cbs[0], pipeline_a);
+    cb_cmd_bind_vertex_buffer(&cbs[0], vertices, 1, 0);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_end_recording(&cbs[0]);
+
+    cb_begin_recording(&cbs[1]);
+    cb_cmd_bind_pipeline(&cbs[1], pipeline_a);
+    cb_cmd_draw(&cbs[1], &draw);
+    cb_end_recording(&cbs[1]);
+
+    translate(2);
+
+    std::vector<std::string> expected = {"pipeline 1", "vertex 1 10 0", "draw 3 0", "vertex 1 0 0", "draw 3 0"};
+    EXPECT_EQ(expected, recorded.calls);
+}
+
+TEST_F(CommandBufferTest, clears_keep_their_place_between_draws)
+{
+    const float black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    cb_begin_recording(&cbs[0]);
+    cb_cmd_clear(&cbs[0], black);
+    cb_cmd_bind_pipeline(&cbs[0], pipeline_a);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_cmd_clear(&cbs[0], white);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_end_recording(&cbs[0]);
+
+    translate(1);
+
+    std::vector<std::string> expected = {"clear 0.000000", "pipeline 1", "draw 3 0", "clear 1.000000", "draw 3 0"};
+    EXPECT_EQ(expected, recorded.calls);
+}
+
+namespace
+{
+const size_t recording_threads   = 4;
+const size_t commands_per_thread = 2000;
+
+// Command buffer blocks share one allocator behind a lock, like the device's. The counts are only touched under it
+struct locked_allocator
+{
+    mtx_t               lock;
+    melon_allocator_api inner;
+    size_t              allocations;
+    size_t              live_allocations;
+};
+
+void* locked_alloc(void* user_data, size_t size, size_t align)
+{
+    locked_allocator* locked = (locked_allocator*) user_data;
+    mtx_lock(&locked->lock);
+    void* result = MELON_ALLOC(locked->inner, size, align);
+    locked->allocations++;
+    locked->live_allocations++;
+    mtx_unlock(&locked->lock);
+    return result;
+}
+
+void* locked_realloc(void* user_data, void* ptr, size_t size, size_t align)
+{
+    locked_allocator* locked = (locked_allocator*) user_data;
+    mtx_lock(&locked->lock);
+    void* result = MELON_REALLOC(locked->inner, ptr, size, align);
+    mtx_unlock(&locked->lock);
+    return result;
+}
+
+void locked_free(void* user_data, void* ptr)
+{
+    locked_allocator* locked = (locked_allocator*) user_data;
+    mtx_lock(&locked->lock);
+    MELON_FREE(locked->inner, ptr);
+    locked->live_allocations--;
+    mtx_unlock(&locked->lock);
+}
+
+struct recorder
+{
+    cb_command_buffer* cb;
+    size_t             id;
+};
+
+melon_buffer_handle thread_buffer(size_t id) { return {(melon_gfx_handle) (100 + id)}; }
+
+int record(void* arg)
+{
+    recorder* r = (recorder*) arg;
+    cb_begin_recording(r->cb);
+    cb_cmd_bind_pipeline(r->cb, {(melon_gfx_handle) (r->id + 1)});
+    for (size_t i = 0; i < commands_per_thread; i++)
+    {
+        cb_cmd_bind_vertex_buffer(r->cb, thread_buffer(r->id), 0, i * 16);
+        cb_cmd_draw(r->cb, &draw);
+    }
+    cb_end_recording(r->cb);
+    return 0;
+}
+
+struct blocked_recording
+{
+    cb_command_buffer* cb;
+    std::atomic<bool>  started;
+};
+
+int record_after_consuming(void* arg)
+{
+    blocked_recording* blocked = (blocked_recording*) arg;
+    cb_begin_recording(blocked->cb);
+    blocked->started.store(true);
+    cb_end_recording(blocked->cb);
+    return 0;
+}
+} // namespace
+
+TEST_F(CommandBufferTest, recording_waits_for_consuming)
+{
+    cb_begin_recording(&cbs[0]);
+    cb_cmd_draw(&cbs[0], &draw);
+    cb_end_recording(&cbs[0]);
+    EXPECT_EQ((uint32_t) CB_STATE_RECORDED, cbs[0].state);
+
+    cb_command_buffer* claimed = &cbs[0];
+    cb_begin_consuming(claimed);
+    EXPECT_EQ((uint32_t) CB_STATE_CONSUMING, cbs[0].state);
+
+    blocked_recording blocked = {&cbs[0], {false}};
+    thrd_t            thread;
+    ASSERT_EQ(thrd_success, thrd_create(&thread, record_after_consuming, &blocked));
+
+    struct timespec wait = {0, 20 * 1000 * 1000};
+    thrd_sleep(&wait, NULL);
+    EXPECT_FALSE(blocked.started.load());
+
+    cb_translate(&claimed, 1, &empty, &bound, &backend);
+    thrd_join(thread, NULL);
+
+    EXPECT_TRUE(blocked.started.load());
+    EXPECT_EQ((uint32_t) CB_STATE_RECORDED, cbs[0].state);
+    EXPECT_EQ(0u, cbs[0].num_commands);
+}
+
+TEST(CommandBufferThreadTest, threads_record_in_parallel)
+{
+    locked_allocator* locked = new locked_allocator();
+    mtx_init(&locked->lock, mtx_plain);
+    locked->inner = *melon_default_cb_allocator();
+
+    melon_allocator_api allocator = {};
+    allocator.alloc               = locked_alloc;
+    allocator.realloc             = locked_realloc;
+    allocator.dealloc             = locked_free;
+    allocator.user_data           = locked;
+
+    // Small blocks, so every thread chains many of them while the others do the same
+    cb_command_buffer cbs[recording_threads];
+    recorder          recorders[recording_threads];
+    thrd_t            threads[recording_threads];
+    for (size_t i = 0; i < recording_threads; i++)
+    {
+        cb_create(&allocator, &cbs[i], 256);
+        recorders[i] = {&cbs[i], i};
+    }
+    size_t blocks_before = locked->allocations;
+
+    for (size_t i = 0; i < recording_threads; i++)
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], record, &recorders[i]));
+    for (size_t i = 0; i < recording_threads; i++)
+        thrd_join(threads[i], NULL);
+
+    EXPECT_LT(blocks_before + recording_threads, locked->allocations);
+
+    cb_command_buffer* claimed[recording_threads];
+    for (size_t i = 0; i < recording_threads; i++)
+    {
+        EXPECT_EQ((uint32_t) CB_STATE_RECORDED, cbs[i].state);
+        EXPECT_EQ(1 + 2 * commands_per_thread, cbs[i].num_commands);
+        claimed[i] = &cbs[i];
+        cb_begin_consuming(claimed[i]);
+    }
+
+    // Translated in submission order, whichever thread finished first
+    recorded_calls   recorded;
+    cb_backend       backend = {record_bind_pipeline, record_bind_vertex_buffer, record_bind_index_buffer,
+                                record_draw,          record_clear,              &recorded};
+    melon_draw_state empty   = melon_draw_state{};
+    empty.pipeline           = no_pipeline;
+    melon_draw_state bound   = empty;
+    cb_translate(claimed, recording_threads, &empty, &bound, &backend);
+
+    std::vector<std::string> expected;
+    for (size_t id = 0; id < recording_threads; id++)
+    {
+        expected.push_back("pipeline " + std::to_string(id + 1));
+        for (size_t i = 0; i < commands_per_thread; i++)
+        {
+            expected.push_back("vertex 0 " + std::to_string(thread_buffer(id).data) + " " + std::to_string(i * 16));
+            expected.push_back("draw 3 0");
+        }
+    }
+    EXPECT_EQ(expected, recorded.calls);
+
+    for (size_t i = 0; i < recording_threads; i++)
+    {
+        EXPECT_EQ((uint32_t) CB_STATE_IDLE, cbs[i].state);
+        cb_destroy(&cbs[i]);
+    }
+    EXPECT_EQ(0u, locked->live_allocations);
+
+    mtx_destroy(&locked->lock);
+    delete locked;
+}
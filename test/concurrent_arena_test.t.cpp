@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <melon/core/concurrent_arena.h>
+#include <tinycthread.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+struct allocation
+{
+    uint8_t* ptr;
+    size_t   size;
+};
+
+struct worker
+{
+    melon_concurrent_arena* arena;
+    uint32_t                seed;
+    std::vector<allocation> allocations;
+};
+
+const size_t thread_count           = 8;
+const size_t allocations_per_thread = 20000;
+
+int hammer(void* arg)
+{
+    worker* w = (worker*) arg;
+    for (size_t i = 0; i < allocations_per_thread; i++)
+    {
+        w->seed      = w->seed * 1664525 + 1013904223;
+        size_t size  = 1 + (w->seed >> 8) % 200;
+        size_t align = (size_t) 1 << ((w->seed >> 24) % 8);
+
+        uint8_t* ptr = (uint8_t*) melon_concurrent_arena_push_size(w->arena, size, align);
+        if (ptr == NULL || (uintptr_t) ptr % align != 0)
+            return 1;
+
+        // Scribble over the allocation so overlapping pushes would clobber each other
+        memset(ptr, (int) (w->seed & 0xff), size);
+        w->allocations.push_back({ptr, size});
+    }
+    return 0;
+}
+} // namespace
+
+TEST(ConcurrentArenaTest, single_thread_push)
+{
+    melon_concurrent_arena arena;
+    melon_create_concurrent_arena(&arena, 256, melon_default_cb_allocator());
+
+    uint8_t* a = (uint8_t*) melon_concurrent_arena_push_size(&arena, 10, 1);
+    uint8_t* b = (uint8_t*) melon_concurrent_arena_push_size(&arena, 10, 64);
+    EXPECT_EQ(0u, (uintptr_t) b % 64);
+    EXPECT_LE(a + 10, b);
+
+    // Larger than a block
+    uint8_t* c = (uint8_t*) melon_concurrent_arena_push_size(&arena, 1000, 16);
+    ASSERT_NE(nullptr, c);
+    memset(c, 0, 1000);
+    EXPECT_NE(nullptr, arena.current_block->prev);
+
+    melon_concurrent_arena_reset(&arena);
+    EXPECT_EQ(nullptr, arena.current_block->prev);
+    EXPECT_EQ(0u, arena.current_block->offset);
+
+    melon_destroy_concurrent_arena(&arena);
+}
+
+TEST(ConcurrentArenaTest, many_threads_get_aligned_disjoint_memory)
+{
+    melon_concurrent_arena arena;
+    melon_create_concurrent_arena(&arena, MELON_KILOBYTE(64), melon_default_cb_allocator());
+
+    worker workers[thread_count];
+    thrd_t threads[thread_count];
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        workers[i].arena = &arena;
+        workers[i].seed  = (uint32_t) i * 7919 + 1;
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], hammer, &workers[i]));
+    }
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        int result = -1;
+        thrd_join(threads[i], &result);
+        EXPECT_EQ(0, result);
+    }
+
+    std::vector<allocation> all;
+    for (size_t i = 0; i < thread_count; i++)
+        all.insert(all.end(), workers[i].allocations.begin(), workers[i].allocations.end());
+    ASSERT_EQ(thread_count * allocations_per_thread, all.size());
+
+    std::sort(all.begin(), all.end(), [](const allocation& a, const allocation& b) { return a.ptr < b.ptr; });
+    for (size_t i = 1; i < all.size(); i++)
+        ASSERT_LE(all[i - 1].ptr + all[i - 1].size, all[i].ptr);
+
+    melon_destroy_concurrent_arena(&arena);
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <melon/core/concurrent_handle.h>
+#include <tinycthread.h>
+
+#include <atomic>
+#include <vector>
+
+namespace
+{
+const size_t thread_count       = 8;
+const size_t handles_per_thread = 32;
+const size_t iterations         = 50000;
+
+struct shared_state
+{
+    melon_concurrent_handle_pool pool;
+    // Thread that currently holds each slot, 0 if none
+    std::atomic<uint32_t> owners[thread_count * handles_per_thread];
+};
+
+struct worker
+{
+    shared_state* state;
+    uint32_t      id;
+    uint32_t      seed;
+};
+
+int churn(void* arg)
+{
+    worker*                   w = (worker*) arg;
+    std::vector<melon_handle> held;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        w->seed = w->seed * 1664525 + 1013904223;
+        if (held.size() < handles_per_thread && (held.empty() || (w->seed >> 16) % 2 == 0))
+        {
+            // The pool has room for every thread's handles, so creating never fails
+            melon_handle handle = melon_concurrent_pool_create_handle(&w->state->pool);
+            if (!melon_concurrent_handle_is_valid(&w->state->pool, handle))
+                return 1;
+
+            // No other thread may hold the same slot
+            uint32_t expected = 0;
+            if (!w->state->owners[melon_handle_index(handle)].compare_exchange_strong(expected, w->id))
+                return 2;
+            held.push_back(handle);
+        }
+        else
+        {
+            size_t       slot   = (w->seed >> 8) % held.size();
+            melon_handle handle = held[slot];
+            held[slot]          = held.back();
+            held.pop_back();
+
+            w->state->owners[melon_handle_index(handle)].store(0);
+            if (!melon_concurrent_pool_delete_handle(&w->state->pool, handle))
+                return 3;
+            if (melon_concurrent_handle_is_valid(&w->state->pool, handle))
+                return 4;
+        }
+    }
+
+    for (melon_handle handle : held)
+    {
+        w->state->owners[melon_handle_index(handle)].store(0);
+        melon_concurrent_pool_delete_handle(&w->state->pool, handle);
+    }
+    return 0;
+}
+
+struct delete_race
+{
+    melon_concurrent_handle_pool* pool;
+    melon_handle                  handle;
+    std::atomic<size_t>*          deleted;
+};
+
+int delete_same_handle(void* arg)
+{
+    delete_race* race = (delete_race*) arg;
+    if (melon_concurrent_pool_delete_handle(race->pool, race->handle))
+        race->deleted->fetch_add(1);
+    return 0;
+}
+} // namespace
+
+TEST(ConcurrentHandlePoolTest, single_thread)
+{
+    melon_concurrent_handle_pool pool;
+    melon_create_concurrent_handle_pool(&pool, 2, melon_default_cb_allocator());
+
+    melon_handle a = melon_concurrent_pool_create_handle(&pool);
+    melon_handle b = melon_concurrent_pool_create_handle(&pool);
+    EXPECT_EQ(0u, melon_handle_index(a));
+    EXPECT_EQ(1u, melon_handle_index(b));
+    EXPECT_EQ(MELON_INVALID_HANDLE, melon_concurrent_pool_create_handle(&pool));
+    EXPECT_FALSE(melon_concurrent_handle_is_valid(&pool, MELON_INVALID_HANDLE));
+
+    EXPECT_TRUE(melon_concurrent_pool_delete_handle(&pool, a));
+    EXPECT_FALSE(melon_concurrent_pool_delete_handle(&pool, a));
+    EXPECT_FALSE(melon_concurrent_handle_is_valid(&pool, a));
+    EXPECT_TRUE(melon_concurrent_handle_is_valid(&pool, b));
+
+    melon_handle recycled = melon_concurrent_pool_create_handle(&pool);
+    EXPECT_EQ(0u, melon_handle_index(recycled));
+    EXPECT_NE(a, recycled);
+    EXPECT_TRUE(melon_concurrent_handle_is_valid(&pool, recycled));
+
+    // Never handed out
+    EXPECT_FALSE(melon_concurrent_handle_is_valid(&pool, 5));
+
+    melon_delete_concurrent_handle_pool(&pool);
+}
+
+TEST(ConcurrentHandlePoolTest, retired_slots_are_not_reused)
+{
+    melon_concurrent_handle_pool pool;
+    melon_create_concurrent_handle_pool(&pool, 1, melon_default_cb_allocator());
+
+    melon_handle handle = melon_concurrent_pool_create_handle(&pool);
+    pool.generations[0] = (uint32_t) (MELON_HANDLE_GENERATION_MAX - 1);
+    handle              = ((MELON_HANDLE_GENERATION_MAX - 1) << MELON_HANDLE_INDEX_BITS) | melon_handle_index(handle);
+
+    EXPECT_TRUE(melon_concurrent_pool_delete_handle(&pool, handle));
+    EXPECT_EQ(MELON_INVALID_HANDLE, melon_concurrent_pool_create_handle(&pool));
+
+    melon_delete_concurrent_handle_pool(&pool);
+}
+
+TEST(ConcurrentHandlePoolTest, many_threads_create_and_delete)
+{
+    shared_state* state = new shared_state();
+    melon_create_concurrent_handle_pool(&state->pool, thread_count * handles_per_thread, melon_default_cb_allocator());
+
+    worker workers[thread_count];
+    thrd_t threads[thread_count];
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        workers[i] = {state, (uint32_t) i + 1, (uint32_t) i * 7919 + 1};
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], churn, &workers[i]));
+    }
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        int result = -1;
+        thrd_join(threads[i], &result);
+        EXPECT_EQ(0, result);
+    }
+
+    // Every handle was returned, so the whole capacity can be taken again
+    std::vector<melon_handle> handles;
+    for (size_t i = 0; i < thread_count * handles_per_thread; i++)
+    {
+        handles.push_back(melon_concurrent_pool_create_handle(&state->pool));
+        EXPECT_TRUE(melon_concurrent_handle_is_valid(&state->pool, handles.back()));
+    }
+    EXPECT_EQ(MELON_INVALID_HANDLE, melon_concurrent_pool_create_handle(&state->pool));
+
+    melon_delete_concurrent_handle_pool(&state->pool);
+    delete state;
+}
+
+TEST(ConcurrentHandlePoolTest, one_thread_wins_a_delete)
+{
+    melon_concurrent_handle_pool pool;
+    melon_create_concurrent_handle_pool(&pool, 1, melon_default_cb_allocator());
+
+    for (size_t round = 0; round < 100; round++)
+    {
+        std::atomic<size_t> deleted(0);
+        delete_race         race = {&pool, melon_concurrent_pool_create_handle(&pool), &deleted};
+
+        thrd_t threads[thread_count];
+        for (size_t i = 0; i < thread_count; i++)
+            ASSERT_EQ(thrd_success, thrd_create(&threads[i], delete_same_handle, &race));
+        for (size_t i = 0; i < thread_count; i++)
+            thrd_join(threads[i], NULL);
+
+        EXPECT_EQ(1u, deleted.load());
+    }
+
+    melon_delete_concurrent_handle_pool(&pool);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <melon/core/handle.h>
+
+#include <set>
+#include <vector>
+
+typedef struct
+{
+    int   id;
+    float x;
+} sprite;
+
+MELON_DENSE_MAP_TYPEDEF(sprite);
+
+class DenseMapTest : public ::testing::Test
+{
+public:
+    void SetUp() override { melon_create_dense_map(&map, 1, melon_default_cb_allocator(), true); }
+    void TearDown() override { melon_delete_dense_map(&map); }
+
+    melon_dense_map_sprite map;
+};
+
+TEST_F(DenseMapTest, push_and_get)
+{
+    std::vector<melon_handle> handles;
+    for (int i = 0; i < 100; i++)
+    {
+        sprite s = { i, (float) i };
+        handles.push_back(melon_dense_map_push(&map, &s));
+    }
+
+    EXPECT_EQ(100u, melon_dense_map_count(&map));
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(i, melon_dense_map_get(&map, handles[i])->id);
+}
+
+TEST_F(DenseMapTest, delete_keeps_elements_packed)
+{
+    std::vector<melon_handle> handles;
+    for (int i = 0; i < 10; i++)
+    {
+        sprite s = { i, 0.0f };
+        handles.push_back(melon_dense_map_push(&map, &s));
+    }
+
+    EXPECT_TRUE(melon_dense_map_delete(&map, handles[2]));
+    EXPECT_TRUE(melon_dense_map_delete(&map, handles[9]));
+    EXPECT_TRUE(melon_dense_map_delete(&map, handles[0]));
+    EXPECT_FALSE(melon_dense_map_delete(&map, handles[0]));
+    EXPECT_EQ(7u, melon_dense_map_count(&map));
+
+    // The remaining handles still find their elements after the moves
+    for (int i : { 1, 3, 4, 5, 6, 7, 8 })
+        EXPECT_EQ(i, melon_dense_map_get(&map, handles[i])->id);
+    EXPECT_EQ(nullptr, melon_dense_map_get(&map, handles[2]));
+
+    // And iteration sees exactly the live elements
+    std::set<int> seen;
+    melon_dense_map_for_each(&map, sprite, s) seen.insert(s->id);
+    EXPECT_EQ((std::set<int>{ 1, 3, 4, 5, 6, 7, 8 }), seen);
+
+    for (size_t slot = 0; slot < melon_dense_map_count(&map); slot++)
+        EXPECT_EQ(map.data + slot, melon_dense_map_get(&map, melon_dense_map_handle_at(&map, slot)));
+}
+
+TEST_F(DenseMapTest, for_each_updates_in_place)
+{
+    std::vector<melon_handle> handles;
+    for (int i = 0; i < 50; i++)
+    {
+        sprite s = { i, 0.0f };
+        handles.push_back(melon_dense_map_push(&map, &s));
+    }
+    for (int i = 0; i < 50; i += 2)
+        melon_dense_map_delete(&map, handles[i]);
+
+    melon_dense_map_for_each(&map, sprite, s) s->x += 1.0f;
+
+    for (int i = 1; i < 50; i += 2)
+        EXPECT_EQ(1.0f, melon_dense_map_get(&map, handles[i])->x);
+
+    // Freed handle indices are reused without disturbing the packing
+    sprite       s      = { 100, 0.0f };
+    melon_handle handle = melon_dense_map_push(&map, &s);
+    EXPECT_EQ(26u, melon_dense_map_count(&map));
+    EXPECT_EQ(100, melon_dense_map_get(&map, handle)->id);
+    EXPECT_EQ(100, map.data[25].id);
+}
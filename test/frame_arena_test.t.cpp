@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <melon/core/frame_arena.h>
+
+class FrameArenaTest : public ::testing::Test
+{
+public:
+    void SetUp() override { melon_create_frame_arena(&frames, 3, 1024, melon_default_cb_allocator()); }
+    void TearDown() override { melon_destroy_frame_arena(&frames); }
+
+    melon_frame_arena frames;
+};
+
+TEST_F(FrameArenaTest, begin_frame_only_recycles_its_partition)
+{
+    uint64_t ids[3];
+    int*     values[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        ids[i]     = melon_frame_arena_begin_frame(&frames, i);
+        values[i]  = MELON_FRAME_PUSH_STRUCT(frames, int);
+        *values[i] = (int) i;
+    }
+
+    // Frame 0 is done on the GPU, reuse its partition
+    uint64_t next_id = melon_frame_arena_begin_frame(&frames, 0);
+    EXPECT_GT(next_id, ids[2]);
+
+    EXPECT_EQ(1, *values[1]);
+    EXPECT_EQ(2, *values[2]);
+    EXPECT_FALSE(melon_frame_arena_is_live(&frames, values[0], ids[0]));
+    EXPECT_TRUE(melon_frame_arena_is_live(&frames, values[1], ids[1]));
+    EXPECT_TRUE(melon_frame_arena_is_live(&frames, values[2], ids[2]));
+
+    // The recycled partition hands out the same memory again
+    int* reused = MELON_FRAME_PUSH_STRUCT(frames, int);
+    EXPECT_EQ(values[0], reused);
+    EXPECT_TRUE(melon_frame_arena_is_live(&frames, reused, next_id));
+}
+
+TEST_F(FrameArenaTest, pointers_are_checked_against_their_frame)
+{
+    uint64_t id0 = melon_frame_arena_begin_frame(&frames, 0);
+    int*     a   = MELON_FRAME_PUSH_STRUCT(frames, int);
+    uint64_t id1 = melon_frame_arena_begin_frame(&frames, 1);
+    int*     b   = MELON_FRAME_PUSH_STRUCT(frames, int);
+
+    EXPECT_TRUE(melon_frame_arena_is_live(&frames, a, id0));
+    EXPECT_FALSE(melon_frame_arena_is_live(&frames, a, id1));
+    EXPECT_FALSE(melon_frame_arena_is_live(&frames, b, id0));
+
+    int stack_value = 0;
+    EXPECT_FALSE(melon_frame_arena_is_live(&frames, &stack_value, id1));
+}
+
+TEST_F(FrameArenaTest, overflowing_partition_stays_live_until_recycled)
+{
+    uint64_t id   = melon_frame_arena_begin_frame(&frames, 1);
+    uint8_t* big  = MELON_FRAME_PUSH_ARRAY(frames, uint8_t, 4096, MELON_DEFAULT_ALIGN);
+    uint8_t* more = MELON_FRAME_PUSH_ARRAY(frames, uint8_t, 4096, MELON_DEFAULT_ALIGN);
+    EXPECT_TRUE(melon_frame_arena_is_live(&frames, big, id));
+    EXPECT_TRUE(melon_frame_arena_is_live(&frames, more + 4095, id));
+
+    melon_frame_arena_begin_frame(&frames, 1);
+    EXPECT_FALSE(melon_frame_arena_is_live(&frames, big, id));
+    EXPECT_FALSE(melon_frame_arena_is_live(&frames, more, id));
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <melon/core/huge_pages.h>
+
+#include <cstring>
+
+class HugePageAllocatorTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        melon_create_huge_page_allocator(&huge, MELON_HUGE_PAGE_SIZE / 2, melon_default_cb_allocator());
+        allocator = melon_huge_page_allocator_api(&huge);
+    }
+
+    size_t live_mappings()
+    {
+        size_t count = 0;
+        for (size_t mappings : huge.live_mappings)
+            count += mappings;
+        return count;
+    }
+
+    melon_huge_page_allocator huge;
+    melon_allocator_api       allocator;
+};
+
+TEST_F(HugePageAllocatorTest, small_allocations_use_backing_allocator)
+{
+    void* ptr = MELON_ALLOC(allocator, 128, 64);
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_EQ(0u, (uintptr_t) ptr % 64);
+    EXPECT_EQ(0u, live_mappings());
+    MELON_FREE(allocator, ptr);
+}
+
+TEST_F(HugePageAllocatorTest, large_allocations_are_mapped)
+{
+    size_t   size = MELON_MEGABYTE(4);
+    uint8_t* ptr  = (uint8_t*) MELON_ALLOC(allocator, size, 256);
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_EQ(0u, (uintptr_t) ptr % 256);
+    EXPECT_EQ(1u, live_mappings());
+
+    // The mapping starts on a huge page boundary, the header sits in front of the data
+    EXPECT_LE((uintptr_t) ptr % MELON_HUGE_PAGE_SIZE, 256u);
+
+    memset(ptr, 0xab, size);
+    MELON_FREE(allocator, ptr);
+    EXPECT_EQ(0u, live_mappings());
+}
+
+TEST_F(HugePageAllocatorTest, small_alignments_are_respected)
+{
+    for (size_t align : {8, 16})
+    {
+        void* small = MELON_ALLOC(allocator, 128, align);
+        void* large = MELON_ALLOC(allocator, MELON_MEGABYTE(4), align);
+        ASSERT_NE(nullptr, small);
+        ASSERT_NE(nullptr, large);
+        EXPECT_EQ(0u, (uintptr_t) small % align);
+        EXPECT_EQ(0u, (uintptr_t) large % align);
+        EXPECT_EQ(1u, live_mappings());
+
+        small = MELON_REALLOC(allocator, small, 256, align);
+        EXPECT_EQ(0u, (uintptr_t) small % align);
+        large = MELON_REALLOC(allocator, large, MELON_MEGABYTE(3), align);
+        EXPECT_EQ(0u, (uintptr_t) large % align);
+
+        MELON_FREE(allocator, small);
+        MELON_FREE(allocator, large);
+    }
+    EXPECT_EQ(0u, live_mappings());
+}
+
+TEST_F(HugePageAllocatorTest, realloc_moves_across_threshold)
+{
+    uint8_t* ptr = (uint8_t*) MELON_ALLOC(allocator, 1024, MELON_DEFAULT_ALIGN);
+    for (size_t i = 0; i < 1024; i++)
+        ptr[i] = (uint8_t) i;
+
+    ptr = (uint8_t*) MELON_REALLOC(allocator, ptr, MELON_MEGABYTE(3), MELON_DEFAULT_ALIGN);
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_EQ(0u, (uintptr_t) ptr % MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(1u, live_mappings());
+    for (size_t i = 0; i < 1024; i++)
+        ASSERT_EQ((uint8_t) i, ptr[i]);
+
+    // Shrinking within the mapping keeps the pointer
+    uint8_t* same = (uint8_t*) MELON_REALLOC(allocator, ptr, MELON_MEGABYTE(2), MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(ptr, same);
+
+    ptr = (uint8_t*) MELON_REALLOC(allocator, same, 512, MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(0u, (uintptr_t) ptr % MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(0u, live_mappings());
+    for (size_t i = 0; i < 512; i++)
+        ASSERT_EQ((uint8_t) i, ptr[i]);
+
+    MELON_FREE(allocator, ptr);
+}
+
+TEST_F(HugePageAllocatorTest, backs_arena_blocks)
+{
+    melon_memory_arena arena = melon_create_arena(MELON_MEGABYTE(2), MELON_DEFAULT_ALIGN, &allocator);
+    EXPECT_EQ(1u, live_mappings());
+
+    uint8_t* data = MELON_ARENA_PUSH_ARRAY(arena, uint8_t, MELON_MEGABYTE(1), MELON_DEFAULT_ALIGN);
+    memset(data, 1, MELON_MEGABYTE(1));
+
+    melon_destroy_arena(&arena);
+    EXPECT_EQ(0u, live_mappings());
+}
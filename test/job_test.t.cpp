@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <melon/core/job.h>
+
+#include <atomic>
+#include <vector>
+
+namespace
+{
+struct increment_data
+{
+    std::atomic<size_t>* total;
+};
+
+void increment(void* data) { ((increment_data*) data)->total->fetch_add(1); }
+
+void square_range(void* data, size_t begin, size_t end)
+{
+    uint64_t* values = (uint64_t*) data;
+    for (size_t i = begin; i < end; i++)
+        values[i] = (uint64_t) i * i;
+}
+
+struct nested_data
+{
+    melon_job_system*    system;
+    std::atomic<size_t>* total;
+};
+
+// Queues jobs of its own and waits on them from inside a job
+void spawn_children(void* data)
+{
+    nested_data*   nested = (nested_data*) data;
+    increment_data child  = {nested->total};
+
+    std::vector<melon_job> jobs(16, melon_job{increment, &child, NULL});
+    melon_job_counter      counter = {0};
+    melon_job_system_run(nested->system, jobs.data(), jobs.size(), &counter);
+    melon_job_system_wait(nested->system, &counter);
+}
+} // namespace
+
+class JobSystemTest : public ::testing::TestWithParam<size_t>
+{
+};
+
+INSTANTIATE_TEST_CASE_P(WorkerCounts, JobSystemTest, ::testing::Values((size_t) 1, (size_t) 2, (size_t) 8));
+
+TEST_P(JobSystemTest, counter_waits_for_every_job)
+{
+    melon_job_system system;
+    ASSERT_TRUE(melon_create_job_system(&system, GetParam(), melon_default_cb_allocator()));
+
+    std::atomic<size_t> total(0);
+    increment_data      data = {&total};
+
+    // More jobs than a deque holds, so some of them run inline
+    std::vector<melon_job> jobs(MELON_JOB_DEQUE_CAPACITY * 2, melon_job{increment, &data, NULL});
+    for (size_t round = 0; round < 4; round++)
+    {
+        melon_job_counter counter = {0};
+        melon_job_system_run(&system, jobs.data(), jobs.size(), &counter);
+        melon_job_system_wait(&system, &counter);
+        EXPECT_EQ(0u, counter.pending);
+        EXPECT_EQ((round + 1) * jobs.size(), total.load());
+    }
+
+    melon_destroy_job_system(&system);
+}
+
+TEST_P(JobSystemTest, jobs_can_wait_on_jobs)
+{
+    melon_job_system system;
+    ASSERT_TRUE(melon_create_job_system(&system, GetParam(), melon_default_cb_allocator()));
+
+    std::atomic<size_t> total(0);
+    nested_data         data = {&system, &total};
+
+    std::vector<melon_job> jobs(64, melon_job{spawn_children, &data, NULL});
+    melon_job_counter      counter = {0};
+    melon_job_system_run(&system, jobs.data(), jobs.size(), &counter);
+    melon_job_system_wait(&system, &counter);
+    EXPECT_EQ(64u * 16u, total.load());
+
+    melon_destroy_job_system(&system);
+}
+
+TEST_P(JobSystemTest, parallel_for_covers_the_range)
+{
+    melon_job_system system;
+    ASSERT_TRUE(melon_create_job_system(&system, GetParam(), melon_default_cb_allocator()));
+
+    const size_t          count = 100003;
+    std::vector<uint64_t> values(count, 0);
+    melon_parallel_for(&system, count, 1000, square_range, values.data());
+    for (size_t i = 0; i < count; i++)
+        ASSERT_EQ((uint64_t) i * i, values[i]);
+
+    // Nothing to do
+    melon_parallel_for(&system, 0, 1000, square_range, values.data());
+
+    melon_destroy_job_system(&system);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <melon/core/memory_tracking.h>
+#include <melon/core/handle.h>
+#include <melon/core/error.h>
+
+#ifdef MELON_TRACK_MEMORY
+
+class TrackingAllocatorTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        melon_create_tracking_allocator(&tracker, "test", melon_default_cb_allocator());
+        allocator = melon_tracking_allocator_api(&tracker);
+    }
+    void TearDown() override { melon_destroy_tracking_allocator(&tracker); }
+
+    melon_tracking_allocator tracker;
+    melon_allocator_api      allocator;
+};
+
+TEST_F(TrackingAllocatorTest, records_live_and_peak_bytes)
+{
+    void* a = MELON_ALLOC(allocator, 100, MELON_DEFAULT_ALIGN);
+    void* b = MELON_ALLOC(allocator, 300, 64);
+    EXPECT_EQ(0u, (uintptr_t) b % 64);
+    EXPECT_EQ(400u, tracker.stats.live_bytes);
+    EXPECT_EQ(2u, tracker.stats.live_allocations);
+
+    MELON_FREE(allocator, b);
+    EXPECT_EQ(100u, tracker.stats.live_bytes);
+    EXPECT_EQ(400u, tracker.stats.peak_bytes);
+
+    a = MELON_REALLOC(allocator, a, 1000, MELON_DEFAULT_ALIGN);
+    EXPECT_EQ(1000u, tracker.stats.live_bytes);
+    EXPECT_EQ(1000u, tracker.stats.peak_bytes);
+
+    MELON_FREE(allocator, a);
+    EXPECT_EQ(0u, tracker.stats.live_bytes);
+    EXPECT_EQ(0u, tracker.stats.live_allocations);
+    EXPECT_EQ(2u, tracker.stats.total_allocations);
+    EXPECT_EQ(1u, tracker.stats.total_reallocations);
+    EXPECT_EQ(2u, tracker.stats.total_frees);
+}
+
+TEST_F(TrackingAllocatorTest, histogram_buckets_by_size)
+{
+    void* small  = MELON_ALLOC(allocator, 8, MELON_DEFAULT_ALIGN);
+    void* medium = MELON_ALLOC(allocator, 20, MELON_DEFAULT_ALIGN);
+    void* large  = MELON_ALLOC(allocator, MELON_MEGABYTE(4), MELON_DEFAULT_ALIGN);
+
+    EXPECT_EQ(1u, tracker.stats.size_histogram[0]);
+    EXPECT_EQ(1u, tracker.stats.size_histogram[1]);
+    EXPECT_EQ(1u, tracker.stats.size_histogram[MELON_ALLOCATION_HISTOGRAM_BUCKETS - 1]);
+
+    MELON_FREE(allocator, small);
+    MELON_FREE(allocator, medium);
+    MELON_FREE(allocator, large);
+}
+
+TEST_F(TrackingAllocatorTest, realloc_keeps_contents_across_alignments)
+{
+    uint8_t* ptr = (uint8_t*) MELON_ALLOC(allocator, 64, MELON_DEFAULT_ALIGN);
+    for (uint8_t i = 0; i < 64; i++)
+        ptr[i] = i;
+
+    ptr = (uint8_t*) MELON_REALLOC(allocator, ptr, 4096, 256);
+    EXPECT_EQ(0u, (uintptr_t) ptr % 256);
+    for (uint8_t i = 0; i < 64; i++)
+        EXPECT_EQ(i, ptr[i]);
+    EXPECT_EQ(4096u, tracker.stats.live_bytes);
+
+    MELON_FREE(allocator, ptr);
+}
+
+TEST_F(TrackingAllocatorTest, tracks_handle_pool_storage)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 16, &allocator, true);
+    size_t initial_bytes = tracker.stats.live_bytes;
+    EXPECT_LT(0u, initial_bytes);
+
+    for (size_t i = 0; i < 1000; i++)
+        melon_pool_create_handle(&pool);
+    EXPECT_LT(initial_bytes, tracker.stats.live_bytes);
+
+    melon_delete_handle_pool(&pool);
+    EXPECT_EQ(0u, tracker.stats.live_bytes);
+
+    melon_memory_report();
+}
+
+#else
+
+TEST(TrackingAllocatorTest, disabled_tracking_returns_inner_allocator)
+{
+    melon_tracking_allocator tracker;
+    melon_create_tracking_allocator(&tracker, "test", melon_default_cb_allocator());
+    melon_allocator_api allocator = melon_tracking_allocator_api(&tracker);
+
+    EXPECT_EQ(melon_default_cb_allocator()->alloc, allocator.alloc);
+    EXPECT_EQ(melon_default_cb_allocator()->realloc, allocator.realloc);
+    EXPECT_EQ(melon_default_cb_allocator()->dealloc, allocator.dealloc);
+
+    melon_destroy_tracking_allocator(&tracker);
+}
+
+#endif
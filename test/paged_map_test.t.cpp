@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <melon/core/handle.h>
+
+#include <vector>
+
+typedef struct
+{
+    uint64_t id;
+    float    values[5];
+} paged_element;
+
+MELON_PAGED_MAP_TYPEDEF(paged_element);
+
+TEST(PagedMapTest, pointers_survive_growth)
+{
+    melon_paged_map_paged_element map;
+    melon_create_paged_map(&map, 1, melon_default_cb_allocator(), true);
+
+    paged_element              element = {};
+    std::vector<melon_handle>   handles;
+    std::vector<paged_element*> pointers;
+    for (uint64_t i = 0; i < 10 * MELON_PAGED_MAP_PAGE_SIZE + 3; i++)
+    {
+        element.id = i;
+        handles.push_back(melon_paged_map_push(&map, &element));
+        pointers.push_back(melon_paged_map_get(&map, handles.back()));
+    }
+    EXPECT_EQ(11u, map.map.page_count);
+
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        EXPECT_EQ(pointers[i], melon_paged_map_get(&map, handles[i]));
+        EXPECT_EQ(i, pointers[i]->id);
+    }
+
+    melon_delete_paged_map(&map);
+}
+
+TEST(PagedMapTest, fixed_capacity_is_preallocated)
+{
+    melon_paged_map_paged_element map;
+    melon_create_paged_map(&map, 2 * MELON_PAGED_MAP_PAGE_SIZE, melon_default_cb_allocator(), false);
+    EXPECT_EQ(2u, map.map.page_count);
+
+    paged_element element = {};
+    for (size_t i = 0; i < 2 * MELON_PAGED_MAP_PAGE_SIZE; i++)
+        EXPECT_NE(MELON_INVALID_HANDLE, melon_paged_map_push(&map, &element));
+    EXPECT_EQ(MELON_INVALID_HANDLE, melon_paged_map_push(&map, &element));
+    EXPECT_EQ(2u, map.map.page_count);
+
+    melon_delete_paged_map(&map);
+}
+
+TEST(PagedMapTest, set_and_delete)
+{
+    melon_paged_map_paged_element map;
+    melon_create_paged_map(&map, 4, melon_default_cb_allocator(), true);
+
+    paged_element element = {};
+    element.id            = 1;
+    melon_handle handle   = melon_paged_map_push(&map, &element);
+
+    element.id = 2;
+    EXPECT_TRUE(melon_paged_map_set(&map, handle, &element));
+    EXPECT_EQ(2u, melon_paged_map_get(&map, handle)->id);
+
+    EXPECT_TRUE(melon_paged_map_delete(&map, handle));
+    EXPECT_FALSE(melon_paged_map_handle_is_valid(&map, handle));
+    EXPECT_EQ(nullptr, melon_paged_map_get(&map, handle));
+    EXPECT_FALSE(melon_paged_map_set(&map, handle, &element));
+    EXPECT_FALSE(melon_paged_map_delete(&map, handle));
+
+    melon_delete_paged_map(&map);
+}
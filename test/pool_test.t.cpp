@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <melon/core/handle.h>
 #include <melon/core/error.h>
+#include <algorithm>
 
 class PoolStressTest : public ::testing::TestWithParam<size_t>
 {
@@ -109,13 +110,385 @@ TEST(LimitTests, generation_test)
     melon_handle_pool pool;
     melon_create_handle_pool(&pool, 1, melon_default_cb_allocator(), false);
 
-    pool.handle_entries[0].handle = MELON_HANDLE_GENERATION_MASK - ((size_t) 1 << MELON_HANDLE_INDEX_BITS);
+    // Slots are initialized when first handed out, so age the handle after creating it
+    melon_handle last_generation = MELON_HANDLE_GENERATION_MASK - ((size_t) 1 << MELON_HANDLE_INDEX_BITS);
+    melon_pool_create_handle(&pool);
+    pool.generations[0] = (uint32_t) (last_generation >> MELON_HANDLE_INDEX_BITS);
 
-    EXPECT_EQ(true, melon_pool_delete_handle(&pool, melon_pool_create_handle(&pool)));
+    EXPECT_EQ(true, melon_pool_delete_handle(&pool, last_generation));
 
     melon_handle handle = melon_pool_create_handle(&pool);
     EXPECT_EQ(MELON_HANDLE_GENERATION_MAX, handle >> MELON_HANDLE_INDEX_BITS);
     EXPECT_EQ(MELON_INVALID_HANDLE, handle);
 
     melon_delete_handle_pool(&pool);
-}
\ No newline at end of file
+}
+TEST(LazyInitTests, reset_recycles_from_zero)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 4, melon_default_cb_allocator(), false);
+
+    for (size_t i = 0; i < 3; i++)
+        melon_pool_create_handle(&pool);
+    EXPECT_EQ(3u, pool.num_initialized);
+
+    melon_pool_reset(&pool);
+    EXPECT_EQ(0u, pool.num_initialized);
+    EXPECT_EQ(0u, melon_handle_index(melon_pool_create_handle(&pool)));
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(LazyInitTests, freed_slots_are_reused_before_new_ones)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 8, melon_default_cb_allocator(), false);
+
+    melon_handle a = melon_pool_create_handle(&pool);
+    melon_pool_create_handle(&pool);
+    melon_pool_delete_handle(&pool, a);
+
+    melon_handle recycled = melon_pool_create_handle(&pool);
+    EXPECT_EQ(melon_handle_index(a), melon_handle_index(recycled));
+    EXPECT_NE(a, recycled);
+    EXPECT_EQ(2u, pool.num_initialized);
+
+    // Indices past the high-water mark are never valid
+    EXPECT_FALSE(melon_handle_is_valid(&pool, 5));
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(LazyInitTests, empty_growable_pool_grows)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 0, melon_default_cb_allocator(), true);
+
+    for (size_t i = 0; i < 100; i++)
+        EXPECT_EQ(i, melon_handle_index(melon_pool_create_handle(&pool)));
+    EXPECT_LE(100u, pool.capacity);
+
+    melon_delete_handle_pool(&pool);
+}
+
+MELON_HANDLE_TYPEDEF(small_handle, uint32_t, 24)
+MELON_HANDLE_TYPEDEF(wide_index_handle, uint32_t, 20)
+
+TEST(HandleLayoutTests, typed_handle_round_trip)
+{
+    melon_handle_pool pool;
+    small_handle_create_pool(&pool, 4, melon_default_cb_allocator(), false);
+
+    small_handle a = small_handle_create(&pool);
+    small_handle b = small_handle_create(&pool);
+    EXPECT_EQ(0u, small_handle_index(a));
+    EXPECT_EQ(1u, small_handle_index(b));
+    EXPECT_TRUE(small_handle_is_valid(&pool, a));
+
+    EXPECT_TRUE(small_handle_delete(&pool, a));
+    EXPECT_FALSE(small_handle_is_valid(&pool, a));
+
+    small_handle recycled = small_handle_create(&pool);
+    EXPECT_EQ(0u, small_handle_index(recycled));
+    EXPECT_EQ(1u, recycled >> 24);
+
+    EXPECT_EQ(0xffffffffu, small_handle_invalid());
+    EXPECT_EQ((melon_handle) small_handle_invalid(), pool.invalid_handle);
+    EXPECT_FALSE(small_handle_is_valid(&pool, small_handle_invalid()));
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(HandleLayoutTests, narrow_generation_retires_slot)
+{
+    melon_handle_pool pool;
+    small_handle_create_pool(&pool, 2, melon_default_cb_allocator(), false);
+
+    // 8 generation bits leave 255 usable generations before the slot is retired
+    small_handle handle = small_handle_create(&pool);
+    for (uint32_t generation = 1; generation < 255; generation++)
+    {
+        EXPECT_TRUE(small_handle_delete(&pool, handle));
+        handle = small_handle_create(&pool);
+        EXPECT_EQ(0u, small_handle_index(handle));
+        EXPECT_EQ(generation, handle >> 24);
+    }
+
+    EXPECT_TRUE(small_handle_delete(&pool, handle));
+    EXPECT_FALSE(small_handle_is_valid(&pool, handle));
+
+    // The retired slot is skipped
+    small_handle next = small_handle_create(&pool);
+    EXPECT_EQ(1u, small_handle_index(next));
+    EXPECT_EQ(small_handle_invalid(), small_handle_create(&pool));
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(HandleLayoutTests, growth_stops_at_index_bits)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool_with_layout(&pool, 1, melon_default_cb_allocator(), true, 4, 28);
+
+    // Index 15 is reserved for the invalid handle
+    for (size_t i = 0; i < 15; i++)
+        EXPECT_EQ(i, melon_pool_handle_index(&pool, melon_pool_create_handle(&pool)));
+    EXPECT_EQ(pool.invalid_handle, melon_pool_create_handle(&pool));
+    EXPECT_EQ(0xffffffffu, pool.invalid_handle);
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(HandleLayoutTests, exhausted_pool_returns_layout_invalid_handle)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool_with_layout(&pool, 2, melon_default_cb_allocator(), false, 20, 12);
+
+    melon_pool_create_handle(&pool);
+    melon_pool_create_handle(&pool);
+    melon_handle full = melon_pool_create_handle(&pool);
+    EXPECT_EQ(melon_pool_invalid_handle(&pool), full);
+    EXPECT_EQ(0xffffffffu, melon_pool_invalid_handle(&pool));
+    EXPECT_NE(MELON_INVALID_HANDLE, melon_pool_invalid_handle(&pool));
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(HandleLayoutTests, wide_index_handle)
+{
+    melon_handle_pool pool;
+    wide_index_handle_create_pool(&pool, 0, melon_default_cb_allocator(), true);
+
+    wide_index_handle handle = 0;
+    for (size_t i = 0; i < 5000; i++)
+        handle = wide_index_handle_create(&pool);
+    EXPECT_EQ(4999u, wide_index_handle_index(handle));
+    EXPECT_TRUE(wide_index_handle_is_valid(&pool, handle));
+
+    EXPECT_TRUE(wide_index_handle_delete(&pool, handle));
+    handle = wide_index_handle_create(&pool);
+    EXPECT_EQ(4999u, wide_index_handle_index(handle));
+    EXPECT_EQ(1u, handle >> 20);
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(HandleLayoutTests, map_with_layout)
+{
+    melon_map_test_type map;
+    melon_create_map_with_layout(&map, 1, melon_default_cb_allocator(), true, 24, 8);
+
+    test_type    a        = {"a", 1, 1.0f};
+    test_type    b        = {"b", 2, 2.0f};
+    small_handle handle_a = (small_handle) melon_map_push(&map, &a);
+    small_handle handle_b = (small_handle) melon_map_push(&map, &b);
+
+    EXPECT_EQ(2, melon_map_get(&map, handle_b)->value_i);
+    EXPECT_TRUE(melon_map_delete(&map, handle_a));
+    EXPECT_EQ(NULL, melon_map_get(&map, handle_a));
+
+    handle_a = (small_handle) melon_map_push(&map, &b);
+    EXPECT_EQ(0u, small_handle_index(handle_a));
+    EXPECT_EQ(2, melon_map_get(&map, handle_a)->value_i);
+
+    melon_delete_map(&map);
+}
+
+TEST(HandleLayoutTests, exhausted_map_push)
+{
+    melon_map_test_type map;
+    melon_create_map_with_layout(&map, 15, melon_default_cb_allocator(), true, 4, 28);
+
+    test_type value = {"a", 1, 1.0f};
+    for (size_t i = 0; i < 15; i++)
+        EXPECT_EQ(i, melon_pool_handle_index(&map.map.pool, melon_map_push(&map, &value)));
+
+    // The pool is out of indices, the data must not grow to the invalid handle's index
+    size_t capacity = map.map.capacity;
+    EXPECT_EQ(map.map.pool.invalid_handle, melon_map_push(&map, &value));
+    EXPECT_EQ(15u, capacity);
+    EXPECT_EQ(capacity, map.map.capacity);
+
+    melon_delete_map(&map);
+}
+
+TEST(BatchTests, create_handles_grows_once)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 1, melon_default_cb_allocator(), true);
+
+    melon_handle handles[100];
+    EXPECT_EQ(100u, melon_pool_create_handles(&pool, handles, 100));
+    EXPECT_EQ(100u, pool.capacity);
+    for (size_t i = 0; i < 100; i++)
+        EXPECT_EQ(i, melon_handle_index(handles[i]));
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(BatchTests, create_handles_recycles_first)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 4, melon_default_cb_allocator(), false);
+
+    melon_handle handles[4];
+    EXPECT_EQ(4u, melon_pool_create_handles(&pool, handles, 4));
+    EXPECT_EQ(2u, melon_pool_delete_handles(&pool, handles + 1, 2));
+    // Deleting twice does nothing
+    EXPECT_EQ(0u, melon_pool_delete_handles(&pool, handles + 1, 2));
+
+    // Only the two recycled slots are left in a pool that can't grow
+    melon_handle recycled[3];
+    EXPECT_EQ(2u, melon_pool_create_handles(&pool, recycled, 3));
+    EXPECT_EQ(1u, melon_handle_index(recycled[0]));
+    EXPECT_EQ(2u, melon_handle_index(recycled[1]));
+    EXPECT_EQ(MELON_INVALID_HANDLE, recycled[2]);
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(BatchTests, handles_are_valid_matches_single_check)
+{
+    melon_handle_pool pool;
+    melon_create_handle_pool(&pool, 0, melon_default_cb_allocator(), true);
+
+    melon_handle handles[64];
+    bool         valid[64 + 2];
+    EXPECT_EQ(0u, melon_handles_are_valid(&pool, handles, valid, 0));
+
+    melon_pool_create_handles(&pool, handles, 64);
+    for (size_t i = 0; i < 64; i += 3)
+        melon_pool_delete_handle(&pool, handles[i]);
+
+    melon_handle checked[64 + 2];
+    std::copy(handles, handles + 64, checked);
+    checked[64] = MELON_INVALID_HANDLE;
+    checked[65] = 1000;
+
+    size_t expected = 0;
+    EXPECT_EQ(42u, melon_handles_are_valid(&pool, checked, valid, 66));
+    for (size_t i = 0; i < 66; i++)
+    {
+        EXPECT_EQ(melon_handle_is_valid(&pool, checked[i]), valid[i]);
+        expected += valid[i];
+    }
+    EXPECT_EQ(42u, expected);
+
+    melon_delete_handle_pool(&pool);
+}
+
+TEST(BatchTests, map_push_and_delete_array)
+{
+    melon_map_test_type map;
+    melon_create_map(&map, 1, melon_default_cb_allocator(), true);
+
+    test_type vals[10];
+    for (int i = 0; i < 10; i++)
+        vals[i] = {"value", i, (float) i};
+
+    melon_handle handles[10];
+    EXPECT_EQ(10u, melon_map_push_array(&map, vals, handles, 10));
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(i, melon_map_get(&map, handles[i])->value_i);
+
+    EXPECT_EQ(5u, melon_map_delete_array(&map, handles, 5));
+    bool valid[10];
+    EXPECT_EQ(5u, melon_map_handles_are_valid(&map, handles, valid, 10));
+    EXPECT_FALSE(valid[4]);
+    EXPECT_TRUE(valid[5]);
+
+    melon_delete_map(&map);
+}
+
+namespace
+{
+struct remap_record
+{
+    std::vector<std::pair<melon_handle, melon_handle>> moves;
+};
+
+void record_remap(melon_handle old_handle, melon_handle new_handle, void* user_data)
+{
+    ((remap_record*) user_data)->moves.push_back({old_handle, new_handle});
+}
+} // namespace
+
+TEST(CompactTests, compact_moves_live_elements_to_the_front)
+{
+    melon_map_test_type map;
+    melon_create_map(&map, 16, melon_default_cb_allocator(), false);
+
+    melon_handle handles[16];
+    for (int i = 0; i < 16; i++)
+    {
+        test_type val = {"value", i, (float) i};
+        handles[i]    = melon_map_push(&map, &val);
+    }
+    // Keep every fourth element
+    for (int i = 0; i < 16; i++)
+        if (i % 4 != 3)
+            melon_map_delete(&map, handles[i]);
+
+    // One element per call
+    remap_record record;
+    EXPECT_EQ(1u, melon_map_compact(&map, sizeof(test_type), record_remap, &record));
+    EXPECT_EQ(2u, melon_map_compact(&map, 16 * sizeof(test_type), record_remap, &record));
+    EXPECT_EQ(0u, melon_map_compact(&map, 16 * sizeof(test_type), record_remap, &record));
+    // The element in slot 3 is already in place
+    ASSERT_EQ(3u, record.moves.size());
+
+    for (auto& move : record.moves)
+    {
+        for (int i = 0; i < 16; i++)
+            if (handles[i] == move.first)
+                handles[i] = move.second;
+        EXPECT_FALSE(melon_map_handle_is_valid(&map, move.first));
+        EXPECT_LT(melon_handle_index(move.second), 3u);
+    }
+    for (int i = 3; i < 16; i += 4)
+    {
+        ASSERT_TRUE(melon_map_handle_is_valid(&map, handles[i]));
+        EXPECT_EQ(i, melon_map_get(&map, handles[i])->value_i);
+    }
+
+    // Freed slots are reused in index order after compaction, and the map grows back after shrinking
+    melon_map_shrink(&map);
+    EXPECT_EQ(4u, map.map.capacity);
+    test_type    val    = {"new", 100, 0.0f};
+    melon_handle handle = melon_map_push(&map, &val);
+    EXPECT_EQ(4u, melon_handle_index(handle));
+    EXPECT_EQ(100, melon_map_get(&map, handle)->value_i);
+
+    melon_delete_map(&map);
+}
+
+TEST(CompactTests, compact_keeps_retired_slots_out)
+{
+    melon_map_test_type map;
+    melon_create_map_with_layout(&map, 4, melon_default_cb_allocator(), false, 24, 8);
+
+    test_type    val = {"value", 0, 0.0f};
+    melon_handle a   = melon_map_push(&map, &val);
+    // Cycle slot 0 until it is retired
+    for (int i = 0; i < 254; i++)
+    {
+        melon_map_delete(&map, a);
+        a = melon_map_push(&map, &val);
+    }
+    melon_map_delete(&map, a);
+
+    val.value_i    = 1;
+    melon_handle b = melon_map_push(&map, &val);
+    val.value_i    = 2;
+    melon_handle c = melon_map_push(&map, &val);
+    melon_map_delete(&map, b);
+
+    remap_record record;
+    EXPECT_EQ(1u, melon_map_compact(&map, 1024, record_remap, &record));
+    ASSERT_EQ(1u, record.moves.size());
+    EXPECT_EQ(c, record.moves[0].first);
+    EXPECT_EQ(1u, melon_pool_handle_index(&map.map.pool, record.moves[0].second));
+    EXPECT_EQ(2, melon_map_get(&map, record.moves[0].second)->value_i);
+
+    melon_delete_map(&map);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <melon/core/slab.h>
+#include <melon/core/virtual_memory.h>
+#include <melon/core/handle.h>
+#include <melon/core/error.h>
+
+#include <algorithm>
+#include <vector>
+
+class SlabTest : public ::testing::TestWithParam<size_t>
+{
+public:
+    void SetUp() override { melon_create_slab_allocator(&slab, MELON_MEGABYTE(64), melon_default_cb_allocator()); }
+    void TearDown() override { melon_destroy_slab_allocator(&slab); }
+
+    melon_slab_allocator slab;
+};
+
+INSTANTIATE_TEST_CASE_P(SizeTest, SlabTest, ::testing::Values((size_t) 1, (size_t) 16, (size_t) 24, (size_t) 100,
+                                                              (size_t) 512, (size_t) 1000, (size_t) 1024));
+
+TEST_P(SlabTest, allocations_are_distinct_and_aligned)
+{
+    const size_t       count = 4096;
+    std::vector<void*> ptrs;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t* ptr = (uint8_t*) melon_slab_alloc(&slab, GetParam(), MELON_DEFAULT_ALIGN);
+        ASSERT_NE(nullptr, ptr);
+        EXPECT_EQ(0u, (uintptr_t) ptr % MELON_DEFAULT_ALIGN);
+        memset(ptr, (int) i, GetParam());
+        ptrs.push_back(ptr);
+    }
+
+    std::vector<void*> sorted = ptrs;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 1; i < count; i++)
+        EXPECT_LE((uint8_t*) sorted[i - 1] + GetParam(), (uint8_t*) sorted[i]);
+
+    for (size_t i = 0; i < count; i++)
+        EXPECT_EQ((uint8_t) i, *(uint8_t*) ptrs[i]);
+
+    for (size_t i = 0; i < count; i++)
+        melon_slab_free(&slab, ptrs[i]);
+}
+
+TEST_P(SlabTest, freed_objects_are_reused)
+{
+    void* first = melon_slab_alloc(&slab, GetParam(), MELON_DEFAULT_ALIGN);
+    melon_slab_free(&slab, first);
+    EXPECT_EQ(first, melon_slab_alloc(&slab, GetParam(), MELON_DEFAULT_ALIGN));
+    melon_slab_free(&slab, first);
+
+    // Allocating and freeing in a loop does not grow the slab region
+    for (size_t i = 0; i < 1024; i++)
+        melon_slab_free(&slab, melon_slab_alloc(&slab, GetParam(), MELON_DEFAULT_ALIGN));
+    EXPECT_EQ(melon_vm_page_size(), slab.used_size);
+}
+
+TEST_P(SlabTest, empty_slabs_are_shared_between_classes)
+{
+    std::vector<void*> ptrs;
+    for (size_t i = 0; i < 4096; i++)
+        ptrs.push_back(melon_slab_alloc(&slab, GetParam(), MELON_DEFAULT_ALIGN));
+    for (void* ptr : ptrs)
+        melon_slab_free(&slab, ptr);
+
+    // All but one of the emptied slabs can be handed to another size class
+    size_t used_size  = slab.used_size;
+    size_t free_slabs = used_size / melon_vm_page_size() - 1;
+    ptrs.clear();
+
+    // Every class fits at least 3 objects per slab
+    size_t other_size = GetParam() > 512 ? 16 : 1024;
+    for (size_t i = 0; i < free_slabs * 3; i++)
+        ptrs.push_back(melon_slab_alloc(&slab, other_size, MELON_DEFAULT_ALIGN));
+    EXPECT_EQ(used_size, slab.used_size);
+
+    for (void* ptr : ptrs)
+        melon_slab_free(&slab, ptr);
+}
+
+TEST_F(SlabTest, large_and_overaligned_requests_use_backing_allocator)
+{
+    uint8_t* large       = (uint8_t*) melon_slab_alloc(&slab, MELON_KILOBYTE(64), MELON_DEFAULT_ALIGN);
+    uint8_t* overaligned = (uint8_t*) melon_slab_alloc(&slab, 64, 256);
+    EXPECT_EQ(0u, slab.used_size);
+    EXPECT_EQ(0u, (uintptr_t) overaligned % 256);
+
+    memset(large, 1, MELON_KILOBYTE(64));
+    melon_slab_free(&slab, large);
+    melon_slab_free(&slab, overaligned);
+}
+
+TEST_F(SlabTest, realloc_preserves_contents)
+{
+    uint8_t* ptr = (uint8_t*) melon_slab_alloc(&slab, 24, MELON_DEFAULT_ALIGN);
+    for (uint8_t i = 0; i < 24; i++)
+        ptr[i] = i;
+
+    // Within the same class the pointer doesn't move
+    EXPECT_EQ(ptr, melon_slab_realloc(&slab, ptr, 32, MELON_DEFAULT_ALIGN));
+
+    ptr = (uint8_t*) melon_slab_realloc(&slab, ptr, 700, MELON_DEFAULT_ALIGN);
+    for (uint8_t i = 0; i < 24; i++)
+        EXPECT_EQ(i, ptr[i]);
+
+    ptr = (uint8_t*) melon_slab_realloc(&slab, ptr, MELON_KILOBYTE(16), MELON_DEFAULT_ALIGN);
+    for (uint8_t i = 0; i < 24; i++)
+        EXPECT_EQ(i, ptr[i]);
+
+    melon_slab_free(&slab, ptr);
+}
+
+typedef struct
+{
+    int   value_i;
+    float value_f;
+} slab_test_type;
+
+MELON_HANDLE_MAP_TYPEDEF(slab_test_type);
+
+TEST_F(SlabTest, backs_handle_pools_and_maps)
+{
+    melon_allocator_api allocator = melon_slab_allocator_api(&slab);
+
+    melon_map_slab_test_type map;
+    melon_create_map(&map, 4, &allocator, true);
+
+    std::vector<melon_handle> handles;
+    for (int i = 0; i < 1000; i++)
+    {
+        slab_test_type value = { i, (float) i };
+        handles.push_back(melon_map_push(&map, &value));
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        const slab_test_type* value = melon_map_get(&map, handles[i]);
+        ASSERT_NE(nullptr, value);
+        EXPECT_EQ(i, value->value_i);
+    }
+
+    melon_delete_map(&map);
+}
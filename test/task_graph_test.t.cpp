@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <melon/core/task_graph.h>
+#include <melon/core/timer.h>
+
+#include <atomic>
+
+namespace
+{
+struct frame_state
+{
+    std::atomic<uint32_t> sequence;
+    uint32_t              finished_at[8];
+    thrd_t                main_thread;
+    bool                  main_thread_tasks_on_main;
+};
+
+struct task_data
+{
+    frame_state* frame;
+    size_t       index;
+    uint64_t     busy_ns;
+};
+
+void record_task(void* data)
+{
+    task_data* task = (task_data*) data;
+    uint64_t   end  = melon_time_ns() + task->busy_ns;
+    while (melon_time_ns() < end)
+    {
+    }
+    task->frame->finished_at[task->index] = task->frame->sequence.fetch_add(1);
+}
+
+void record_main_thread_task(void* data)
+{
+    task_data* task = (task_data*) data;
+    if (!thrd_equal(thrd_current(), task->frame->main_thread))
+        task->frame->main_thread_tasks_on_main = false;
+    record_task(data);
+}
+} // namespace
+
+class TaskGraphTest : public ::testing::TestWithParam<size_t>
+{
+};
+
+INSTANTIATE_TEST_CASE_P(WorkerCounts, TaskGraphTest, ::testing::Values((size_t) 1, (size_t) 4));
+
+TEST_P(TaskGraphTest, frame_pipeline)
+{
+    melon_job_system system;
+    ASSERT_TRUE(melon_create_job_system(&system, GetParam(), melon_default_cb_allocator()));
+
+    frame_state frame;
+    frame.main_thread = thrd_current();
+
+    // input -> simulation -> culling -> recording -> submit, with audio reading input next to the simulation
+    enum
+    {
+        INPUT,
+        SIMULATION,
+        AUDIO,
+        CULLING,
+        RECORDING,
+        SUBMIT,
+        TASK_COUNT
+    };
+    task_data data[TASK_COUNT];
+    for (size_t i = 0; i < TASK_COUNT; i++)
+        data[i] = {&frame, i, 200000};
+    data[AUDIO].busy_ns = 0;
+
+    melon_task_graph graph;
+    melon_create_task_graph(&graph);
+    melon_task_desc input      = {"input", record_main_thread_task, &data[INPUT], true};
+    melon_task_desc simulation = {"simulation", record_task, &data[SIMULATION], false};
+    melon_task_desc audio      = {"audio", record_task, &data[AUDIO], false};
+    melon_task_desc culling    = {"culling", record_task, &data[CULLING], false};
+    melon_task_desc recording  = {"recording", record_task, &data[RECORDING], false};
+    melon_task_desc submit     = {"submit", record_main_thread_task, &data[SUBMIT], true};
+    ASSERT_EQ((size_t) INPUT, melon_task_graph_add_task(&graph, &input));
+    ASSERT_EQ((size_t) SIMULATION, melon_task_graph_add_task(&graph, &simulation));
+    ASSERT_EQ((size_t) AUDIO, melon_task_graph_add_task(&graph, &audio));
+    ASSERT_EQ((size_t) CULLING, melon_task_graph_add_task(&graph, &culling));
+    ASSERT_EQ((size_t) RECORDING, melon_task_graph_add_task(&graph, &recording));
+    ASSERT_EQ((size_t) SUBMIT, melon_task_graph_add_task(&graph, &submit));
+
+    melon_task_graph_write(&graph, INPUT, "input");
+    melon_task_graph_read(&graph, SIMULATION, "input");
+    melon_task_graph_write(&graph, SIMULATION, "world");
+    melon_task_graph_read(&graph, AUDIO, "input");
+    melon_task_graph_read(&graph, CULLING, "world");
+    melon_task_graph_write(&graph, CULLING, "visible");
+    melon_task_graph_read(&graph, RECORDING, "visible");
+    melon_task_graph_write(&graph, RECORDING, "commands");
+    melon_task_graph_read(&graph, SUBMIT, "commands");
+    melon_task_graph_compile(&graph);
+
+    EXPECT_EQ(1u << INPUT, graph.tasks[SIMULATION].dependencies);
+    EXPECT_EQ(1u << INPUT, graph.tasks[AUDIO].dependencies);
+    EXPECT_EQ((1u << SIMULATION) | (1u << AUDIO), graph.tasks[INPUT].dependents);
+    EXPECT_EQ(1u << RECORDING, graph.tasks[SUBMIT].dependencies);
+    // The longer chain is scheduled first
+    EXPECT_EQ((size_t) INPUT, graph.order[0]);
+    EXPECT_EQ((size_t) SIMULATION, graph.order[1]);
+
+    for (int i = 0; i < 3; i++)
+    {
+        frame.sequence                  = 0;
+        frame.main_thread_tasks_on_main = true;
+        melon_task_graph_execute(&graph, &system);
+
+        EXPECT_EQ((uint32_t) TASK_COUNT, frame.sequence.load());
+        EXPECT_TRUE(frame.main_thread_tasks_on_main);
+        EXPECT_LT(frame.finished_at[INPUT], frame.finished_at[SIMULATION]);
+        EXPECT_LT(frame.finished_at[INPUT], frame.finished_at[AUDIO]);
+        EXPECT_LT(frame.finished_at[SIMULATION], frame.finished_at[CULLING]);
+        EXPECT_LT(frame.finished_at[CULLING], frame.finished_at[RECORDING]);
+        EXPECT_LT(frame.finished_at[RECORDING], frame.finished_at[SUBMIT]);
+
+        ASSERT_EQ(5u, graph.critical_path_length);
+        EXPECT_EQ((size_t) INPUT, graph.critical_path[0]);
+        EXPECT_EQ((size_t) SIMULATION, graph.critical_path[1]);
+        EXPECT_EQ((size_t) SUBMIT, graph.critical_path[4]);
+        EXPECT_LE(5u * 200000u, graph.critical_path_ns);
+        EXPECT_LE(graph.critical_path_ns, graph.frame_ns);
+    }
+
+    melon_destroy_job_system(&system);
+}
+
+TEST(TaskGraphTest, writer_waits_for_readers)
+{
+    task_data        data = {NULL, 0, 0};
+    melon_task_graph graph;
+    melon_create_task_graph(&graph);
+
+    melon_task_desc desc   = {"task", record_task, &data, false};
+    size_t          writer = melon_task_graph_add_task(&graph, &desc);
+    size_t          a      = melon_task_graph_add_task(&graph, &desc);
+    size_t          b      = melon_task_graph_add_task(&graph, &desc);
+    size_t          next   = melon_task_graph_add_task(&graph, &desc);
+    melon_task_graph_write(&graph, writer, "buffer");
+    melon_task_graph_read(&graph, a, "buffer");
+    melon_task_graph_read(&graph, b, "buffer");
+    melon_task_graph_write(&graph, next, "buffer");
+    // Reading and writing the same resource doesn't make a task depend on itself
+    melon_task_graph_read(&graph, next, "buffer");
+    melon_task_graph_compile(&graph);
+
+    EXPECT_EQ(1u << writer, graph.tasks[a].dependencies);
+    EXPECT_EQ(1u << writer, graph.tasks[b].dependencies);
+    EXPECT_EQ((1u << writer) | (1u << a) | (1u << b), graph.tasks[next].dependencies);
+    EXPECT_EQ(3u, graph.tasks[next].dependency_count);
+}
+
+TEST(TaskGraphTest, longest_chain_starts_first)
+{
+    melon_job_system system;
+    ASSERT_TRUE(melon_create_job_system(&system, 1, melon_default_cb_allocator()));
+
+    frame_state frame;
+    frame.sequence = 0;
+    task_data data[4];
+    for (size_t i = 0; i < 4; i++)
+        data[i] = {&frame, i, 0};
+
+    // Two independent tasks added before the head of a two task chain
+    melon_task_graph graph;
+    melon_create_task_graph(&graph);
+    melon_task_desc descs[4] = {{"a", record_task, &data[0], false},
+                                {"b", record_task, &data[1], false},
+                                {"chain head", record_task, &data[2], false},
+                                {"chain tail", record_task, &data[3], false}};
+    for (size_t i = 0; i < 4; i++)
+        melon_task_graph_add_task(&graph, &descs[i]);
+    melon_task_graph_write(&graph, 2, "x");
+    melon_task_graph_read(&graph, 3, "x");
+    melon_task_graph_compile(&graph);
+    EXPECT_EQ(2u, graph.order[0]);
+
+    // With a single worker the calling thread runs everything, in the order it pops its deque
+    melon_task_graph_execute(&graph, &system);
+    EXPECT_EQ(0u, frame.finished_at[2]);
+
+    melon_destroy_job_system(&system);
+}
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <melon/core/tlsf.h>
+#include <melon/core/error.h>
+
+#include <random>
+#include <vector>
+
+class TlsfTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        memory = malloc(region_size);
+        ASSERT_TRUE(melon_create_tlsf_allocator(&tlsf, memory, region_size));
+    }
+    void TearDown() override { free(memory); }
+
+    static const size_t  region_size = MELON_MEGABYTE(16);
+    void*                memory;
+    melon_tlsf_allocator tlsf;
+};
+
+TEST_F(TlsfTest, alloc_and_free_restores_region)
+{
+    ASSERT_TRUE(melon_tlsf_validate(&tlsf));
+
+    void* a = melon_tlsf_alloc(&tlsf, 100, MELON_DEFAULT_ALIGN);
+    void* b = melon_tlsf_alloc(&tlsf, 2000, MELON_DEFAULT_ALIGN);
+    void* c = melon_tlsf_alloc(&tlsf, 1, MELON_DEFAULT_ALIGN);
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+    EXPECT_LE(100u, melon_tlsf_block_size(a));
+    EXPECT_LE(2000u, melon_tlsf_block_size(b));
+
+    melon_tlsf_free(&tlsf, b);
+    melon_tlsf_free(&tlsf, a);
+    melon_tlsf_free(&tlsf, c);
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+
+    // Everything merged back into one block, so a request for most of the region fits again
+    void* all = melon_tlsf_alloc(&tlsf, region_size / 4 * 3, MELON_DEFAULT_ALIGN);
+    EXPECT_NE(nullptr, all);
+    melon_tlsf_free(&tlsf, all);
+}
+
+TEST_F(TlsfTest, honors_alignment)
+{
+    std::vector<void*> ptrs;
+    for (size_t align = 1; align <= 4096; align *= 2)
+    {
+        for (size_t size = 1; size < 300; size += 37)
+        {
+            void* ptr = melon_tlsf_alloc(&tlsf, size, align);
+            ASSERT_NE(nullptr, ptr);
+            EXPECT_EQ(0u, (uintptr_t) ptr % align);
+            memset(ptr, 0xCD, size);
+            ptrs.push_back(ptr);
+        }
+    }
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+
+    for (void* ptr : ptrs)
+        melon_tlsf_free(&tlsf, ptr);
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+}
+
+TEST_F(TlsfTest, exhaustion_returns_null)
+{
+    std::vector<void*> ptrs;
+    void*              ptr;
+    while ((ptr = melon_tlsf_alloc(&tlsf, MELON_KILOBYTE(64), MELON_DEFAULT_ALIGN)))
+        ptrs.push_back(ptr);
+
+    EXPECT_LT(200u, ptrs.size());
+    EXPECT_EQ(nullptr, melon_tlsf_alloc(&tlsf, region_size * 2, MELON_DEFAULT_ALIGN));
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+
+    for (void* p : ptrs)
+        melon_tlsf_free(&tlsf, p);
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+}
+
+TEST_F(TlsfTest, realloc_grows_in_place_into_free_neighbor)
+{
+    uint8_t* a = (uint8_t*) melon_tlsf_alloc(&tlsf, 256, MELON_DEFAULT_ALIGN);
+    uint8_t* b = (uint8_t*) melon_tlsf_alloc(&tlsf, 1024, MELON_DEFAULT_ALIGN);
+    uint8_t* c = (uint8_t*) melon_tlsf_alloc(&tlsf, 256, MELON_DEFAULT_ALIGN);
+    for (size_t i = 0; i < 256; i++)
+        a[i] = (uint8_t) i;
+
+    // a's neighbor is in use, so growing moves it
+    melon_tlsf_free(&tlsf, b);
+    EXPECT_EQ(a, melon_tlsf_realloc(&tlsf, a, 1024, MELON_DEFAULT_ALIGN));
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+
+    // Shrinking gives the tail back and stays in place
+    EXPECT_EQ(a, melon_tlsf_realloc(&tlsf, a, 128, MELON_DEFAULT_ALIGN));
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+
+    for (size_t i = 0; i < 128; i++)
+        EXPECT_EQ((uint8_t) i, a[i]);
+
+    // Nowhere to grow, the allocation moves and keeps its contents
+    uint8_t* moved = (uint8_t*) melon_tlsf_realloc(&tlsf, a, MELON_KILOBYTE(8), MELON_DEFAULT_ALIGN);
+    EXPECT_NE(a, moved);
+    for (size_t i = 0; i < 128; i++)
+        EXPECT_EQ((uint8_t) i, moved[i]);
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+
+    melon_tlsf_free(&tlsf, moved);
+    melon_tlsf_free(&tlsf, c);
+    EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+}
+
+TEST_F(TlsfTest, rejects_tiny_regions)
+{
+    uint8_t              small[16];
+    melon_tlsf_allocator small_tlsf;
+    EXPECT_FALSE(melon_create_tlsf_allocator(&small_tlsf, small, sizeof(small)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Stress tests, run against both the TLSF and the default callbacks
+////////////////////////////////////////////////////////////////////////////////
+
+struct allocation
+{
+    uint8_t* ptr;
+    size_t   size;
+    size_t   align;
+    uint8_t  pattern;
+};
+
+static void fill(allocation* a)
+{
+    for (size_t i = 0; i < a->size; i++)
+        a->ptr[i] = (uint8_t) (a->pattern + i);
+}
+
+static bool check(const allocation* a)
+{
+    for (size_t i = 0; i < a->size; i++)
+        if (a->ptr[i] != (uint8_t) (a->pattern + i))
+            return false;
+    return true;
+}
+
+class AllocatorStressTest : public ::testing::TestWithParam<bool>
+{
+public:
+    void SetUp() override
+    {
+        memory = malloc(MELON_MEGABYTE(64));
+        melon_create_tlsf_allocator(&tlsf, memory, MELON_MEGABYTE(64));
+        allocator = GetParam() ? melon_tlsf_allocator_api(&tlsf) : *melon_default_cb_allocator();
+    }
+    void TearDown() override { free(memory); }
+
+    void*                memory;
+    melon_tlsf_allocator tlsf;
+    melon_allocator_api  allocator;
+};
+
+INSTANTIATE_TEST_CASE_P(Backends, AllocatorStressTest, ::testing::Values(true, false));
+
+TEST_P(AllocatorStressTest, random_alloc_realloc_free)
+{
+    std::mt19937                          rng(1234);
+    std::uniform_int_distribution<size_t> size_dist(1, 4096);
+    std::uniform_int_distribution<int>    align_shift(0, 7);
+    std::uniform_int_distribution<int>    op_dist(0, 9);
+
+    std::vector<allocation> live;
+    for (size_t i = 0; i < 20000; i++)
+    {
+        int op = op_dist(rng);
+        if (live.empty() || op < 5)
+        {
+            allocation a;
+            a.size    = size_dist(rng);
+            a.align   = (size_t) 1 << align_shift(rng);
+            a.pattern = (uint8_t) i;
+            a.ptr     = (uint8_t*) MELON_ALLOC(allocator, a.size, a.align);
+            ASSERT_NE(nullptr, a.ptr);
+            ASSERT_EQ(0u, (uintptr_t) a.ptr % a.align);
+            fill(&a);
+            live.push_back(a);
+        }
+        else if (op < 7)
+        {
+            allocation* a = &live[rng() % live.size()];
+            ASSERT_TRUE(check(a));
+
+            size_t new_size = size_dist(rng);
+            a->ptr          = (uint8_t*) MELON_REALLOC(allocator, a->ptr, new_size, a->align);
+            ASSERT_NE(nullptr, a->ptr);
+            ASSERT_EQ(0u, (uintptr_t) a->ptr % a->align);
+
+            // The preserved prefix must survive the move
+            a->size = a->size < new_size ? a->size : new_size;
+            ASSERT_TRUE(check(a));
+            a->size = new_size;
+            fill(a);
+        }
+        else
+        {
+            size_t index = rng() % live.size();
+            ASSERT_TRUE(check(&live[index]));
+            MELON_FREE(allocator, live[index].ptr);
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        if (GetParam() && i % 1000 == 0)
+            ASSERT_TRUE(melon_tlsf_validate(&tlsf));
+    }
+
+    for (allocation& a : live)
+    {
+        EXPECT_TRUE(check(&a));
+        MELON_FREE(allocator, a.ptr);
+    }
+
+    if (GetParam())
+        EXPECT_TRUE(melon_tlsf_validate(&tlsf));
+}